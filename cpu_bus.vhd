@@ -18,7 +18,8 @@
 -- This file controls which peripheral is to drive the cpu input bus,
 -- and also generates the necessary peripheral control signals.
 --
--- We also generate a shared interrupt line.
+-- We also generate a shared interrupt line, and keep a free-running
+-- timer that the firmware can use to measure how long things take.
 
 library ieee;
 use ieee.std_logic_1164.all;
@@ -55,6 +56,11 @@ entity cpu_bus is
 		cpuUartQ	: in std_logic_vector (7 downto 0);
 		cpuUartInt	: in std_logic;
 
+		-- UART DMA Interface
+		cpuDmaCS	: out std_logic;
+		cpuDmaWR	: out std_logic;
+		cpuDmaQ		: in std_logic_vector (15 downto 0);
+
 		-- Keyboard Interface
 		cpuKbCS		: out std_logic;
 		cpuKbQ		: in std_logic_vector (7 downto 0);
@@ -80,10 +86,26 @@ architecture a of cpu_bus is
 
 	signal busFSM		: bus_FSM_type := busIdle_state;
 
+	-- The timer counts cpuClock periods, two per 68000 clock.  Reading
+	-- the high word latches the low word, so the two halves agree.  The
+	-- timer is also copied into uartStamp when the UART interrupt is
+	-- raised, so the ISR can tell how long it took to get there.
+	signal timer		: std_logic_vector (31 downto 0) := (others => '0');
+	signal timerLow		: std_logic_vector (15 downto 0) := (others => '0');
+	signal uartStamp	: std_logic_vector (31 downto 0) := (others => '0');
+	signal uartIntLast	: std_logic := '0';
+
 begin
 	cpu_bus_process: process(cpuClock)
 	begin
 		if rising_edge(cpuClock) then
+			timer <= timer + 1;
+
+			uartIntLast <= cpuUartInt;
+			if(cpuUartInt = '1' and uartIntLast = '0') then
+				uartStamp <= timer;
+			end if;
+
 			case busFSM is
 
 				when busIdle_state =>
@@ -91,6 +113,8 @@ begin
 					videoRamWren <= '0';
 					cpuUartCS <= '0';
 					cpuUartWR <= '0';
+					cpuDmaCS <= '0';
+					cpuDmaWR <= '0';
 					cpuKbCS <= '0';
 					cpuControlWR <= '0';
 					cpuLEDsWR <= '0';
@@ -147,9 +171,10 @@ begin
 										videoRamWren <= '1';
 									end if;
 
-								when 16#006000# to 16#006007# =>
-									-- UART @ 0xc000 to 0xc00f
-									-- 8 bytes, even addresses only
+								when 16#006000# to 16#00600F# =>
+									-- UART @ 0xc000 to 0xc01f
+									-- 8 bytes, even addresses only, then
+									-- its vendor registers from 0xc010
 									if(cpuRWn = '1') then
 										cpuUartCS <= '1';
 										cpuUartWR <= '0';
@@ -188,6 +213,48 @@ begin
 										cpuLEDsWR <= '1';
 									end if;
 
+								when 16#006050# =>
+									-- Timer high word @ 0xc0a0
+									-- Also latches the low word.
+									if(cpuRWn = '1') then
+										cpuDataIn <= timer(31 downto 16);
+										timerLow <= timer(15 downto 0);
+									end if;
+
+								when 16#006051# =>
+									-- Timer low word @ 0xc0a2
+									if(cpuRWn = '1') then
+										cpuDataIn <= timerLow;
+									end if;
+
+								when 16#006052# =>
+									-- UART interrupt time stamp @ 0xc0a4
+									-- High word.  It only changes when the
+									-- interrupt is raised again, so there
+									-- is no need to latch the low word.
+									if(cpuRWn = '1') then
+										cpuDataIn <= uartStamp(31 downto 16);
+									end if;
+
+								when 16#006053# =>
+									-- UART interrupt time stamp @ 0xc0a6
+									-- Low word.
+									if(cpuRWn = '1') then
+										cpuDataIn <= uartStamp(15 downto 0);
+									end if;
+
+								when 16#006060# to 16#006067# =>
+									-- UART DMA @ 0xc0c0 to 0xc0cf
+									-- 8 16-bit words
+									if(cpuRWn = '1') then
+										cpuDmaCS <= '1';
+										cpuDmaWR <= '0';
+										cpuDataIn <= cpuDmaQ;
+									elsif(cpuRWn = '0') then
+										cpuDmaCS <= '1';
+										cpuDmaWR <= '1';
+									end if;
+
 								when 16#7ffff8# to 16#7fffff# =>
 									-- Interrupt acknowledge cycle, where
 									-- the interrupt level is in bits 3:1
@@ -210,6 +277,8 @@ begin
 					videoRamWren <= '0';
 					cpuUartCS <= '0';
 					cpuUartWR <= '0';
+					cpuDmaCS <= '0';
+					cpuDmaWR <= '0';
 					cpuKbCS <= '0';
 					cpuControlWR <= '0';
 					cpuLEDsWR <= '0';
@@ -0,0 +1,283 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Run the real firmware image (build/fw.bin) on an emulated terminal, and
+// feed it recorded byte streams over the UART at the rates in baud_table.
+//
+// For each stream we report how many 68000 clock periods the firmware
+// spends on each received byte, and the highest baud rate it can keep up
+// with when the far end ignores flow control.
+//
+// See stream.c for how the cycles are counted.
+//
+// With -p, the flow controlled run is also profiled; see prof.c.  With -i,
+// it also records how long interrupts were masked and how long they took
+// to be answered; see ipl.c.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "ipl.h"
+#include "machine.h"
+#include "prof.h"
+#include "stream.h"
+#include "sym.h"
+
+// Leave functions and call paths below this share out of the profile.
+#define PROF_CUTOFF	(0.1)
+
+// While measuring interrupts, type a key this often, so the keyboard
+// interrupt and keyboard_handler() get exercised too.
+#define KEY_INTERVAL	(CPU_HZ / 100)
+#define KEY_A		(0x1c)
+#define KEY_UP		(0xf0)
+
+// The same divisors as uart.c, indexed by the DIP switch setting.
+static const uint16_t baud_table[16] = {
+	50284, 18438, 9219, 4609, 2305, 1152, 576, 288,
+	144, 96, 48, 24, 12, 6, 6, 6,
+};
+
+static const char *baud_names[16] = {
+	"110", "300", "600", "1200", "2400", "4800", "9600", "19200",
+	"38400", "57600", "115200", "230400", "460800", "921600", "921600", "921600",
+};
+
+#define FASTEST		(13)
+
+static MACHINE machine;
+static uint8_t *pRom;
+static int rom_len;
+
+static uint32_t prof_interval;
+static int ipl_measure;
+static uint64_t next_key;
+
+// Called after each step of the flow controlled run.
+static void
+measure_step(MACHINE *m, int cycles)
+{
+	if(prof_interval) {
+		prof_step(&m->cpu, cycles);
+	}
+
+	if(ipl_measure) {
+		ipl_step(m, cycles);
+		if(m->cpu.cycles >= next_key) {
+			machine_key(m, KEY_A);
+			machine_key(m, KEY_UP);
+			machine_key(m, KEY_A);
+			next_key += KEY_INTERVAL;
+		}
+	}
+}
+
+static void
+report_row(int setting, RESULT *r)
+{
+	double bytes = r->consumed ? r->consumed : 1;
+
+	printf("  %7s %7d %12.1f %12.1f %10.1f %9ld %7ld%s\n",
+			baud_names[setting],
+			baud_table[setting],
+			(double)r->elapsed / bytes,
+			(double)r->busy / bytes,
+			(double)r->isr / bytes,
+			r->overruns,
+			r->lost,
+			r->timed_out ? "  (gave up)" : "");
+}
+
+static void
+emulate(char *pFile, int sw_flow, int only, int all, int show)
+{
+	unsigned char *pData;
+	int len;
+	int setting;
+	uint16_t last_divisor = 0;
+	uint8_t flow_dip = sw_flow ? DIP_SW_FLOW : 0;
+	int best = -1;
+	double cpb;
+	RESULT r;
+
+	pData = stream_load(pFile, &len);
+	printf("%s: %d bytes\n", pFile, len);
+	if(len == 0) {
+		free(pData);
+		return;
+	}
+
+	// First, with the far end obeying flow control at the fastest rate,
+	// so the firmware is never waiting for data.  That gives the cost
+	// per byte.
+	stream_boot(&machine, pRom, rom_len, FASTEST | flow_dip);
+	if(prof_interval) {
+		prof_start(&machine.cpu, prof_interval);
+	}
+	if(ipl_measure) {
+		ipl_start(&machine);
+		next_key = machine.cpu.cycles + KEY_INTERVAL;
+	}
+	stream_run(&machine, pData, len, uart_byte_cycles(baud_table[FASTEST]),
+			sw_flow ? FLOW_XON : FLOW_RTS, measure_step, &r);
+	cpb = (double)r.busy / (r.consumed ? r.consumed : 1);
+	printf("  with %s flow control at %s baud: %.1f cycles/byte, %.1f in the ISR\n",
+			sw_flow ? "XON/XOFF" : "RTS/CTS",
+			baud_names[FASTEST], cpb, (double)r.isr / (r.consumed ? r.consumed : 1));
+	printf("  continuous rate at that cost: %.0f baud\n", 10.0 * CPU_HZ / cpb);
+	if(show) {
+		machine_screen(&machine, stdout);
+	}
+	if(prof_interval) {
+		prof_report(stdout, PROF_CUTOFF);
+		printf("\n");
+	}
+	if(ipl_measure) {
+		ipl_report(stdout, &machine);
+		printf("\n");
+	}
+
+	// Then without flow control, from the fastest rate down, until
+	// nothing is lost.  Anything slower than that will also work.
+	printf("  %7s %7s %12s %12s %10s %9s %7s\n",
+			"baud", "divisor", "elapsed/byte", "busy/byte", "isr/byte", "overruns", "lost");
+	for(setting = FASTEST; setting >= 0; setting--) {
+		if(only >= 0 && setting != only) {
+			continue;
+		}
+		if(baud_table[setting] == last_divisor) {
+			continue;
+		}
+		last_divisor = baud_table[setting];
+
+		stream_boot(&machine, pRom, rom_len, setting | flow_dip);
+		stream_run(&machine, pData, len, uart_byte_cycles(baud_table[setting]), FLOW_NONE, NULL, &r);
+		report_row(setting, &r);
+
+		if(r.lost == 0 && r.overruns == 0 && !r.timed_out) {
+			if(best < 0) {
+				best = setting;
+			}
+			if(!all) {
+				break;
+			}
+		}
+	}
+
+	if(only < 0) {
+		if(best >= 0) {
+			printf("  highest rate without flow control: %s baud\n", baud_names[best]);
+		} else {
+			printf("  no rate works without flow control\n");
+		}
+	}
+
+	free(pData);
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-m map] [-d dump] [-p cycles] [-i] [-b setting] [-a] [-x] [-s] fw.bin file ...\n", pName);
+	fprintf(stderr, "\t-m = linker map (default: fw.map next to fw.bin)\n");
+	fprintf(stderr, "\t-d = disassembly, for static functions (default: fw.dump next to fw.bin)\n");
+	fprintf(stderr, "\t-p = profile the flow controlled run, sampling every so many cycles\n");
+	fprintf(stderr, "\t-i = measure interrupt masking and latency in the flow controlled run\n");
+	fprintf(stderr, "\t-b = only try this baud rate DIP switch setting (0-15)\n");
+	fprintf(stderr, "\t-a = try every rate, not just down to the first that works\n");
+	fprintf(stderr, "\t-x = set the DIP switch for XON/XOFF rather than RTS/CTS\n");
+	fprintf(stderr, "\t-s = show the screen after each stream\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	char *pMap = NULL;
+	char *pDump = NULL;
+	char *pBin;
+	int only = -1;
+	int all = 0;
+	int sw_flow = 0;
+	int show = 0;
+
+	while((opt = getopt(argc, argv, "m:d:p:ib:axs")) != -1) {
+		switch(opt) {
+			case 'm':
+				pMap = optarg;
+				break;
+			case 'd':
+				pDump = optarg;
+				break;
+			case 'p':
+				prof_interval = atoi(optarg);
+				break;
+			case 'i':
+				ipl_measure = 1;
+				break;
+			case 'b':
+				only = atoi(optarg) & DIP_BAUD_MASK;
+				break;
+			case 'a':
+				all = 1;
+				break;
+			case 'x':
+				sw_flow = 1;
+				break;
+			case 's':
+				show = 1;
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 2 > argc) {
+		usage(argv[0]);
+	}
+
+	pBin = argv[optind++];
+	pRom = stream_load(pBin, &rom_len);
+
+	if(pMap == NULL) {
+		pMap = stream_sibling(pBin, ".map");
+	}
+	sym_load_map(pMap);
+
+	// Only the profile and the interrupt report need the static
+	// functions.
+	if(prof_interval || ipl_measure) {
+		if(pDump == NULL) {
+			pDump = stream_sibling(pBin, ".dump");
+		}
+		sym_load_dump(pDump);
+	}
+
+	stream_init(pMap);
+
+	for(; optind < argc; optind++) {
+		emulate(argv[optind], sw_flow, only, all, show);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,556 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Flow control and receive ring model.
+//
+// We run each stream once on the emulator, to find what the firmware
+// spends on each byte it takes from uart_rb (the main loop) and on each
+// receive interrupt (a fixed cost, plus so much per byte read from the
+// FIFO).  Then, for every rate in baud_table and for both RTS/CTS and
+// XON/XOFF, we replay those costs against a model of the link:
+//
+// - the far end sends back to back, and takes a while to react to RTS
+//   or XOFF, so bytes keep coming after we ask it to stop, and a while
+//   to start again (a time, plus for stopping, some characters it has
+//   already committed; the -u and -r options),
+//
+// - the 16 byte hardware FIFO interrupts at its trigger level, or after
+//   four character times with something in it, and overruns when full,
+//
+// - the ISR reads the FIFO until it is empty, stops the sender once
+//   uart_rb holds more than uart_high_water (worked out for each rate
+//   as uart_set_water() does), and drops bytes once it
+//   holds uart_depth, as _level3 in ../init.S and uart_store_char() do, and
+//
+// - the main loop takes what is in uart_rb on each trip, up to where it
+//   wraps or uart_span_max, frees it once the trip is over, and lets the
+//   sender go again once uart_rb is down to uart_low_water, as
+//   screen_handler() does with uart_receive_span() and
+//   uart_receive_done().
+//
+// The ring's size and water marks, the trigger level and the far end's
+// reaction can all be changed, to see what they would do.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "machine.h"
+#include "stream.h"
+#include "sym.h"
+
+// The same divisors as uart.c, indexed by the DIP switch setting.
+static const uint16_t baud_table[16] = {
+	50284, 18438, 9219, 4609, 2305, 1152, 576, 288,
+	144, 96, 48, 24, 12, 6, 6, 6,
+};
+
+static const char *baud_names[16] = {
+	"110", "300", "600", "1200", "2400", "4800", "9600", "19200",
+	"38400", "57600", "115200", "230400", "460800", "921600", "921600", "921600",
+};
+
+#define FASTEST		(13)
+
+// gh_uart_16550 raises a timeout interrupt after four idle characters.
+#define TIMEOUT_CHARS	(4)
+
+// Changes in what the far end has been told, waiting for it to react.
+#define MAX_CHANGES	(8)
+
+// The firmware's settings, from uart.c, which can be overridden.  The
+// water marks and the far end's reaction depend on the rate and the kind
+// of flow control, so -1 means work them out as uart_set_water() does.
+static int depth = 4096;
+static int high_water = -1;
+static int low_water = -1;
+static int span_max = 128;
+static int trigger = 8;
+static int reaction = -1;
+static int react_us = -1;
+
+// uart_set_water()'s assumptions about the far end.
+#define RTS_REACT_US	(1000)
+#define RTS_REACT_CHARS	(16)
+#define XON_REACT_US	(10000)
+#define XON_REACT_CHARS	(64)
+
+typedef struct {
+	uint64_t	when;
+	int		stop;
+} CHANGE;
+
+typedef struct {
+	// The link
+	const uint8_t	*pData;
+	int		len;
+	uint64_t	byte;		// Clock periods per character
+	int		flow;		// FLOW_RTS or FLOW_XON
+	uint64_t	react;		// The far end's reaction time
+	int		react_chars;	// and what it sends after that to stop
+
+	// Costs
+	COSTS		*pCosts;
+
+	// The far end
+	int		pos;		// Next byte to send
+	uint64_t	next;		// When the byte in flight completes, or 0
+	int		stopped;
+	CHANGE		changes[MAX_CHANGES];
+	int		num_changes;
+
+	// The hardware FIFO
+	uint8_t		fifo[UART_FIFO];
+	int		head;
+	int		count;
+	uint64_t	timeout;
+
+	// The firmware
+	uint64_t	t;
+	int		high;		// uart_high_water
+	int		low;		// uart_low_water
+	int		rb;
+	int		out;		// Where the main loop takes from
+	int		taking;		// How many the main loop has taken
+	int		paused;
+	long		consumed;
+
+	// Results
+	int		peak;
+	long		dropped;
+	long		overruns;
+	long		pauses;
+} SIM;
+
+// The far end's reaction, and the water marks, for a rate and a kind of
+// flow control.  The marks are worked out the same way as
+// uart_set_water() in uart.c, unless they were given.
+static void
+set_water(SIM *s, uint16_t divisor)
+{
+	int us = s->flow == FLOW_XON ? XON_REACT_US : RTS_REACT_US;
+	int chars = s->flow == FLOW_XON ? XON_REACT_CHARS : RTS_REACT_CHARS;
+	int go;
+	int stop;
+
+	go = ((uint64_t)us * (CPU_HZ / 1000)) / (1000 * uart_byte_cycles(divisor));
+	if(s->flow == FLOW_XON) {
+		go++;
+	}
+	stop = go + chars + UART_FIFO;
+
+	s->low = go + span_max;
+	s->high = s->low + stop;
+	if(s->high > depth - stop) {
+		s->high = depth - stop;
+		if(s->low > s->high - span_max) {
+			s->low = s->high - span_max;
+		}
+	}
+	if(high_water >= 0) {
+		s->high = high_water;
+	}
+	if(low_water >= 0) {
+		s->low = low_water;
+	}
+
+	// And what the far end really does.
+	s->react = (uint64_t)(react_us >= 0 ? react_us : us) * (CPU_HZ / 1000000);
+	s->react_chars = reaction >= 0 ? reaction : chars;
+}
+
+// Tell the far end to stop or go.  It reacts after its reaction time,
+// and then for stopping, sends what it has already committed.  For
+// XON/XOFF, that is after the character has been sent.
+static void
+tell(SIM *s, int stop)
+{
+	uint64_t when = s->t + s->react;
+
+	if(stop) {
+		when += s->react_chars * s->byte;
+	}
+
+	if(s->flow == FLOW_XON) {
+		when += s->byte;
+	}
+
+	if(s->num_changes < MAX_CHANGES) {
+		s->changes[s->num_changes].when = when;
+		s->changes[s->num_changes].stop = stop;
+		s->num_changes++;
+	}
+}
+
+// The far end finished sending, or was told it may go again.  Start the
+// next byte if it can.
+static void
+start_next(SIM *s, uint64_t when)
+{
+	if(s->next == 0 && !s->stopped && s->pos < s->len) {
+		s->next = when + s->byte;
+	}
+}
+
+// Bring the link up to time t.
+static void
+advance(SIM *s, uint64_t t)
+{
+	uint64_t done;
+	int i;
+
+	while(1) {
+		// The earliest of the byte in flight and the oldest change.
+		if(s->num_changes && (s->next == 0 || s->changes[0].when <= s->next)) {
+			if(s->changes[0].when > t) {
+				return;
+			}
+			s->stopped = s->changes[0].stop;
+			done = s->changes[0].when;
+			for(i = 1; i < s->num_changes; i++) {
+				s->changes[i - 1] = s->changes[i];
+			}
+			s->num_changes--;
+			start_next(s, done);
+			continue;
+		}
+
+		if(s->next == 0 || s->next > t) {
+			return;
+		}
+
+		done = s->next;
+		if(s->count == UART_FIFO) {
+			s->overruns++;
+		} else {
+			s->fifo[(s->head + s->count) % UART_FIFO] = s->pData[s->pos];
+			s->count++;
+		}
+		s->pos++;
+		s->timeout = done + TIMEOUT_CHARS * s->byte;
+		s->next = 0;
+		start_next(s, done);
+	}
+}
+
+// The next time something happens on the link.
+static uint64_t
+next_event(SIM *s)
+{
+	uint64_t when = UINT64_MAX;
+
+	if(s->next) {
+		when = s->next;
+	}
+	if(s->num_changes && s->changes[0].when < when) {
+		when = s->changes[0].when;
+	}
+	if(s->count && s->count < trigger && s->timeout < when) {
+		when = s->timeout;
+	}
+
+	return when;
+}
+
+static int
+interrupt(SIM *s)
+{
+	return s->count >= trigger || (s->count && s->t >= s->timeout);
+}
+
+// _level3, with uart_test_interrupt() and uart_store_char() behind it.
+static void
+isr(SIM *s)
+{
+	uint8_t c;
+
+	s->t += s->pCosts->isr_fixed;
+	while(1) {
+		advance(s, s->t);
+		if(s->count == 0) {
+			return;
+		}
+		c = s->fifo[s->head];
+		s->head = (s->head + 1) % UART_FIFO;
+		s->count--;
+		s->t += s->pCosts->isr_byte;
+
+		if(!c) {
+			continue;
+		}
+
+		if(s->rb > s->high && !s->paused) {
+			s->paused = 1;
+			s->pauses++;
+			tell(s, 1);
+		}
+
+		if(s->rb < depth) {
+			s->rb++;
+			if(s->rb > s->peak) {
+				s->peak = s->rb;
+			}
+		} else {
+			s->dropped++;
+		}
+	}
+}
+
+static void
+simulate(SIM *s)
+{
+	uint64_t remaining = 0;
+	uint64_t when;
+	int i;
+
+	start_next(s, 0);
+	while(1) {
+		advance(s, s->t);
+		if(interrupt(s)) {
+			isr(s);
+			continue;
+		}
+
+		// The main loop, one trip at a time.  It can be interrupted
+		// part way through.
+		if(remaining == 0) {
+			// uart_receive_done() for the last trip.
+			s->rb -= s->taking;
+			s->out = (s->out + s->taking) % depth;
+			s->taking = 0;
+			if(s->paused && s->rb <= s->low) {
+				s->paused = 0;
+				tell(s, 0);
+			}
+
+			if(s->rb) {
+				s->taking = s->rb < depth - s->out ? s->rb : depth - s->out;
+				if(s->taking > span_max) {
+					s->taking = span_max;
+				}
+				for(i = 0; i < s->taking; i++) {
+					remaining += s->pCosts->bytes ?
+						s->pCosts->pByte[s->consumed % s->pCosts->bytes] : 1;
+					s->consumed++;
+				}
+			} else {
+				// uart_receive_span() found nothing.
+				if(s->pos == s->len && s->next == 0 && s->count == 0) {
+					return;
+				}
+				remaining = s->pCosts->idle;
+			}
+			if(remaining == 0) {
+				remaining = 1;
+			}
+		}
+
+		when = next_event(s);
+		if(when <= s->t) {
+			when = s->t + 1;
+		}
+		if(when - s->t >= remaining) {
+			s->t += remaining;
+			remaining = 0;
+		} else {
+			remaining -= when - s->t;
+			s->t = when;
+		}
+	}
+}
+
+static void
+emulate(char *pFile, uint8_t *pRom, int rom_len)
+{
+	static MACHINE machine;
+	static COSTS costs;
+	uint16_t last_divisor = 0;
+	uint8_t *pData;
+	int len;
+	int flow;
+	int setting;
+	int safe[2] = { -1, -1 };
+	double sum = 0;
+	long i;
+	RESULT r;
+	SIM s;
+
+	pData = stream_load(pFile, &len);
+	printf("%s: %d bytes\n", pFile, len);
+	if(len == 0) {
+		free(pData);
+		return;
+	}
+
+	// Measure, with the far end obeying RTS at the fastest rate.
+	free(costs.pByte);
+	if((costs.pByte = malloc(len * sizeof(uint32_t))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	costs.max = len;
+	stream_costs(&costs);
+	stream_boot(&machine, pRom, rom_len, FASTEST);
+	stream_run(&machine, pData, len, uart_byte_cycles(baud_table[FASTEST]), FLOW_RTS, NULL, &r);
+	stream_costs(NULL);
+	if(r.timed_out) {
+		printf("  the firmware did not finish the stream\n");
+		free(pData);
+		return;
+	}
+	if(costs.idle == UINT64_MAX) {
+		costs.idle = 0;
+	}
+
+	for(i = 0; i < costs.bytes; i++) {
+		sum += costs.pByte[i];
+	}
+	printf("  main loop %.1f cycles/byte (idle trip %lu), ISR %.1f + %.1f/byte\n",
+			sum / (costs.bytes ? costs.bytes : 1), (unsigned long)costs.idle,
+			costs.isr_fixed, costs.isr_byte);
+
+	printf("  %7s %-8s %11s %11s %9s %9s %9s %12s %6s\n",
+			"baud", "flow", "high/low", "peak", "dropped", "overruns", "pauses",
+			"elapsed/byte", "line");
+	for(setting = FASTEST; setting >= 0; setting--) {
+		if(baud_table[setting] == last_divisor) {
+			continue;
+		}
+		last_divisor = baud_table[setting];
+
+		for(flow = 0; flow < 2; flow++) {
+			memset(&s, 0, sizeof(SIM));
+			s.pData = pData;
+			s.len = len;
+			s.byte = uart_byte_cycles(baud_table[setting]);
+			s.flow = flow ? FLOW_XON : FLOW_RTS;
+			s.pCosts = &costs;
+			set_water(&s, baud_table[setting]);
+			simulate(&s);
+
+			// line is how much of the time the far end was sending.
+			printf("  %7s %-8s %5d/%-5d %5d/%-5d %9ld %9ld %9ld %12.1f %5.1f%%\n",
+					baud_names[setting], flow ? "XON/XOFF" : "RTS/CTS",
+					s.high, s.low, s.peak, depth,
+					s.dropped, s.overruns, s.pauses,
+					(double)s.t / len,
+					100.0 * len * s.byte / (s.t ? s.t : 1));
+
+			if(s.dropped == 0 && s.overruns == 0 && safe[flow] < 0) {
+				safe[flow] = setting;
+			}
+		}
+	}
+
+	for(flow = 0; flow < 2; flow++) {
+		if(safe[flow] >= 0) {
+			printf("  safe with %s up to %s baud\n",
+					flow ? "XON/XOFF" : "RTS/CTS", baud_names[safe[flow]]);
+		} else {
+			printf("  not safe with %s at any rate\n", flow ? "XON/XOFF" : "RTS/CTS");
+		}
+	}
+
+	free(pData);
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-m map] [-d depth] [-w high_water] [-l low_water] [-s span] [-t trigger] [-u us] [-r chars] fw.bin file ...\n", pName);
+	fprintf(stderr, "\t-m = linker map (default: fw.map next to fw.bin)\n");
+	fprintf(stderr, "\t-d = uart_depth (default %d)\n", depth);
+	fprintf(stderr, "\t-w = uart_high_water (default: as uart_set_water() works it out)\n");
+	fprintf(stderr, "\t-l = uart_low_water (default: as uart_set_water() works it out)\n");
+	fprintf(stderr, "\t-s = uart_span_max (default %d)\n", span_max);
+	fprintf(stderr, "\t-t = receive FIFO trigger level (default %d)\n", trigger);
+	fprintf(stderr, "\t-u = microseconds the far end takes to react (default %d for RTS/CTS, %d for XON/XOFF)\n",
+			RTS_REACT_US, XON_REACT_US);
+	fprintf(stderr, "\t-r = characters the far end sends after that, when stopping (default %d for RTS/CTS, %d for XON/XOFF)\n",
+			RTS_REACT_CHARS, XON_REACT_CHARS);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	char *pMap = NULL;
+	char *pBin;
+	uint8_t *pRom;
+	int rom_len;
+
+	while((opt = getopt(argc, argv, "m:d:w:l:s:t:u:r:")) != -1) {
+		switch(opt) {
+			case 'm':
+				pMap = optarg;
+				break;
+			case 'd':
+				depth = atoi(optarg);
+				break;
+			case 'w':
+				high_water = atoi(optarg);
+				break;
+			case 'l':
+				low_water = atoi(optarg);
+				break;
+			case 's':
+				span_max = atoi(optarg);
+				break;
+			case 't':
+				trigger = atoi(optarg);
+				break;
+			case 'u':
+				if((react_us = atoi(optarg)) < 0) {
+					usage(argv[0]);
+				}
+				break;
+			case 'r':
+				if((reaction = atoi(optarg)) < 0) {
+					usage(argv[0]);
+				}
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 2 > argc || depth < 1 || high_water >= depth || span_max < 1 ||
+			(high_water >= 0 && low_water > high_water) ||
+			trigger < 1 || trigger > UART_FIFO) {
+		usage(argv[0]);
+	}
+
+	pBin = argv[optind++];
+	pRom = stream_load(pBin, &rom_len);
+
+	if(pMap == NULL) {
+		pMap = stream_sibling(pBin, ".map");
+	}
+	sym_load_map(pMap);
+	stream_init(pMap);
+
+	for(; optind < argc; optind++) {
+		emulate(argv[optind], pRom, rom_len);
+	}
+
+	exit(0);
+}
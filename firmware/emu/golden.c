@@ -0,0 +1,294 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Golden screen and cycle budget checker.
+//
+// Each test in the directory is a byte stream, listed in the BUDGET index
+// with the most clock periods per byte it may cost, and with the screen it
+// should leave behind in name.screen (see ../host/golden.c, which writes
+// them).  We run each stream the way emu does its flow controlled run, and
+// fail if the screen is wrong or the stream costs more than its budget.
+// With -u, the budgets are set to what the streams cost now, plus 5%.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "machine.h"
+#include "stream.h"
+#include "sym.h"
+
+// DIP switch setting 13, and its divisor from uart.c.
+#define FASTEST_DIP	(13)
+#define FASTEST_DIVISOR	(6)
+
+// Headroom given to a budget by -u.
+#define BUDGET_SLACK	(0.05)
+
+#define MAX_TESTS	(256)
+#define CURSOR		(0x80)
+
+// The rows, each with a newline, and a line for the cursor.
+#define SCREEN_MAX	(ROWS * (COLUMNS + 1) + 64)
+
+typedef struct {
+	char		name[256];
+	double		budget;		// 0 if not set
+	double		cost;
+} TEST;
+
+static TEST tests[MAX_TESTS];
+static int num_tests;
+
+static MACHINE machine;
+static MACHINE booted;
+
+// The frame RAM as text, in the same form as ../host/golden.c.
+static void
+render(MACHINE *m, char *pScreen)
+{
+	int row;
+	int col;
+	int cursor = -1;
+	uint16_t w;
+	uint8_t c;
+	char *p = pScreen;
+
+	for(row = 0; row < ROWS; row++) {
+		for(col = 0; col < COLUMNS; col++) {
+			w = m->frame[row * COLUMNS + col];
+			if((w & CURSOR) && cursor < 0) {
+				cursor = row * COLUMNS + col;
+			}
+			c = w & 0x7f;
+			*p++ = (c < 0x20 || c == 0x7f) ? ' ' : c;
+		}
+		*p++ = '\n';
+	}
+
+	if(cursor < 0) {
+		sprintf(p, "cursor none\n");
+	} else {
+		sprintf(p, "cursor %d %d\n", cursor / COLUMNS + 1, cursor % COLUMNS + 1);
+	}
+}
+
+static void
+read_index(char *pDir)
+{
+	char name[1024];
+	char line[1024];
+	char budget[64];
+	FILE *fp;
+	TEST *t;
+
+	snprintf(name, sizeof(name), "%s/BUDGET", pDir);
+	if((fp = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(line[0] == '#' || num_tests == MAX_TESTS) {
+			continue;
+		}
+		t = &tests[num_tests];
+		if(sscanf(line, "%255s %63s", t->name, budget) != 2) {
+			continue;
+		}
+		t->budget = atof(budget);
+		num_tests++;
+	}
+	fclose(fp);
+}
+
+// Rewrite the index with the new budgets, keeping the comments.
+static void
+write_index(char *pDir)
+{
+	char name[1024];
+	char tmp[1024];
+	char line[1024];
+	char test[256];
+	FILE *fpIn;
+	FILE *fpOut;
+	int i;
+
+	snprintf(name, sizeof(name), "%s/BUDGET", pDir);
+	snprintf(tmp, sizeof(tmp), "%s/BUDGET.new", pDir);
+	if((fpIn = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		exit(1);
+	}
+	if((fpOut = fopen(tmp, "w")) == NULL) {
+		fprintf(stderr, "Cannot create %s\n", tmp);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fpIn) != NULL) {
+		if(line[0] != '#' && sscanf(line, "%255s", test) == 1) {
+			for(i = 0; i < num_tests; i++) {
+				if(strcmp(tests[i].name, test) == 0) {
+					fprintf(fpOut, "%s %.0f\n", test, tests[i].cost * (1 + BUDGET_SLACK) + 0.5);
+					break;
+				}
+			}
+			if(i < num_tests) {
+				continue;
+			}
+		}
+		fputs(line, fpOut);
+	}
+	fclose(fpIn);
+	fclose(fpOut);
+
+	if(rename(tmp, name) != 0) {
+		fprintf(stderr, "Cannot rename %s\n", tmp);
+		exit(1);
+	}
+}
+
+// Returns 1 if the test failed.
+static int
+check(char *pDir, TEST *t, int update)
+{
+	char name[1024];
+	char got[SCREEN_MAX];
+	uint8_t *pData;
+	uint8_t *pWant;
+	int len;
+	int want_len;
+	int failed = 0;
+	RESULT r;
+
+	snprintf(name, sizeof(name), "%s/%s", pDir, t->name);
+	pData = stream_load(name, &len);
+
+	free(machine.pTx);
+	machine = booted;
+	machine.cpu.ctx = &machine;
+	stream_run(&machine, pData, len, uart_byte_cycles(FASTEST_DIVISOR), FLOW_RTS, NULL, &r);
+	free(pData);
+
+	if(r.timed_out) {
+		printf("%-16s gave up\n", t->name);
+		return 1;
+	}
+
+	t->cost = (double)r.busy / (len ? len : 1);
+	printf("%-16s %10.1f", t->name, t->cost);
+	if(t->budget) {
+		printf(" %10.0f", t->budget);
+	} else {
+		printf(" %10s", "-");
+	}
+
+	if(!update && t->budget && t->cost > t->budget) {
+		printf("  over budget");
+		failed = 1;
+	}
+
+	render(&machine, got);
+	snprintf(name, sizeof(name), "%s/%s.screen", pDir, t->name);
+	pWant = stream_load(name, &want_len);
+	if(want_len != strlen(got) || memcmp(pWant, got, want_len) != 0) {
+		printf("  wrong screen");
+		failed = 1;
+	}
+	free(pWant);
+
+	printf("\n");
+
+	return failed;
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-m map] [-u] fw.bin dir\n", pName);
+	fprintf(stderr, "\t-m = linker map (default: fw.map next to fw.bin)\n");
+	fprintf(stderr, "\t-u = set the budgets to the cost now, plus %.0f%%\n", BUDGET_SLACK * 100);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	char *pMap = NULL;
+	char *pBin;
+	char *pDir;
+	uint8_t *pRom;
+	int rom_len;
+	int update = 0;
+	int failed = 0;
+	int i;
+
+	while((opt = getopt(argc, argv, "m:u")) != -1) {
+		switch(opt) {
+			case 'm':
+				pMap = optarg;
+				break;
+			case 'u':
+				update = 1;
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 2 != argc) {
+		usage(argv[0]);
+	}
+
+	pBin = argv[optind++];
+	pDir = argv[optind++];
+	pRom = stream_load(pBin, &rom_len);
+
+	if(pMap == NULL) {
+		pMap = stream_sibling(pBin, ".map");
+	}
+	sym_load_map(pMap);
+	stream_init(pMap);
+
+	read_index(pDir);
+
+	stream_boot(&booted, pRom, rom_len, FASTEST_DIP);
+	booted.pTx = NULL;
+	booted.tx_len = 0;
+	booted.tx_size = 0;
+
+	printf("%-16s %10s %10s\n", "test", "cyc/byte", "budget");
+	for(i = 0; i < num_tests; i++) {
+		failed += check(pDir, &tests[i], update);
+	}
+
+	if(update) {
+		write_index(pDir);
+	}
+
+	if(failed) {
+		printf("%d failed\n", failed);
+		exit(1);
+	}
+
+	exit(0);
+}
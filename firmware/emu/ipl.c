@@ -0,0 +1,210 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Interrupt masking and latency.  For each device interrupt level, we
+// record every stretch of time that the processor's mask kept it out
+// (the interrupt handlers themselves, and any spl() in the main loop,
+// though the receive rings no longer need one), and the time from each
+// request to the first instruction of its handler.
+//
+// A stretch starts with the step that raised the mask, and ends with the
+// step that lowered it.  A request is noticed after the step during which
+// the device raised it, and a request that goes away before it is taken
+// (the UART ISR emptying the FIFO of bytes that came in while it ran, say)
+// is not counted.  Like the time stamp in cpu_bus.vhd, only a request
+// that goes up counts, not one that stays up after its handler returns.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ipl.h"
+#include "sym.h"
+
+// Powers of two, up to 2^31 clock periods.
+#define BUCKETS		(32)
+
+typedef struct {
+	long		count;
+	uint64_t	max;
+	uint32_t	max_pc;		// Where the longest one started
+	long		hist[BUCKETS];
+} STATS;
+
+typedef struct {
+	int		masked;
+	uint64_t	start;
+	uint32_t	start_pc;
+	STATS		window;
+
+	int		pending;
+	uint64_t	request;
+	STATS		latency;
+} LEVEL;
+
+static LEVEL levels[8];
+static uint8_t last_irq;
+static int fifo_max;
+
+static int
+bucket(uint64_t n)
+{
+	int b = 0;
+
+	while(n > 1 && b < BUCKETS - 1) {
+		n >>= 1;
+		b++;
+	}
+
+	return b;
+}
+
+static void
+add(STATS *s, uint64_t n, uint32_t pc)
+{
+	s->count++;
+	s->hist[bucket(n)]++;
+	if(n > s->max) {
+		s->max = n;
+		s->max_pc = pc;
+	}
+}
+
+void
+ipl_start(MACHINE *m)
+{
+	memset(levels, 0, sizeof(levels));
+	last_irq = m->irq;
+	fifo_max = 0;
+}
+
+// Call after each machine_step().
+void
+ipl_step(MACHINE *m, int cycles)
+{
+	m68k_t *cpu = &m->cpu;
+	int mask = (cpu->sr >> 8) & 7;
+	LEVEL *l;
+	int level;
+
+	for(level = 1; level < 7; level++) {
+		l = &levels[level];
+
+		if(mask >= level && !l->masked) {
+			l->masked = 1;
+			l->start = cpu->cycles - cycles;
+			l->start_pc = cpu->last_vector ? cpu->pc : cpu->ppc;
+		} else if(mask < level && l->masked) {
+			l->masked = 0;
+			add(&l->window, cpu->cycles - l->start, l->start_pc);
+		}
+
+		if(cpu->last_vector == 0x18 + level && l->pending) {
+			// The handler's first instruction is next.
+			l->pending = 0;
+			add(&l->latency, cpu->cycles - l->request, cpu->ppc);
+		}
+
+		if(!((m->irq >> level) & 1)) {
+			l->pending = 0;
+		} else if(!((last_irq >> level) & 1)) {
+			l->pending = 1;
+			l->request = cpu->cycles;
+		}
+	}
+	last_irq = m->irq;
+
+	if(m->uart.rx_count > fifo_max) {
+		fifo_max = m->uart.rx_count;
+	}
+}
+
+static void
+report_stats(FILE *fp, char *pWhat, STATS *s, int show_pc)
+{
+	uint32_t offset;
+	char *pName;
+	int b;
+
+	if(s->count == 0) {
+		fprintf(fp, "    %s: none\n", pWhat);
+		return;
+	}
+
+	fprintf(fp, "    %s: %ld, longest %lu clock periods (%.1f us)",
+			pWhat, s->count, (unsigned long)s->max, s->max * 1e6 / CPU_HZ);
+	if(show_pc && (pName = sym_name(s->max_pc, &offset)) != NULL) {
+		fprintf(fp, ", from %s+0x%x", pName, offset);
+	}
+	fprintf(fp, "\n");
+
+	for(b = 0; b < BUCKETS; b++) {
+		if(s->hist[b]) {
+			fprintf(fp, "      %10lu - %-10lu %8ld\n",
+					1UL << b, (2UL << b) - 1, s->hist[b]);
+		}
+	}
+}
+
+// How long the UART interrupt can wait before the receive FIFO overflows,
+// at the rates where that gets tight.
+static void
+report_headroom(FILE *fp, MACHINE *m)
+{
+	static const struct {
+		char		*pName;
+		uint16_t	divisor;
+	} rates[] = {
+		{ "115200", 48 },
+		{ "230400", 24 },
+		{ "460800", 12 },
+		{ "921600", 6 },
+	};
+	uint64_t worst = levels[UART_LEVEL].latency.max;
+	uint64_t room;
+	int i;
+
+	// The interrupt goes up as the trigger'th byte completes, and the
+	// FIFO overflows when byte UART_FIFO + 1 completes.
+	fprintf(fp, "    receive FIFO: trigger level %d, deepest %d of %d\n",
+			m->uart.rx_trigger, fifo_max, UART_FIFO);
+	for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+		room = (UART_FIFO + 1 - m->uart.rx_trigger) * uart_byte_cycles(rates[i].divisor);
+		fprintf(fp, "    at %6s baud the ISR must start within %6lu clock periods: %s\n",
+				rates[i].pName, (unsigned long)room,
+				(worst < room) ? "ok" : "too slow");
+	}
+}
+
+void
+ipl_report(FILE *fp, MACHINE *m)
+{
+	int level;
+
+	for(level = 1; level < 7; level++) {
+		if(level != UART_LEVEL && level != KB_LEVEL) {
+			continue;
+		}
+
+		fprintf(fp, "  level %d (%s):\n", level, (level == UART_LEVEL) ? "UART" : "keyboard");
+		report_stats(fp, "masked", &levels[level].window, 1);
+		report_stats(fp, "latency", &levels[level].latency, 0);
+		if(level == UART_LEVEL) {
+			report_headroom(fp, m);
+		}
+	}
+}
@@ -0,0 +1,29 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _IPL_H_
+#define _IPL_H_
+
+#include <stdio.h>
+
+#include "machine.h"
+
+extern void ipl_start(MACHINE *m);
+extern void ipl_step(MACHINE *m, int cycles);
+extern void ipl_report(FILE *fp, MACHINE *m);
+
+#endif // _IPL_H_
@@ -0,0 +1,2036 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// MC68000 instruction set, with the clock counts from the M68000 User's
+// Manual, section 8.  See m68k.h.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "m68k.h"
+
+#define SR_C		M68K_SR_C
+#define SR_V		M68K_SR_V
+#define SR_Z		M68K_SR_Z
+#define SR_N		M68K_SR_N
+#define SR_X		M68K_SR_X
+#define SR_S		M68K_SR_S
+#define SR_T		M68K_SR_T
+
+#define SR_NZVC		(SR_N | SR_Z | SR_V | SR_C)
+#define SR_XNZVC	(SR_X | SR_N | SR_Z | SR_V | SR_C)
+
+// Exception processing times, in clock periods.
+#define CYC_INTERRUPT	(M68K_CYCLES_INTERRUPT)
+#define CYC_TRAP	(34)
+#define CYC_ADDR_ERROR	(50)
+#define CYC_CHK		(40)
+#define CYC_ZERO_DIVIDE	(38)
+
+// Kinds of effective address.
+#define EA_DREG		(0)
+#define EA_AREG		(1)
+#define EA_MEM		(2)
+#define EA_IMM		(3)
+
+typedef struct {
+	int		kind;
+	int		reg;
+	uint32_t	addr;
+	uint32_t	imm;
+} ea_t;
+
+// Effective address calculation times (UM table 8-1), for byte/word and
+// for long operands.  Modes 0-6 are indexed directly; mode 7 uses the
+// register field to select abs.W, abs.L, d16(PC), d8(PC,Xn) or #imm.
+static const int ea_time_bw[12] = { 0, 0, 4, 4, 6, 8, 10, 8, 12, 8, 10, 4 };
+static const int ea_time_l[12]  = { 0, 0, 8, 8, 10, 12, 14, 12, 16, 12, 14, 8 };
+
+// Extra time for the destination of a MOVE (UM tables 8-2 and 8-3, less
+// the four clocks of the instruction itself).
+static const int move_dest_bw[12] = { 0, 0, 4, 4, 4, 8, 10, 8, 12, 0, 0, 0 };
+static const int move_dest_l[12]  = { 0, 0, 8, 8, 8, 12, 14, 12, 16, 0, 0, 0 };
+
+// Control addressing modes: LEA, PEA, JMP, JSR and MOVEM (UM table 8-11).
+// A zero means the mode is not allowed.
+static const int lea_time[12] = { 0, 0, 4, 0, 0, 8, 12, 8, 12, 8, 12, 0 };
+static const int pea_time[12] = { 0, 0, 12, 0, 0, 16, 20, 16, 20, 16, 20, 0 };
+static const int jmp_time[12] = { 0, 0, 8, 0, 0, 10, 14, 10, 12, 10, 14, 0 };
+static const int jsr_time[12] = { 0, 0, 16, 0, 0, 18, 22, 18, 20, 18, 22, 0 };
+static const int movem_r2m[12] = { 0, 0, 8, 0, 8, 12, 14, 12, 16, 0, 0, 0 };
+static const int movem_m2r[12] = { 0, 0, 12, 12, 0, 16, 18, 16, 20, 16, 18, 0 };
+
+static void execute(m68k_t *cpu, uint16_t op);
+
+static inline uint32_t
+size_mask(int size)
+{
+	return (size == 1) ? 0xff : (size == 2) ? 0xffff : 0xffffffff;
+}
+
+static inline uint32_t
+size_msb(int size)
+{
+	return (size == 1) ? 0x80 : (size == 2) ? 0x8000 : 0x80000000;
+}
+
+static inline uint32_t
+sign_extend(uint32_t val, int size)
+{
+	return (size == 1) ? (uint32_t)(int8_t)val :
+		(size == 2) ? (uint32_t)(int16_t)val : val;
+}
+
+// Index into the timing tables above.
+static inline int
+ea_index(int mode, int reg)
+{
+	return (mode < 7) ? mode : 7 + reg;
+}
+
+static inline int
+ea_valid(int mode, int reg)
+{
+	return (mode < 7) || (reg <= 4);
+}
+
+static inline int
+ea_time(int mode, int reg, int size)
+{
+	return (size == 4) ? ea_time_l[ea_index(mode, reg)] : ea_time_bw[ea_index(mode, reg)];
+}
+
+// Bus access.  Word and long accesses to odd addresses are address errors,
+// which abort the instruction.
+static void
+address_error(m68k_t *cpu, uint32_t addr, int write)
+{
+	cpu->fault_addr = addr;
+	cpu->fault_write = write;
+	longjmp(cpu->fault, 1);
+}
+
+static inline uint8_t
+rd8(m68k_t *cpu, uint32_t addr)
+{
+	return cpu->bus->read8(cpu->ctx, addr & 0xffffff);
+}
+
+static inline uint16_t
+rd16(m68k_t *cpu, uint32_t addr)
+{
+	if(addr & 1) {
+		address_error(cpu, addr, 0);
+	}
+	return cpu->bus->read16(cpu->ctx, addr & 0xffffff);
+}
+
+static inline uint32_t
+rd32(m68k_t *cpu, uint32_t addr)
+{
+	uint32_t hi = rd16(cpu, addr);
+
+	return (hi << 16) | rd16(cpu, addr + 2);
+}
+
+static inline void
+wr8(m68k_t *cpu, uint32_t addr, uint8_t val)
+{
+	cpu->bus->write8(cpu->ctx, addr & 0xffffff, val);
+}
+
+static inline void
+wr16(m68k_t *cpu, uint32_t addr, uint16_t val)
+{
+	if(addr & 1) {
+		address_error(cpu, addr, 1);
+	}
+	cpu->bus->write16(cpu->ctx, addr & 0xffffff, val);
+}
+
+static inline void
+wr32(m68k_t *cpu, uint32_t addr, uint32_t val)
+{
+	wr16(cpu, addr, val >> 16);
+	wr16(cpu, addr + 2, val);
+}
+
+static uint32_t
+rd(m68k_t *cpu, uint32_t addr, int size)
+{
+	switch(size) {
+		case 1:		return rd8(cpu, addr);
+		case 2:		return rd16(cpu, addr);
+		default:	return rd32(cpu, addr);
+	}
+}
+
+static void
+wr(m68k_t *cpu, uint32_t addr, int size, uint32_t val)
+{
+	switch(size) {
+		case 1:		wr8(cpu, addr, val); break;
+		case 2:		wr16(cpu, addr, val); break;
+		default:	wr32(cpu, addr, val); break;
+	}
+}
+
+static inline uint16_t
+fetch16(m68k_t *cpu)
+{
+	uint16_t val = rd16(cpu, cpu->pc);
+
+	cpu->pc += 2;
+	return val;
+}
+
+static inline uint32_t
+fetch32(m68k_t *cpu)
+{
+	uint32_t hi = fetch16(cpu);
+
+	return (hi << 16) | fetch16(cpu);
+}
+
+static inline void
+push16(m68k_t *cpu, uint16_t val)
+{
+	cpu->a[7] -= 2;
+	wr16(cpu, cpu->a[7], val);
+}
+
+static inline void
+push32(m68k_t *cpu, uint32_t val)
+{
+	cpu->a[7] -= 4;
+	wr32(cpu, cpu->a[7], val);
+}
+
+static inline uint16_t
+pop16(m68k_t *cpu)
+{
+	uint16_t val = rd16(cpu, cpu->a[7]);
+
+	cpu->a[7] += 2;
+	return val;
+}
+
+static inline uint32_t
+pop32(m68k_t *cpu)
+{
+	uint32_t val = rd32(cpu, cpu->a[7]);
+
+	cpu->a[7] += 4;
+	return val;
+}
+
+// Changing the S bit swaps the stack pointers.
+static void
+set_sr(m68k_t *cpu, uint16_t sr)
+{
+	uint32_t tmp;
+
+	sr &= 0xa71f;
+	if((sr ^ cpu->sr) & SR_S) {
+		tmp = cpu->a[7];
+		cpu->a[7] = cpu->other_sp;
+		cpu->other_sp = tmp;
+	}
+	cpu->sr = sr;
+}
+
+static void
+exception(m68k_t *cpu, int vector, uint32_t pc, int cycles)
+{
+	uint16_t old = cpu->sr;
+
+	cpu->last_vector = vector;
+	set_sr(cpu, (old | SR_S) & ~SR_T);
+	push32(cpu, pc);
+	push16(cpu, old);
+	cpu->pc = rd32(cpu, vector * 4);
+	cpu->cycles += cycles;
+	if(cpu->pc & 1) {
+		// The first fetch of the handler would fault during exception
+		// processing, which is a double fault.
+		cpu->halted = 1;
+	}
+}
+
+// Address errors push the long (group 0) frame.
+static void
+address_exception(m68k_t *cpu)
+{
+	uint16_t old = cpu->sr;
+	uint16_t status;
+
+	cpu->last_vector = M68K_VEC_ADDRESS_ERROR;
+	set_sr(cpu, (old | SR_S) & ~SR_T);
+	if(cpu->a[7] & 1) {
+		cpu->halted = 1;
+		return;
+	}
+
+	// Function code: supervisor or user, program or data.
+	status = (old & SR_S) ? 4 : 0;
+	status |= (cpu->fault_addr == cpu->pc || cpu->fault_addr == cpu->pc - 2) ? 2 : 1;
+	if(!cpu->fault_write) {
+		status |= 0x10;
+	}
+
+	push32(cpu, cpu->pc);
+	push16(cpu, old);
+	push16(cpu, cpu->ir);
+	push32(cpu, cpu->fault_addr);
+	push16(cpu, status);
+	cpu->pc = rd32(cpu, M68K_VEC_ADDRESS_ERROR * 4);
+	cpu->cycles += CYC_ADDR_ERROR;
+	if(cpu->pc & 1) {
+		cpu->halted = 1;
+	}
+}
+
+static void
+interrupt(m68k_t *cpu, int level)
+{
+	uint16_t old = cpu->sr;
+	int vector;
+
+	cpu->stopped = 0;
+	vector = cpu->bus->iack(cpu->ctx, level);
+	cpu->last_vector = vector;
+
+	set_sr(cpu, ((old | SR_S) & ~(SR_T | M68K_SR_IPL)) | (level << 8));
+	push32(cpu, cpu->pc);
+	push16(cpu, old);
+	cpu->pc = rd32(cpu, vector * 4);
+	cpu->cycles += CYC_INTERRUPT;
+	if(cpu->pc & 1) {
+		cpu->halted = 1;
+	}
+}
+
+static void
+illegal(m68k_t *cpu)
+{
+	exception(cpu, M68K_VEC_ILLEGAL, cpu->ppc, CYC_TRAP);
+}
+
+static int
+privileged(m68k_t *cpu)
+{
+	if(cpu->sr & SR_S) {
+		return 1;
+	}
+
+	exception(cpu, M68K_VEC_PRIVILEGE, cpu->ppc, CYC_TRAP);
+	return 0;
+}
+
+// Effective addresses.  Resolving an address consumes its extension
+// words and does any pre-decrement or post-increment, so it must be done
+// exactly once per operand.
+static uint32_t
+index_address(m68k_t *cpu, uint32_t base)
+{
+	uint16_t ext = fetch16(cpu);
+	int reg = (ext >> 12) & 7;
+	uint32_t xn = (ext & 0x8000) ? cpu->a[reg] : cpu->d[reg];
+
+	if(!(ext & 0x0800)) {
+		xn = (uint32_t)(int16_t)xn;
+	}
+
+	return base + (int8_t)ext + xn;
+}
+
+static void
+ea_get(m68k_t *cpu, ea_t *ea, int mode, int reg, int size)
+{
+	uint32_t base;
+
+	ea->reg = reg;
+	ea->kind = EA_MEM;
+
+	switch(mode) {
+		case 0:
+			ea->kind = EA_DREG;
+			break;
+
+		case 1:
+			ea->kind = EA_AREG;
+			break;
+
+		case 2:
+			ea->addr = cpu->a[reg];
+			break;
+
+		case 3:
+			ea->addr = cpu->a[reg];
+			// The stack pointer stays word-aligned.
+			cpu->a[reg] += (reg == 7 && size == 1) ? 2 : size;
+			break;
+
+		case 4:
+			cpu->a[reg] -= (reg == 7 && size == 1) ? 2 : size;
+			ea->addr = cpu->a[reg];
+			break;
+
+		case 5:
+			ea->addr = cpu->a[reg] + (int16_t)fetch16(cpu);
+			break;
+
+		case 6:
+			ea->addr = index_address(cpu, cpu->a[reg]);
+			break;
+
+		default:
+			switch(reg) {
+				case 0:
+					ea->addr = (int16_t)fetch16(cpu);
+					break;
+
+				case 1:
+					ea->addr = fetch32(cpu);
+					break;
+
+				case 2:
+					base = cpu->pc;
+					ea->addr = base + (int16_t)fetch16(cpu);
+					break;
+
+				case 3:
+					ea->addr = index_address(cpu, cpu->pc);
+					break;
+
+				default:
+					ea->kind = EA_IMM;
+					if(size == 4) {
+						ea->imm = fetch32(cpu);
+					} else {
+						ea->imm = fetch16(cpu) & size_mask(size);
+					}
+					break;
+			}
+			break;
+	}
+}
+
+static uint32_t
+ea_read(m68k_t *cpu, ea_t *ea, int size)
+{
+	switch(ea->kind) {
+		case EA_DREG:	return cpu->d[ea->reg] & size_mask(size);
+		case EA_AREG:	return cpu->a[ea->reg] & size_mask(size);
+		case EA_MEM:	return rd(cpu, ea->addr, size);
+		default:	return ea->imm;
+	}
+}
+
+static void
+ea_write(m68k_t *cpu, ea_t *ea, int size, uint32_t val)
+{
+	uint32_t mask = size_mask(size);
+
+	switch(ea->kind) {
+		case EA_DREG:
+			cpu->d[ea->reg] = (cpu->d[ea->reg] & ~mask) | (val & mask);
+			break;
+
+		case EA_AREG:
+			cpu->a[ea->reg] = sign_extend(val, size);
+			break;
+
+		case EA_MEM:
+			wr(cpu, ea->addr, size, val);
+			break;
+	}
+}
+
+// Condition codes.
+static void
+flags_logic(m68k_t *cpu, uint32_t res, int size)
+{
+	uint16_t sr = cpu->sr & ~SR_NZVC;
+
+	res &= size_mask(size);
+	if(res == 0) {
+		sr |= SR_Z;
+	}
+	if(res & size_msb(size)) {
+		sr |= SR_N;
+	}
+	cpu->sr = sr;
+}
+
+// Add with optional extend.  For ADDX, Z is only ever cleared.
+static uint32_t
+alu_add(m68k_t *cpu, uint32_t s, uint32_t d, int size, int extend)
+{
+	uint32_t msb = size_msb(size);
+	uint32_t x = extend ? ((cpu->sr & SR_X) ? 1 : 0) : 0;
+	uint32_t r = (d + s + x) & size_mask(size);
+	uint16_t sr = cpu->sr & ~(SR_X | SR_N | SR_V | SR_C);
+
+	if(!extend) {
+		sr &= ~SR_Z;
+		if(r == 0) {
+			sr |= SR_Z;
+		}
+	} else if(r != 0) {
+		sr &= ~SR_Z;
+	}
+	if(r & msb) {
+		sr |= SR_N;
+	}
+	if(((s & d) | ((s | d) & ~r)) & msb) {
+		sr |= SR_C | SR_X;
+	}
+	if((s ^ r) & (d ^ r) & msb) {
+		sr |= SR_V;
+	}
+	cpu->sr = sr;
+
+	return r;
+}
+
+// Subtract d - s, with optional extend.  CMP leaves X alone.
+static uint32_t
+alu_sub(m68k_t *cpu, uint32_t s, uint32_t d, int size, int extend, int compare)
+{
+	uint32_t msb = size_msb(size);
+	uint32_t x = extend ? ((cpu->sr & SR_X) ? 1 : 0) : 0;
+	uint32_t r = (d - s - x) & size_mask(size);
+	uint16_t sr = cpu->sr & ~(SR_N | SR_V | SR_C);
+
+	if(!compare) {
+		sr &= ~SR_X;
+	}
+	if(!extend) {
+		sr &= ~SR_Z;
+		if(r == 0) {
+			sr |= SR_Z;
+		}
+	} else if(r != 0) {
+		sr &= ~SR_Z;
+	}
+	if(r & msb) {
+		sr |= SR_N;
+	}
+	if(((s & ~d) | (r & ~d) | (s & r)) & msb) {
+		sr |= compare ? SR_C : (SR_C | SR_X);
+	}
+	if((s ^ d) & (r ^ d) & msb) {
+		sr |= SR_V;
+	}
+	cpu->sr = sr;
+
+	return r;
+}
+
+static int
+condition(m68k_t *cpu, int cc)
+{
+	int c = (cpu->sr & SR_C) != 0;
+	int v = (cpu->sr & SR_V) != 0;
+	int z = (cpu->sr & SR_Z) != 0;
+	int n = (cpu->sr & SR_N) != 0;
+
+	switch(cc) {
+		case 0:		return 1;		// T
+		case 1:		return 0;		// F
+		case 2:		return !c && !z;	// HI
+		case 3:		return c || z;		// LS
+		case 4:		return !c;		// CC
+		case 5:		return c;		// CS
+		case 6:		return !z;		// NE
+		case 7:		return z;		// EQ
+		case 8:		return !v;		// VC
+		case 9:		return v;		// VS
+		case 10:	return !n;		// PL
+		case 11:	return n;		// MI
+		case 12:	return n == v;		// GE
+		case 13:	return n != v;		// LT
+		case 14:	return !z && (n == v);	// GT
+		default:	return z || (n != v);	// LE
+	}
+}
+
+// Decode the usual two-bit size field.
+static inline int
+op_size(uint16_t op)
+{
+	switch((op >> 6) & 3) {
+		case 0:		return 1;
+		case 1:		return 2;
+		case 2:		return 4;
+		default:	return 0;
+	}
+}
+
+// Line 0: bit manipulation, MOVEP and immediate instructions.
+static void
+op_bit(m68k_t *cpu, uint16_t op, int bit)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int type = (op >> 6) & 3;	// BTST, BCHG, BCLR, BSET
+	int is_static = !(op & 0x0100);
+	uint32_t val;
+	uint32_t mask;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg) || mode == 1 || (type != 0 && mode == 7 && reg > 1)) {
+		illegal(cpu);
+		return;
+	}
+
+	if(mode == 0) {
+		// Long operation on a data register.
+		mask = 1u << (bit & 31);
+		val = cpu->d[reg];
+		cpu->sr = (val & mask) ? (cpu->sr & ~SR_Z) : (cpu->sr | SR_Z);
+		switch(type) {
+			case 0:
+				cpu->cycles += is_static ? 10 : 6;
+				return;
+
+			case 1:
+				cpu->d[reg] = val ^ mask;
+				cpu->cycles += is_static ? 12 : 8;
+				return;
+
+			case 2:
+				cpu->d[reg] = val & ~mask;
+				cpu->cycles += is_static ? 14 : 10;
+				return;
+
+			default:
+				cpu->d[reg] = val | mask;
+				cpu->cycles += is_static ? 12 : 8;
+				return;
+		}
+	}
+
+	// Byte operation on memory.
+	mask = 1u << (bit & 7);
+	ea_get(cpu, &ea, mode, reg, 1);
+	val = ea_read(cpu, &ea, 1);
+	cpu->sr = (val & mask) ? (cpu->sr & ~SR_Z) : (cpu->sr | SR_Z);
+	cpu->cycles += ea_time(mode, reg, 1);
+	switch(type) {
+		case 0:
+			cpu->cycles += is_static ? 8 : 4;
+			return;
+
+		case 1:
+			ea_write(cpu, &ea, 1, val ^ mask);
+			break;
+
+		case 2:
+			ea_write(cpu, &ea, 1, val & ~mask);
+			break;
+
+		default:
+			ea_write(cpu, &ea, 1, val | mask);
+			break;
+	}
+	cpu->cycles += is_static ? 12 : 8;
+}
+
+static void
+op_movep(m68k_t *cpu, uint16_t op)
+{
+	int dreg = (op >> 9) & 7;
+	uint32_t addr = cpu->a[op & 7] + (int16_t)fetch16(cpu);
+	uint32_t val;
+
+	switch((op >> 6) & 3) {
+		case 0:
+			val = rd8(cpu, addr) << 8;
+			val |= rd8(cpu, addr + 2);
+			cpu->d[dreg] = (cpu->d[dreg] & 0xffff0000) | val;
+			cpu->cycles += 16;
+			break;
+
+		case 1:
+			val = rd8(cpu, addr) << 24;
+			val |= rd8(cpu, addr + 2) << 16;
+			val |= rd8(cpu, addr + 4) << 8;
+			val |= rd8(cpu, addr + 6);
+			cpu->d[dreg] = val;
+			cpu->cycles += 24;
+			break;
+
+		case 2:
+			val = cpu->d[dreg];
+			wr8(cpu, addr, val >> 8);
+			wr8(cpu, addr + 2, val);
+			cpu->cycles += 16;
+			break;
+
+		default:
+			val = cpu->d[dreg];
+			wr8(cpu, addr, val >> 24);
+			wr8(cpu, addr + 2, val >> 16);
+			wr8(cpu, addr + 4, val >> 8);
+			wr8(cpu, addr + 6, val);
+			cpu->cycles += 24;
+			break;
+	}
+}
+
+static void
+op_line0(m68k_t *cpu, uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size = op_size(op);
+	int which = (op >> 9) & 7;
+	uint32_t imm;
+	uint32_t val;
+	uint32_t res;
+	ea_t ea;
+
+	if(op & 0x0100) {
+		if(mode == 1) {
+			op_movep(cpu, op);
+		} else {
+			op_bit(cpu, op, cpu->d[(op >> 9) & 7]);
+		}
+		return;
+	}
+
+	if(which == 4) {
+		op_bit(cpu, op, fetch16(cpu) & 0xff);
+		return;
+	}
+
+	// Immediate to CCR or SR.
+	if(mode == 7 && reg == 4 && (which == 0 || which == 1 || which == 5)) {
+		if(size == 1) {
+			imm = fetch16(cpu) & 0x1f;
+			val = cpu->sr & 0x1f;
+		} else if(size == 2) {
+			if(!privileged(cpu)) {
+				return;
+			}
+			imm = fetch16(cpu);
+			val = cpu->sr;
+		} else {
+			illegal(cpu);
+			return;
+		}
+
+		switch(which) {
+			case 0:		res = val | imm; break;
+			case 1:		res = val & imm; break;
+			default:	res = val ^ imm; break;
+		}
+
+		if(size == 1) {
+			cpu->sr = (cpu->sr & 0xff00) | res;
+		} else {
+			set_sr(cpu, res);
+		}
+		cpu->cycles += 20;
+		return;
+	}
+
+	if(size == 0 || which == 7 || mode == 1 || !ea_valid(mode, reg) ||
+			(mode == 7 && reg > 1)) {
+		illegal(cpu);
+		return;
+	}
+
+	imm = (size == 4) ? fetch32(cpu) : (fetch16(cpu) & size_mask(size));
+	ea_get(cpu, &ea, mode, reg, size);
+	val = ea_read(cpu, &ea, size);
+
+	switch(which) {
+		case 0:		// ORI
+			res = val | imm;
+			flags_logic(cpu, res, size);
+			break;
+
+		case 1:		// ANDI
+			res = val & imm;
+			flags_logic(cpu, res, size);
+			break;
+
+		case 2:		// SUBI
+			res = alu_sub(cpu, imm, val, size, 0, 0);
+			break;
+
+		case 3:		// ADDI
+			res = alu_add(cpu, imm, val, size, 0);
+			break;
+
+		case 5:		// EORI
+			res = val ^ imm;
+			flags_logic(cpu, res, size);
+			break;
+
+		default:	// CMPI
+			alu_sub(cpu, imm, val, size, 0, 1);
+			if(mode == 0) {
+				cpu->cycles += (size == 4) ? 14 : 8;
+			} else {
+				cpu->cycles += ((size == 4) ? 12 : 8) + ea_time(mode, reg, size);
+			}
+			return;
+	}
+
+	ea_write(cpu, &ea, size, res);
+	if(mode == 0) {
+		cpu->cycles += (size != 4) ? 8 : (which == 1) ? 14 : 16;
+	} else {
+		cpu->cycles += ((size == 4) ? 20 : 12) + ea_time(mode, reg, size);
+	}
+}
+
+// Lines 1-3: MOVE and MOVEA.
+static void
+op_move(m68k_t *cpu, uint16_t op, int size)
+{
+	int smode = (op >> 3) & 7;
+	int sreg = op & 7;
+	int dmode = (op >> 6) & 7;
+	int dreg = (op >> 9) & 7;
+	uint32_t val;
+	ea_t src;
+	ea_t dst;
+
+	if(!ea_valid(smode, sreg) || !ea_valid(dmode, dreg) ||
+			(dmode == 7 && dreg > 1) || (size == 1 && (smode == 1 || dmode == 1))) {
+		illegal(cpu);
+		return;
+	}
+
+	ea_get(cpu, &src, smode, sreg, size);
+	val = ea_read(cpu, &src, size);
+	cpu->cycles += 4 + ea_time(smode, sreg, size);
+
+	if(dmode == 1) {
+		// MOVEA - sign extended, no flags.
+		cpu->a[dreg] = sign_extend(val, size);
+		return;
+	}
+
+	ea_get(cpu, &dst, dmode, dreg, size);
+	ea_write(cpu, &dst, size, val);
+	flags_logic(cpu, val, size);
+	cpu->cycles += (size == 4) ? move_dest_l[ea_index(dmode, dreg)] :
+		move_dest_bw[ea_index(dmode, dreg)];
+}
+
+// Line 4: miscellaneous.
+static void
+op_movem(m68k_t *cpu, uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size = (op & 0x0040) ? 4 : 2;
+	int to_mem = !(op & 0x0400);
+	uint16_t list = fetch16(cpu);
+	uint32_t addr;
+	int count = 0;
+	int i;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg) || mode < 2 ||
+			(to_mem && (mode == 3 || (mode == 7 && reg > 1))) ||
+			(!to_mem && (mode == 4 || (mode == 7 && reg > 3)))) {
+		illegal(cpu);
+		return;
+	}
+
+	if(to_mem && mode == 4) {
+		// Pre-decrement: the mask is reversed, a7 first.
+		addr = cpu->a[reg];
+		for(i = 15; i >= 0; i--) {
+			if(list & (1 << (15 - i))) {
+				addr -= size;
+				wr(cpu, addr, size, (i < 8) ? cpu->d[i] : cpu->a[i - 8]);
+				count++;
+			}
+		}
+		cpu->a[reg] = addr;
+	} else if(to_mem) {
+		ea_get(cpu, &ea, mode, reg, size);
+		addr = ea.addr;
+		for(i = 0; i < 16; i++) {
+			if(list & (1 << i)) {
+				wr(cpu, addr, size, (i < 8) ? cpu->d[i] : cpu->a[i - 8]);
+				addr += size;
+				count++;
+			}
+		}
+	} else {
+		if(mode == 3) {
+			addr = cpu->a[reg];
+		} else {
+			ea_get(cpu, &ea, mode, reg, size);
+			addr = ea.addr;
+		}
+		for(i = 0; i < 16; i++) {
+			if(list & (1 << i)) {
+				uint32_t val = sign_extend(rd(cpu, addr, size), size);
+
+				if(i < 8) {
+					cpu->d[i] = val;
+				} else {
+					cpu->a[i - 8] = val;
+				}
+				addr += size;
+				count++;
+			}
+		}
+		if(mode == 3) {
+			cpu->a[reg] = addr;
+		}
+	}
+
+	cpu->cycles += (to_mem ? movem_r2m : movem_m2r)[ea_index(mode, reg)] +
+		count * ((size == 4) ? 8 : 4);
+}
+
+static void
+op_nbcd(m68k_t *cpu, ea_t *ea)
+{
+	uint32_t dst = ea_read(cpu, ea, 1);
+	uint32_t x = (cpu->sr & SR_X) ? 1 : 0;
+	uint32_t res = (0x9a - dst - x) & 0xff;
+	uint16_t sr = cpu->sr & ~(SR_X | SR_N | SR_V | SR_C);
+
+	if(res != 0x9a) {
+		if((res & 0x0f) == 0x0a) {
+			res = ((res & 0xf0) + 0x10) & 0xff;
+		}
+		ea_write(cpu, ea, 1, res);
+		if(res != 0) {
+			sr &= ~SR_Z;
+		}
+		sr |= SR_X | SR_C;
+	}
+	if(res & 0x80) {
+		sr |= SR_N;
+	}
+	cpu->sr = sr;
+}
+
+static void
+op_line4(m68k_t *cpu, uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size = op_size(op);
+	int mem = (mode >= 2);
+	uint32_t val;
+	uint32_t res;
+	uint32_t addr;
+	int16_t bound;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg)) {
+		illegal(cpu);
+		return;
+	}
+
+	// CHK and LEA have a register in bits 11-9.
+	if((op & 0x01c0) == 0x0180) {
+		ea_get(cpu, &ea, mode, reg, 2);
+		bound = ea_read(cpu, &ea, 2);
+		val = (int16_t)cpu->d[(op >> 9) & 7];
+		cpu->cycles += ea_time(mode, reg, 2);
+		if((int16_t)val < 0) {
+			cpu->sr |= SR_N;
+			exception(cpu, M68K_VEC_CHK, cpu->pc, CYC_CHK);
+		} else if((int16_t)val > bound) {
+			cpu->sr &= ~SR_N;
+			exception(cpu, M68K_VEC_CHK, cpu->pc, CYC_CHK);
+		} else {
+			cpu->cycles += 10;
+		}
+		return;
+	}
+	if((op & 0x01c0) == 0x01c0) {
+		if(lea_time[ea_index(mode, reg)] == 0) {
+			illegal(cpu);
+			return;
+		}
+		ea_get(cpu, &ea, mode, reg, 4);
+		cpu->a[(op >> 9) & 7] = ea.addr;
+		cpu->cycles += lea_time[ea_index(mode, reg)];
+		return;
+	}
+
+	switch((op >> 8) & 0xf) {
+		case 0x0:	// NEGX, MOVE from SR
+			ea_get(cpu, &ea, mode, reg, size ? size : 2);
+			if(size == 0) {
+				ea_write(cpu, &ea, 2, cpu->sr);
+				cpu->cycles += mem ? 8 + ea_time(mode, reg, 2) : 6;
+				return;
+			}
+			val = ea_read(cpu, &ea, size);
+			ea_write(cpu, &ea, size, alu_sub(cpu, val, 0, size, 1, 0));
+			break;
+
+		case 0x2:	// CLR
+			if(size == 0) {
+				illegal(cpu);
+				return;
+			}
+			ea_get(cpu, &ea, mode, reg, size);
+			// The 68000 reads before it clears.
+			if(mem) {
+				ea_read(cpu, &ea, size);
+			}
+			ea_write(cpu, &ea, size, 0);
+			cpu->sr = (cpu->sr & ~SR_NZVC) | SR_Z;
+			break;
+
+		case 0x4:	// NEG, MOVE to CCR
+			if(size == 0) {
+				ea_get(cpu, &ea, mode, reg, 2);
+				val = ea_read(cpu, &ea, 2);
+				cpu->sr = (cpu->sr & 0xff00) | (val & 0x1f);
+				cpu->cycles += 12 + ea_time(mode, reg, 2);
+				return;
+			}
+			ea_get(cpu, &ea, mode, reg, size);
+			val = ea_read(cpu, &ea, size);
+			ea_write(cpu, &ea, size, alu_sub(cpu, val, 0, size, 0, 0));
+			break;
+
+		case 0x6:	// NOT, MOVE to SR
+			if(size == 0) {
+				if(!privileged(cpu)) {
+					return;
+				}
+				ea_get(cpu, &ea, mode, reg, 2);
+				set_sr(cpu, ea_read(cpu, &ea, 2));
+				cpu->cycles += 12 + ea_time(mode, reg, 2);
+				return;
+			}
+			ea_get(cpu, &ea, mode, reg, size);
+			res = ~ea_read(cpu, &ea, size);
+			ea_write(cpu, &ea, size, res);
+			flags_logic(cpu, res, size);
+			break;
+
+		case 0x8:	// NBCD, SWAP, PEA, EXT, MOVEM to memory
+			if(size == 1) {
+				ea_get(cpu, &ea, mode, reg, 1);
+				op_nbcd(cpu, &ea);
+				cpu->cycles += mem ? 8 + ea_time(mode, reg, 1) : 6;
+				return;
+			}
+			if(size == 2 && mode == 0) {
+				res = (cpu->d[reg] >> 16) | (cpu->d[reg] << 16);
+				cpu->d[reg] = res;
+				flags_logic(cpu, res, 4);
+				cpu->cycles += 4;
+				return;
+			}
+			if(size == 2) {
+				if(pea_time[ea_index(mode, reg)] == 0) {
+					illegal(cpu);
+					return;
+				}
+				ea_get(cpu, &ea, mode, reg, 4);
+				push32(cpu, ea.addr);
+				cpu->cycles += pea_time[ea_index(mode, reg)];
+				return;
+			}
+			if(mode == 0) {
+				if(size == 0) {
+					res = (int16_t)cpu->d[reg];
+					cpu->d[reg] = res;
+					flags_logic(cpu, res, 4);
+				} else {
+					res = (uint16_t)(int8_t)cpu->d[reg];
+					cpu->d[reg] = (cpu->d[reg] & 0xffff0000) | res;
+					flags_logic(cpu, res, 2);
+				}
+				cpu->cycles += 4;
+				return;
+			}
+			op_movem(cpu, op);
+			return;
+
+		case 0xa:	// TST, TAS, ILLEGAL
+			if(op == 0x4afc) {
+				illegal(cpu);
+				return;
+			}
+			if(size == 0) {
+				ea_get(cpu, &ea, mode, reg, 1);
+				val = ea_read(cpu, &ea, 1);
+				flags_logic(cpu, val, 1);
+				ea_write(cpu, &ea, 1, val | 0x80);
+				cpu->cycles += mem ? 14 + ea_time(mode, reg, 1) : 4;
+				return;
+			}
+			ea_get(cpu, &ea, mode, reg, size);
+			flags_logic(cpu, ea_read(cpu, &ea, size), size);
+			cpu->cycles += 4 + ea_time(mode, reg, size);
+			return;
+
+		case 0xc:	// MOVEM to registers
+			if(size == 4 || size == 0) {
+				op_movem(cpu, op);
+				return;
+			}
+			illegal(cpu);
+			return;
+
+		case 0xe:
+			if((op & 0xfff0) == 0x4e40) {
+				exception(cpu, M68K_VEC_TRAP_0 + (op & 0xf), cpu->pc, CYC_TRAP);
+				return;
+			}
+			if((op & 0xfff8) == 0x4e50) {	// LINK
+				val = (int16_t)fetch16(cpu);
+				push32(cpu, cpu->a[reg]);
+				cpu->a[reg] = cpu->a[7];
+				cpu->a[7] += val;
+				cpu->cycles += 16;
+				return;
+			}
+			if((op & 0xfff8) == 0x4e58) {	// UNLK
+				cpu->a[7] = cpu->a[reg];
+				cpu->a[reg] = pop32(cpu);
+				cpu->cycles += 12;
+				return;
+			}
+			if((op & 0xfff0) == 0x4e60) {	// MOVE USP
+				if(!privileged(cpu)) {
+					return;
+				}
+				if(op & 0x0008) {
+					cpu->a[reg] = cpu->other_sp;
+				} else {
+					cpu->other_sp = cpu->a[reg];
+				}
+				cpu->cycles += 4;
+				return;
+			}
+			switch(op) {
+				case 0x4e70:	// RESET
+					if(privileged(cpu)) {
+						cpu->cycles += 132;
+					}
+					return;
+
+				case 0x4e71:	// NOP
+					cpu->cycles += 4;
+					return;
+
+				case 0x4e72:	// STOP
+					if(privileged(cpu)) {
+						set_sr(cpu, fetch16(cpu));
+						cpu->stopped = 1;
+						cpu->cycles += 4;
+					}
+					return;
+
+				case 0x4e73:	// RTE
+					if(privileged(cpu)) {
+						res = pop16(cpu);
+						addr = pop32(cpu);
+						set_sr(cpu, res);
+						cpu->pc = addr;
+						cpu->cycles += 20;
+					}
+					return;
+
+				case 0x4e75:	// RTS
+					cpu->pc = pop32(cpu);
+					cpu->cycles += 16;
+					return;
+
+				case 0x4e76:	// TRAPV
+					if(cpu->sr & SR_V) {
+						exception(cpu, M68K_VEC_TRAPV, cpu->pc, CYC_TRAP);
+					} else {
+						cpu->cycles += 4;
+					}
+					return;
+
+				case 0x4e77:	// RTR
+					res = pop16(cpu);
+					cpu->sr = (cpu->sr & 0xff00) | (res & 0x1f);
+					cpu->pc = pop32(cpu);
+					cpu->cycles += 20;
+					return;
+			}
+			if((op & 0xffc0) == 0x4e80) {	// JSR
+				if(jsr_time[ea_index(mode, reg)] == 0) {
+					illegal(cpu);
+					return;
+				}
+				ea_get(cpu, &ea, mode, reg, 4);
+				push32(cpu, cpu->pc);
+				cpu->pc = ea.addr;
+				cpu->cycles += jsr_time[ea_index(mode, reg)];
+				return;
+			}
+			if((op & 0xffc0) == 0x4ec0) {	// JMP
+				if(jmp_time[ea_index(mode, reg)] == 0) {
+					illegal(cpu);
+					return;
+				}
+				ea_get(cpu, &ea, mode, reg, 4);
+				cpu->pc = ea.addr;
+				cpu->cycles += jmp_time[ea_index(mode, reg)];
+				return;
+			}
+			illegal(cpu);
+			return;
+
+		default:
+			illegal(cpu);
+			return;
+	}
+
+	// NEGX, CLR, NEG and NOT share their timing.
+	if(mem) {
+		cpu->cycles += ((size == 4) ? 12 : 8) + ea_time(mode, reg, size);
+	} else {
+		cpu->cycles += (size == 4) ? 6 : 4;
+	}
+}
+
+// Line 5: ADDQ, SUBQ, Scc and DBcc.
+static void
+op_line5(m68k_t *cpu, uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size = op_size(op);
+	uint32_t data = ((op >> 9) & 7) ? ((op >> 9) & 7) : 8;
+	int16_t disp;
+	uint32_t val;
+	ea_t ea;
+
+	if(size == 0) {
+		int cc = (op >> 8) & 0xf;
+
+		if(mode == 1) {
+			// DBcc
+			disp = fetch16(cpu);
+			if(condition(cpu, cc)) {
+				cpu->cycles += 12;
+				return;
+			}
+			val = (cpu->d[reg] - 1) & 0xffff;
+			cpu->d[reg] = (cpu->d[reg] & 0xffff0000) | val;
+			if(val == 0xffff) {
+				cpu->cycles += 14;
+			} else {
+				cpu->pc = cpu->ppc + 2 + disp;
+				cpu->cycles += 10;
+			}
+			return;
+		}
+
+		if(!ea_valid(mode, reg) || (mode == 7 && reg > 1)) {
+			illegal(cpu);
+			return;
+		}
+		ea_get(cpu, &ea, mode, reg, 1);
+		if(mode != 0) {
+			ea_read(cpu, &ea, 1);
+		}
+		if(condition(cpu, cc)) {
+			ea_write(cpu, &ea, 1, 0xff);
+			cpu->cycles += (mode == 0) ? 6 : 8 + ea_time(mode, reg, 1);
+		} else {
+			ea_write(cpu, &ea, 1, 0);
+			cpu->cycles += (mode == 0) ? 4 : 8 + ea_time(mode, reg, 1);
+		}
+		return;
+	}
+
+	if(!ea_valid(mode, reg) || (mode == 7 && reg > 1) || (mode == 1 && size == 1)) {
+		illegal(cpu);
+		return;
+	}
+
+	if(mode == 1) {
+		// Address registers: whole register, no flags.
+		if(op & 0x0100) {
+			cpu->a[reg] -= data;
+		} else {
+			cpu->a[reg] += data;
+		}
+		cpu->cycles += 8;
+		return;
+	}
+
+	ea_get(cpu, &ea, mode, reg, size);
+	val = ea_read(cpu, &ea, size);
+	if(op & 0x0100) {
+		val = alu_sub(cpu, data, val, size, 0, 0);
+	} else {
+		val = alu_add(cpu, data, val, size, 0);
+	}
+	ea_write(cpu, &ea, size, val);
+
+	if(mode == 0) {
+		cpu->cycles += (size == 4) ? 8 : 4;
+	} else {
+		cpu->cycles += ((size == 4) ? 12 : 8) + ea_time(mode, reg, size);
+	}
+}
+
+// Line 6: BRA, BSR and Bcc.
+static void
+op_line6(m68k_t *cpu, uint16_t op)
+{
+	int cc = (op >> 8) & 0xf;
+	uint32_t base = cpu->pc;
+	int32_t disp = (int8_t)op;
+	int word = 0;
+
+	if(disp == 0) {
+		disp = (int16_t)fetch16(cpu);
+		word = 1;
+	}
+
+	if(cc == 1) {
+		// BSR
+		push32(cpu, cpu->pc);
+		cpu->pc = base + disp;
+		cpu->cycles += 18;
+		return;
+	}
+
+	if(condition(cpu, cc)) {
+		cpu->pc = base + disp;
+		cpu->cycles += 10;
+	} else {
+		cpu->cycles += word ? 12 : 8;
+	}
+}
+
+// ABCD and SBCD, register or memory form.
+static void
+op_bcd(m68k_t *cpu, uint16_t op, int subtract)
+{
+	int rx = op & 7;
+	int ry = (op >> 9) & 7;
+	uint32_t src;
+	uint32_t dst;
+	uint32_t res;
+	uint32_t x = (cpu->sr & SR_X) ? 1 : 0;
+	uint16_t sr = cpu->sr & ~(SR_X | SR_N | SR_V | SR_C);
+
+	if(op & 0x0008) {
+		cpu->a[rx] -= (rx == 7) ? 2 : 1;
+		src = rd8(cpu, cpu->a[rx]);
+		cpu->a[ry] -= (ry == 7) ? 2 : 1;
+		dst = rd8(cpu, cpu->a[ry]);
+	} else {
+		src = cpu->d[rx] & 0xff;
+		dst = cpu->d[ry] & 0xff;
+	}
+
+	if(subtract) {
+		res = (dst & 0x0f) - (src & 0x0f) - x;
+		if(res > 9) {
+			res -= 6;
+		}
+		res += (dst & 0xf0) - (src & 0xf0);
+		if(res > 0x99) {
+			res += 0xa0;
+			sr |= SR_X | SR_C;
+		}
+	} else {
+		res = (src & 0x0f) + (dst & 0x0f) + x;
+		if(res > 9) {
+			res += 6;
+		}
+		res += (src & 0xf0) + (dst & 0xf0);
+		if(res > 0x99) {
+			res -= 0xa0;
+			sr |= SR_X | SR_C;
+		}
+	}
+	res &= 0xff;
+	if(res != 0) {
+		sr &= ~SR_Z;
+	}
+	if(res & 0x80) {
+		sr |= SR_N;
+	}
+	cpu->sr = sr;
+
+	if(op & 0x0008) {
+		wr8(cpu, cpu->a[ry], res);
+		cpu->cycles += 18;
+	} else {
+		cpu->d[ry] = (cpu->d[ry] & 0xffffff00) | res;
+		cpu->cycles += 6;
+	}
+}
+
+// ADDX and SUBX, register or memory form.
+static void
+op_addx(m68k_t *cpu, uint16_t op, int size, int subtract)
+{
+	int rx = op & 7;
+	int ry = (op >> 9) & 7;
+	uint32_t src;
+	uint32_t dst;
+	uint32_t res;
+
+	if(op & 0x0008) {
+		cpu->a[rx] -= (rx == 7 && size == 1) ? 2 : size;
+		src = rd(cpu, cpu->a[rx], size);
+		cpu->a[ry] -= (ry == 7 && size == 1) ? 2 : size;
+		dst = rd(cpu, cpu->a[ry], size);
+	} else {
+		src = cpu->d[rx] & size_mask(size);
+		dst = cpu->d[ry] & size_mask(size);
+	}
+
+	if(subtract) {
+		res = alu_sub(cpu, src, dst, size, 1, 0);
+	} else {
+		res = alu_add(cpu, src, dst, size, 1);
+	}
+
+	if(op & 0x0008) {
+		wr(cpu, cpu->a[ry], size, res);
+		cpu->cycles += (size == 4) ? 30 : 18;
+	} else {
+		cpu->d[ry] = (cpu->d[ry] & ~size_mask(size)) | res;
+		cpu->cycles += (size == 4) ? 8 : 4;
+	}
+}
+
+// Exact DIVU and DIVS timing, from the microcode's shift-and-subtract
+// loop.  These do not include the effective address time.
+static int
+divu_cycles(uint32_t dividend, uint16_t divisor)
+{
+	uint32_t hdivisor = (uint32_t)divisor << 16;
+	uint32_t temp;
+	int mcycles = 38;
+	int i;
+
+	if((dividend >> 16) >= divisor) {
+		return 10;
+	}
+
+	for(i = 0; i < 15; i++) {
+		temp = dividend;
+		dividend <<= 1;
+		if((int32_t)temp < 0) {
+			dividend -= hdivisor;
+		} else {
+			mcycles += 2;
+			if(dividend >= hdivisor) {
+				dividend -= hdivisor;
+				mcycles--;
+			}
+		}
+	}
+
+	return mcycles * 2;
+}
+
+static int
+divs_cycles(int32_t dividend, int16_t divisor)
+{
+	uint32_t adividend = (dividend < 0) ? -(uint32_t)dividend : (uint32_t)dividend;
+	uint32_t adivisor = (divisor < 0) ? -divisor : divisor;
+	uint32_t aquot;
+	int mcycles = 6;
+	int i;
+
+	if(dividend < 0) {
+		mcycles++;
+	}
+
+	if((adividend >> 16) >= adivisor) {
+		return (mcycles + 2) * 2;
+	}
+
+	aquot = adividend / adivisor;
+
+	mcycles += 55;
+	if(divisor >= 0) {
+		if(dividend >= 0) {
+			mcycles--;
+		} else {
+			mcycles++;
+		}
+	}
+
+	for(i = 0; i < 15; i++) {
+		if((int16_t)aquot >= 0) {
+			mcycles++;
+		}
+		aquot <<= 1;
+	}
+
+	return mcycles * 2;
+}
+
+static void
+op_div(m68k_t *cpu, uint16_t op, int is_signed)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int dreg = (op >> 9) & 7;
+	uint32_t dividend = cpu->d[dreg];
+	uint32_t divisor;
+	uint32_t quot;
+	uint32_t rem;
+	int64_t squot;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg) || mode == 1) {
+		illegal(cpu);
+		return;
+	}
+
+	ea_get(cpu, &ea, mode, reg, 2);
+	divisor = ea_read(cpu, &ea, 2);
+	cpu->cycles += ea_time(mode, reg, 2);
+
+	if(divisor == 0) {
+		exception(cpu, M68K_VEC_ZERO_DIVIDE, cpu->pc, CYC_ZERO_DIVIDE);
+		return;
+	}
+
+	cpu->sr &= ~(SR_N | SR_Z | SR_V | SR_C);
+	if(is_signed) {
+		cpu->cycles += divs_cycles(dividend, divisor);
+		squot = (int64_t)(int32_t)dividend / (int16_t)divisor;
+		if(squot < -32768 || squot > 32767) {
+			cpu->sr |= SR_V | SR_N;
+			return;
+		}
+		quot = (uint32_t)squot;
+		rem = (int32_t)dividend % (int16_t)divisor;
+	} else {
+		cpu->cycles += divu_cycles(dividend, divisor);
+		quot = dividend / divisor;
+		if(quot > 0xffff) {
+			cpu->sr |= SR_V | SR_N;
+			return;
+		}
+		rem = dividend % divisor;
+	}
+
+	cpu->d[dreg] = ((rem & 0xffff) << 16) | (quot & 0xffff);
+	if((quot & 0xffff) == 0) {
+		cpu->sr |= SR_Z;
+	}
+	if(quot & 0x8000) {
+		cpu->sr |= SR_N;
+	}
+}
+
+static void
+op_mul(m68k_t *cpu, uint16_t op, int is_signed)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int dreg = (op >> 9) & 7;
+	uint32_t src;
+	uint32_t res;
+	uint32_t bits;
+	int n = 0;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg) || mode == 1) {
+		illegal(cpu);
+		return;
+	}
+
+	ea_get(cpu, &ea, mode, reg, 2);
+	src = ea_read(cpu, &ea, 2);
+
+	if(is_signed) {
+		res = (int32_t)(int16_t)src * (int32_t)(int16_t)cpu->d[dreg];
+		// One step for each 01 or 10 pair in the source, with a zero
+		// appended on the right.
+		bits = (src << 1) ^ src;
+	} else {
+		res = (src & 0xffff) * (cpu->d[dreg] & 0xffff);
+		bits = src;
+	}
+	for(bits &= 0xffff; bits; bits &= bits - 1) {
+		n++;
+	}
+
+	cpu->d[dreg] = res;
+	flags_logic(cpu, res, 4);
+	cpu->cycles += 38 + 2 * n + ea_time(mode, reg, 2);
+}
+
+// Lines 8, 9, B, C, D: the two-operand ALU instructions.
+static void
+op_alu(m68k_t *cpu, uint16_t op)
+{
+	int line = op >> 12;
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int dreg = (op >> 9) & 7;
+	int opmode = (op >> 6) & 7;
+	int size = op_size(op);
+	int to_ea = (opmode >= 4);
+	uint32_t src;
+	uint32_t dst;
+	uint32_t res;
+	ea_t ea;
+
+	if(!ea_valid(mode, reg)) {
+		illegal(cpu);
+		return;
+	}
+
+	// Address register destinations: ADDA, SUBA, CMPA.
+	if(opmode == 3 || opmode == 7) {
+		if(line == 0x8) {
+			op_div(cpu, op, opmode == 7);
+			return;
+		}
+		if(line == 0xc) {
+			op_mul(cpu, op, opmode == 7);
+			return;
+		}
+
+		size = (opmode == 7) ? 4 : 2;
+		ea_get(cpu, &ea, mode, reg, size);
+		src = sign_extend(ea_read(cpu, &ea, size), size);
+		cpu->cycles += ea_time(mode, reg, size);
+
+		switch(line) {
+			case 0x9:
+				cpu->a[dreg] -= src;
+				break;
+
+			case 0xd:
+				cpu->a[dreg] += src;
+				break;
+
+			default:
+				alu_sub(cpu, src, cpu->a[dreg], 4, 0, 1);
+				cpu->cycles += 6;
+				return;
+		}
+		if(size == 2) {
+			cpu->cycles += 8;
+		} else {
+			cpu->cycles += (mode <= 1 || (mode == 7 && reg == 4)) ? 8 : 6;
+		}
+		return;
+	}
+
+	// The register-to-register and memory-to-memory special cases
+	// that live in the Dn,<ea> encodings.
+	if(to_ea && mode <= 1) {
+		switch(line) {
+			case 0x8:
+				if(size == 1) {
+					op_bcd(cpu, op, 1);
+				} else {
+					illegal(cpu);
+				}
+				return;
+
+			case 0xc:
+				switch(op & 0x01f8) {
+					case 0x0100:
+					case 0x0108:
+						op_bcd(cpu, op, 0);
+						return;
+
+					case 0x0140:
+						res = cpu->d[dreg];
+						cpu->d[dreg] = cpu->d[reg];
+						cpu->d[reg] = res;
+						cpu->cycles += 6;
+						return;
+
+					case 0x0148:
+						res = cpu->a[dreg];
+						cpu->a[dreg] = cpu->a[reg];
+						cpu->a[reg] = res;
+						cpu->cycles += 6;
+						return;
+
+					case 0x0188:
+						res = cpu->d[dreg];
+						cpu->d[dreg] = cpu->a[reg];
+						cpu->a[reg] = res;
+						cpu->cycles += 6;
+						return;
+				}
+				illegal(cpu);
+				return;
+
+			case 0x9:
+				op_addx(cpu, op, size, 1);
+				return;
+
+			case 0xd:
+				op_addx(cpu, op, size, 0);
+				return;
+
+			default:
+				if(mode == 1) {
+					// CMPM
+					src = rd(cpu, cpu->a[reg], size);
+					cpu->a[reg] += (reg == 7 && size == 1) ? 2 : size;
+					dst = rd(cpu, cpu->a[dreg], size);
+					cpu->a[dreg] += (dreg == 7 && size == 1) ? 2 : size;
+					alu_sub(cpu, src, dst, size, 0, 1);
+					cpu->cycles += (size == 4) ? 20 : 12;
+					return;
+				}
+				// EOR Dn,Dn
+				res = (cpu->d[reg] ^ cpu->d[dreg]) & size_mask(size);
+				cpu->d[reg] = (cpu->d[reg] & ~size_mask(size)) | res;
+				flags_logic(cpu, res, size);
+				cpu->cycles += (size == 4) ? 8 : 4;
+				return;
+		}
+	}
+
+	if(to_ea) {
+		// Dn,<ea>: read-modify-write to memory.
+		if(mode == 7 && reg > 1) {
+			illegal(cpu);
+			return;
+		}
+		ea_get(cpu, &ea, mode, reg, size);
+		dst = ea_read(cpu, &ea, size);
+		src = cpu->d[dreg] & size_mask(size);
+	} else {
+		if(size == 1 && mode == 1) {
+			illegal(cpu);
+			return;
+		}
+		ea_get(cpu, &ea, mode, reg, size);
+		src = ea_read(cpu, &ea, size);
+		dst = cpu->d[dreg] & size_mask(size);
+	}
+
+	switch(line) {
+		case 0x8:
+			res = src | dst;
+			flags_logic(cpu, res, size);
+			break;
+
+		case 0x9:
+			res = alu_sub(cpu, src, dst, size, 0, 0);
+			break;
+
+		case 0xb:
+			if(!to_ea) {
+				alu_sub(cpu, src, dst, size, 0, 1);
+				cpu->cycles += ((size == 4) ? 6 : 4) + ea_time(mode, reg, size);
+				return;
+			}
+			res = src ^ dst;
+			flags_logic(cpu, res, size);
+			break;
+
+		case 0xc:
+			res = src & dst;
+			flags_logic(cpu, res, size);
+			break;
+
+		default:
+			res = alu_add(cpu, src, dst, size, 0);
+			break;
+	}
+
+	if(to_ea) {
+		ea_write(cpu, &ea, size, res);
+		cpu->cycles += ((size == 4) ? 12 : 8) + ea_time(mode, reg, size);
+	} else {
+		cpu->d[dreg] = (cpu->d[dreg] & ~size_mask(size)) | (res & size_mask(size));
+		if(size == 4) {
+			cpu->cycles += (mode <= 1 || (mode == 7 && reg == 4)) ? 8 : 6;
+		} else {
+			cpu->cycles += 4;
+		}
+		cpu->cycles += ea_time(mode, reg, size);
+	}
+}
+
+// Line E: shifts and rotates.  type is AS, LS, ROX or RO.
+static uint32_t
+shift(m68k_t *cpu, uint32_t val, int size, int type, int left, int count)
+{
+	uint32_t mask = size_mask(size);
+	uint32_t msb = size_msb(size);
+	uint16_t sr = cpu->sr & ~SR_NZVC;
+	int x = (cpu->sr & SR_X) != 0;
+	int c = 0;
+	int v = 0;
+	int out;
+	int i;
+
+	val &= mask;
+
+	for(i = 0; i < count; i++) {
+		if(left) {
+			out = (val & msb) != 0;
+			switch(type) {
+				case 0:
+				case 1:
+					val = (val << 1) & mask;
+					if(type == 0 && (((val & msb) != 0) != out)) {
+						v = 1;
+					}
+					x = out;
+					break;
+
+				case 2:
+					val = ((val << 1) | x) & mask;
+					x = out;
+					break;
+
+				default:
+					val = ((val << 1) | out) & mask;
+					break;
+			}
+		} else {
+			out = val & 1;
+			switch(type) {
+				case 0:
+					val = (val >> 1) | (val & msb);
+					x = out;
+					break;
+
+				case 1:
+					val >>= 1;
+					x = out;
+					break;
+
+				case 2:
+					val = (val >> 1) | (x ? msb : 0);
+					x = out;
+					break;
+
+				default:
+					val = (val >> 1) | (out ? msb : 0);
+					break;
+			}
+		}
+		c = out;
+	}
+
+	if(count == 0) {
+		// C is cleared, except ROXL/ROXR copy X into it.
+		c = (type == 2) ? x : 0;
+	} else if(type != 3) {
+		sr = (sr & ~SR_X) | (x ? SR_X : 0);
+	}
+
+	if(c) {
+		sr |= SR_C;
+	}
+	if(v) {
+		sr |= SR_V;
+	}
+	if(val == 0) {
+		sr |= SR_Z;
+	}
+	if(val & msb) {
+		sr |= SR_N;
+	}
+	cpu->sr = sr;
+
+	return val;
+}
+
+static void
+op_lineE(m68k_t *cpu, uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size = op_size(op);
+	int left = (op >> 8) & 1;
+	int count;
+	uint32_t val;
+	ea_t ea;
+
+	if(size == 0) {
+		// Memory, by one bit.
+		if(!ea_valid(mode, reg) || mode < 2 || (mode == 7 && reg > 1) || (op & 0x0800)) {
+			illegal(cpu);
+			return;
+		}
+		ea_get(cpu, &ea, mode, reg, 2);
+		val = ea_read(cpu, &ea, 2);
+		ea_write(cpu, &ea, 2, shift(cpu, val, 2, (op >> 9) & 3, left, 1));
+		cpu->cycles += 8 + ea_time(mode, reg, 2);
+		return;
+	}
+
+	if(op & 0x0020) {
+		count = cpu->d[(op >> 9) & 7] & 63;
+	} else {
+		count = ((op >> 9) & 7) ? ((op >> 9) & 7) : 8;
+	}
+
+	val = shift(cpu, cpu->d[reg], size, (op >> 3) & 3, left, count);
+	cpu->d[reg] = (cpu->d[reg] & ~size_mask(size)) | val;
+	cpu->cycles += ((size == 4) ? 8 : 6) + 2 * count;
+}
+
+static void
+execute(m68k_t *cpu, uint16_t op)
+{
+	switch(op >> 12) {
+		case 0x0:
+			op_line0(cpu, op);
+			break;
+
+		case 0x1:
+			op_move(cpu, op, 1);
+			break;
+
+		case 0x2:
+			op_move(cpu, op, 4);
+			break;
+
+		case 0x3:
+			op_move(cpu, op, 2);
+			break;
+
+		case 0x4:
+			op_line4(cpu, op);
+			break;
+
+		case 0x5:
+			op_line5(cpu, op);
+			break;
+
+		case 0x6:
+			op_line6(cpu, op);
+			break;
+
+		case 0x7:
+			if(op & 0x0100) {
+				illegal(cpu);
+				break;
+			}
+			cpu->d[(op >> 9) & 7] = (int8_t)op;
+			flags_logic(cpu, (int8_t)op, 4);
+			cpu->cycles += 4;
+			break;
+
+		case 0xa:
+			exception(cpu, M68K_VEC_LINE_A, cpu->ppc, CYC_TRAP);
+			break;
+
+		case 0xe:
+			op_lineE(cpu, op);
+			break;
+
+		case 0xf:
+			exception(cpu, M68K_VEC_LINE_F, cpu->ppc, CYC_TRAP);
+			break;
+
+		default:
+			op_alu(cpu, op);
+			break;
+	}
+}
+
+void
+m68k_init(m68k_t *cpu, const m68k_bus_t *bus, void *ctx)
+{
+	memset(cpu, 0, sizeof(m68k_t));
+	cpu->bus = bus;
+	cpu->ctx = ctx;
+}
+
+// Effective address calculation time, for tools that work out timing
+// without running the code.
+int
+m68k_ea_cycles(int mode, int reg, int size)
+{
+	return ea_valid(mode, reg) ? ea_time(mode, reg, size) : 0;
+}
+
+// Reset fetches the initial SSP and PC from the first two vectors, and
+// takes 40 clocks doing it.
+void
+m68k_reset(m68k_t *cpu)
+{
+	cpu->sr = SR_S | M68K_SR_IPL;
+	cpu->stopped = 0;
+	cpu->halted = 0;
+	cpu->ipl = 0;
+	cpu->a[7] = rd32(cpu, 0);
+	cpu->pc = rd32(cpu, 4);
+	cpu->cycles += 40;
+}
+
+// Execute one instruction, or take one interrupt.  Returns the number of
+// clock periods used.
+int
+m68k_step(m68k_t *cpu)
+{
+	uint64_t start = cpu->cycles;
+
+	cpu->last_vector = 0;
+	if(cpu->halted) {
+		cpu->cycles += 4;
+		return 4;
+	}
+
+	if(setjmp(cpu->fault)) {
+		// An address error aborted the instruction.  A second one
+		// while stacking the frame is a double fault.
+		if(setjmp(cpu->fault)) {
+			cpu->halted = 1;
+		} else {
+			address_exception(cpu);
+		}
+		return (int)(cpu->cycles - start);
+	}
+
+	if(cpu->ipl > ((cpu->sr >> 8) & 7)) {
+		interrupt(cpu, cpu->ipl);
+		return (int)(cpu->cycles - start);
+	}
+
+	if(cpu->stopped) {
+		cpu->cycles += 4;
+		return 4;
+	}
+
+	cpu->ppc = cpu->pc;
+	cpu->ir = fetch16(cpu);
+	execute(cpu, cpu->ir);
+
+	return (int)(cpu->cycles - start);
+}
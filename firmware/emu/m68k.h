@@ -0,0 +1,100 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// A small MC68000 core for the emulator.
+//
+// Instructions are executed one at a time, and each one is charged the
+// number of clock periods given in the timing tables of the M68000 User's
+// Manual (section 8), assuming zero wait states, which is what cpu_bus.vhd
+// gives us.  That is exact for everything except the few instructions
+// whose timing depends on the data (shifts, MULU/MULS, DIVU/DIVS, DBcc,
+// Bcc), and those are computed from the data as the real chip does.
+
+#ifndef _M68K_H_
+#define _M68K_H_
+
+#include <stdint.h>
+#include <setjmp.h>
+
+// Status register bits.
+#define M68K_SR_C		(0x0001)
+#define M68K_SR_V		(0x0002)
+#define M68K_SR_Z		(0x0004)
+#define M68K_SR_N		(0x0008)
+#define M68K_SR_X		(0x0010)
+#define M68K_SR_IPL		(0x0700)
+#define M68K_SR_S		(0x2000)
+#define M68K_SR_T		(0x8000)
+
+// Exception vectors that the core raises by itself.
+#define M68K_VEC_BUS_ERROR	(2)
+#define M68K_VEC_ADDRESS_ERROR	(3)
+#define M68K_VEC_ILLEGAL	(4)
+#define M68K_VEC_ZERO_DIVIDE	(5)
+#define M68K_VEC_CHK		(6)
+#define M68K_VEC_TRAPV		(7)
+#define M68K_VEC_PRIVILEGE	(8)
+#define M68K_VEC_LINE_A		(10)
+#define M68K_VEC_LINE_F		(11)
+#define M68K_VEC_TRAP_0		(32)
+
+// Clock periods to take an autovectored interrupt.
+#define M68K_CYCLES_INTERRUPT	(44)
+
+// The bus, as seen by the core.  The 68000 has a 16-bit data bus, so the
+// core splits longs into two word accesses.  Addresses are 24 bits.
+typedef struct {
+	uint8_t		(*read8)(void *ctx, uint32_t addr);
+	uint16_t	(*read16)(void *ctx, uint32_t addr);
+	void		(*write8)(void *ctx, uint32_t addr, uint8_t val);
+	void		(*write16)(void *ctx, uint32_t addr, uint16_t val);
+
+	// Interrupt acknowledge cycle.  Return the vector number.
+	int		(*iack)(void *ctx, int level);
+} m68k_bus_t;
+
+typedef struct m68k {
+	uint32_t	d[8];
+	uint32_t	a[8];		// a[7] is the active stack pointer
+	uint32_t	other_sp;	// USP in supervisor mode, SSP in user mode
+	uint32_t	pc;
+	uint16_t	sr;
+
+	uint32_t	ppc;		// Address of the current instruction
+	uint16_t	ir;		// Current opcode
+
+	int		ipl;		// Interrupt level requested by the devices
+	int		stopped;	// STOP executed, waiting for an interrupt
+	int		halted;		// Double fault - the processor is dead
+
+	uint64_t	cycles;		// Clock periods since reset
+	int		last_vector;	// Exception taken by the last step, or 0
+
+	const m68k_bus_t *bus;
+	void		*ctx;
+
+	jmp_buf		fault;		// Address errors abort the instruction
+	uint32_t	fault_addr;
+	int		fault_write;
+} m68k_t;
+
+extern void m68k_init(m68k_t *cpu, const m68k_bus_t *bus, void *ctx);
+extern void m68k_reset(m68k_t *cpu);
+extern int m68k_step(m68k_t *cpu);
+extern int m68k_ea_cycles(int mode, int reg, int size);
+
+#endif // _M68K_H_
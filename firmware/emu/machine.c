@@ -0,0 +1,656 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// The terminal, as seen by the firmware: ROM, RAM and frame RAM, the
+// UART, the keyboard, the DIP switches, the control and LED registers and
+// the timer, decoded the same way cpu_bus.vhd does it.  The peripherals only drive
+// the upper byte lane (bits 15-8), so they live at even addresses.
+//
+// All times are in 68000 clock periods (CPU_HZ), taken from the core's
+// cycle counter.  The devices are brought up to date after every
+// instruction, which is as fine-grained as the firmware can observe.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+
+// UART registers, by (address - UART_BASE) / 2.
+#define UART_RBR	(0)
+#define UART_IER	(1)
+#define UART_IIR	(2)
+#define UART_LCR	(3)
+#define UART_MCR	(4)
+#define UART_LSR	(5)
+#define UART_MSR	(6)
+#define UART_SCR	(7)
+
+#define LCR_DLAB	(0x80)
+#define MCR_RTS		(0x02)
+#define LSR_DR		(0x01)
+#define LSR_OE		(0x02)
+#define LSR_THRE	(0x20)
+#define LSR_TEMT	(0x40)
+
+// IIR interrupt identification, highest priority first.
+#define IIR_NONE	(0x01)
+#define IIR_RLS		(0x06)
+#define IIR_RDA		(0x04)
+#define IIR_TOI		(0x0c)
+#define IIR_THRE	(0x02)
+
+// The gh_uart_16550 timeout counter is loaded with 0x280 sixteenths of a
+// bit time for 8-bit words, which is four 10-bit characters.
+#define TIMEOUT_CHARS	(4)
+
+// A PS/2 scan code is 11 bits at about 12 kHz.
+#define KB_CODE_CYCLES	(CPU_HZ / 1000)
+
+static const int trigger_levels[4] = { 1, 4, 8, 14 };
+
+// One character (start, 8 data, stop) at the given divisor.  The baud
+// rate generator runs from the 88.5 MHz clock with 16x oversampling, so a
+// bit is 16 * divisor of those, or 8 * divisor 68000 clocks.
+uint64_t
+uart_byte_cycles(uint16_t divisor)
+{
+	return 80 * (uint64_t)(divisor ? divisor : 1);
+}
+
+static uint64_t
+now(MACHINE *m)
+{
+	return m->cpu.cycles;
+}
+
+static int
+uart_iir(UART *u)
+{
+	if((u->ier & 0x04) && u->lsr_errors) {
+		return IIR_RLS;
+	}
+	if((u->ier & 0x01) && u->rx_count >= u->rx_trigger) {
+		return IIR_RDA;
+	}
+	if((u->ier & 0x01) && u->toi) {
+		return IIR_TOI;
+	}
+	if((u->ier & 0x02) && u->thre_itr) {
+		return IIR_THRE;
+	}
+
+	return IIR_NONE;
+}
+
+static void
+tx_capture(MACHINE *m, uint8_t c)
+{
+	if(m->tx_len == m->tx_size) {
+		m->tx_size = m->tx_size ? m->tx_size * 2 : 256;
+		if((m->pTx = realloc(m->pTx, m->tx_size)) == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	m->pTx[m->tx_len++] = c;
+}
+
+static uint8_t
+uart_read(MACHINE *m, int reg)
+{
+	UART *u = &m->uart;
+	uint8_t val;
+	int iir;
+
+	switch(reg) {
+		case UART_RBR:
+			if(u->lcr & LCR_DLAB) {
+				return u->divisor & 0xff;
+			}
+			if(u->rx_count == 0) {
+				return 0;
+			}
+			val = u->rx_fifo[u->rx_head];
+			u->rx_head = (u->rx_head + 1) % UART_FIFO;
+			u->rx_count--;
+
+			// Reading restarts the timeout, or stops it once the
+			// FIFO is empty.
+			u->toi = 0;
+			u->rx_timeout = u->rx_count ?
+				now(m) + TIMEOUT_CHARS * uart_byte_cycles(u->divisor) : 0;
+			return val;
+
+		case UART_IER:
+			if(u->lcr & LCR_DLAB) {
+				return u->divisor >> 8;
+			}
+			return u->ier;
+
+		case UART_IIR:
+			iir = uart_iir(u);
+			if(iir == IIR_THRE) {
+				u->thre_itr = 0;
+			}
+			return 0xc0 | iir;
+
+		case UART_LCR:
+			return u->lcr;
+
+		case UART_MCR:
+			return u->mcr;
+
+		case UART_LSR:
+			val = u->lsr_errors;
+			u->lsr_errors = 0;
+			if(u->rx_count) {
+				val |= LSR_DR;
+			}
+			if(u->tx_count == 0) {
+				val |= LSR_THRE;
+				if(u->tx_done == 0) {
+					val |= LSR_TEMT;
+				}
+			}
+			return val;
+
+		case UART_MSR:
+			// CTS, DSR and DCD are always asserted.
+			return 0xb0;
+
+		default:
+			return u->scr;
+	}
+}
+
+static void
+uart_start_tx(MACHINE *m)
+{
+	UART *u = &m->uart;
+
+	u->tx_shift = u->tx_fifo[u->tx_head];
+	u->tx_head = (u->tx_head + 1) % UART_FIFO;
+	u->tx_count--;
+	u->tx_done = now(m) + uart_byte_cycles(u->divisor);
+	if(u->tx_count == 0) {
+		u->thre_itr = 1;
+	}
+}
+
+static void
+uart_write(MACHINE *m, int reg, uint8_t val)
+{
+	UART *u = &m->uart;
+
+	switch(reg) {
+		case UART_RBR:
+			if(u->lcr & LCR_DLAB) {
+				u->divisor = (u->divisor & 0xff00) | val;
+				return;
+			}
+			u->thre_itr = 0;
+			if(u->tx_count < UART_FIFO) {
+				u->tx_fifo[(u->tx_head + u->tx_count) % UART_FIFO] = val;
+				u->tx_count++;
+			}
+			if(u->tx_done == 0) {
+				uart_start_tx(m);
+			}
+			return;
+
+		case UART_IER:
+			if(u->lcr & LCR_DLAB) {
+				u->divisor = (u->divisor & 0x00ff) | (val << 8);
+				return;
+			}
+			if((val & ~u->ier & 0x02) && u->tx_count == 0) {
+				u->thre_itr = 1;
+			}
+			u->ier = val & 0x0f;
+			return;
+
+		case UART_IIR:
+			// FCR
+			if(val & 0x02) {
+				u->rx_count = 0;
+				u->rx_head = 0;
+				u->toi = 0;
+				u->rx_timeout = 0;
+			}
+			if(val & 0x04) {
+				u->tx_count = 0;
+				u->tx_head = 0;
+			}
+			u->rx_trigger = trigger_levels[val >> 6];
+			return;
+
+		case UART_LCR:
+			u->lcr = val;
+			return;
+
+		case UART_MCR:
+			u->mcr = val;
+			return;
+
+		case UART_SCR:
+			u->scr = val;
+			return;
+	}
+}
+
+// A character has come in off the wire.
+static void
+uart_rx(MACHINE *m, uint8_t c, uint64_t when)
+{
+	UART *u = &m->uart;
+
+	if(u->rx_count == UART_FIFO) {
+		u->lsr_errors |= LSR_OE;
+		u->overruns++;
+		return;
+	}
+
+	u->rx_fifo[(u->rx_head + u->rx_count) % UART_FIFO] = c;
+	u->rx_count++;
+	u->rx_timeout = when + TIMEOUT_CHARS * uart_byte_cycles(u->divisor);
+}
+
+static int
+sender_may_start(MACHINE *m)
+{
+	switch(m->sender.flow) {
+		case FLOW_RTS:
+			return (m->uart.mcr & MCR_RTS) != 0;
+
+		case FLOW_XON:
+			return !m->sender.xoff;
+
+		default:
+			return 1;
+	}
+}
+
+static void
+sender_update(MACHINE *m)
+{
+	SENDER *s = &m->sender;
+	uint64_t t = now(m);
+
+	while(s->pos < s->len) {
+		if(s->next == 0) {
+			if(!sender_may_start(m)) {
+				return;
+			}
+			if(s->pos == 0) {
+				s->first = t;
+			}
+			s->next = t + s->interval;
+		}
+
+		if(t < s->next) {
+			return;
+		}
+
+		if(s->pData[s->pos]) {
+			s->nonnull++;
+		}
+		uart_rx(m, s->pData[s->pos++], s->next);
+		s->last = s->next;
+
+		// The next byte follows immediately, unless we have been
+		// told to stop.
+		if(s->pos < s->len && sender_may_start(m)) {
+			s->next += s->interval;
+		} else {
+			s->next = 0;
+		}
+	}
+}
+
+static void
+uart_update(MACHINE *m)
+{
+	UART *u = &m->uart;
+	uint64_t t = now(m);
+
+	while(u->tx_done && t >= u->tx_done) {
+		tx_capture(m, u->tx_shift);
+		if(m->sender.flow == FLOW_XON) {
+			if(u->tx_shift == XOFF) {
+				m->sender.xoff = 1;
+			} else if(u->tx_shift == XON) {
+				m->sender.xoff = 0;
+			}
+		}
+
+		if(u->tx_count) {
+			u->tx_shift = u->tx_fifo[u->tx_head];
+			u->tx_head = (u->tx_head + 1) % UART_FIFO;
+			u->tx_count--;
+			u->tx_done += uart_byte_cycles(u->divisor);
+			if(u->tx_count == 0) {
+				u->thre_itr = 1;
+			}
+		} else {
+			u->tx_done = 0;
+		}
+	}
+
+	sender_update(m);
+
+	if(u->rx_count == 0) {
+		u->toi = 0;
+		u->rx_timeout = 0;
+	} else if(u->rx_timeout && t >= u->rx_timeout) {
+		u->toi = 1;
+		u->rx_timeout = 0;
+	}
+}
+
+static uint8_t
+kb_read(MACHINE *m, int reg)
+{
+	KEYBOARD *k = &m->kb;
+	uint8_t val;
+
+	if(reg == 1) {
+		return k->ready;
+	}
+
+	if(!k->ready) {
+		return 0;
+	}
+
+	val = k->queue[k->head];
+	k->head = (k->head + 1) % sizeof(k->queue);
+	k->count--;
+	k->ready = 0;
+	k->next = now(m) + KB_CODE_CYCLES;
+
+	return val;
+}
+
+static void
+kb_update(MACHINE *m)
+{
+	KEYBOARD *k = &m->kb;
+
+	if(!k->ready && k->count && now(m) >= k->next) {
+		k->ready = 1;
+	}
+}
+
+// The timer counts the 88.5 MHz clock, two per 68000 clock period.
+static uint16_t
+timer_read(MACHINE *m, int reg)
+{
+	uint32_t t = 2 * now(m);
+
+	switch(reg) {
+		case 0:
+			m->timer_low = t;
+			return t >> 16;
+		case 1:
+			return m->timer_low;
+		case 2:
+			return (2 * m->uart_stamp) >> 16;
+		default:
+			return 2 * m->uart_stamp;
+	}
+}
+
+static uint16_t
+bus_read16(void *ctx, uint32_t addr)
+{
+	MACHINE *m = ctx;
+
+	if(addr < ROM_BASE + ROM_SIZE) {
+		return (m->rom[addr] << 8) | m->rom[addr + 1];
+	}
+	if(addr >= RAM_BASE && addr < RAM_BASE + RAM_SIZE) {
+		addr -= RAM_BASE;
+		return (m->ram[addr] << 8) | m->ram[addr + 1];
+	}
+	if(addr >= FRAME_BASE && addr < FRAME_BASE + 2 * FRAME_WORDS) {
+		return m->frame[(addr - FRAME_BASE) >> 1];
+	}
+	if(addr >= UART_BASE && addr < UART_BASE + 16) {
+		return uart_read(m, (addr - UART_BASE) >> 1) << 8;
+	}
+	if((addr & ~1) == DIP_ADDR) {
+		return m->dip << 8;
+	}
+	if(addr >= KB_BASE && addr < KB_BASE + 16) {
+		return kb_read(m, (addr - KB_BASE) >> 1) << 8;
+	}
+	if(addr >= TIMER_BASE && addr < TIMER_BASE + 8) {
+		return timer_read(m, (addr - TIMER_BASE) >> 1);
+	}
+
+	// Nothing there - the bus reads as zero.
+	return 0;
+}
+
+static uint8_t
+bus_read8(void *ctx, uint32_t addr)
+{
+	uint16_t val = bus_read16(ctx, addr & ~1);
+
+	return (addr & 1) ? (val & 0xff) : (val >> 8);
+}
+
+// The 68000 puts a byte being written on both halves of the data bus, so
+// the peripherals see the same value whichever address is used.
+static void
+bus_write(MACHINE *m, uint32_t addr, uint16_t val, int lanes)
+{
+	uint16_t *p;
+
+	if(addr >= RAM_BASE && addr < RAM_BASE + RAM_SIZE) {
+		addr -= RAM_BASE;
+		if(lanes & 2) {
+			m->ram[addr & ~1] = val >> 8;
+		}
+		if(lanes & 1) {
+			m->ram[addr | 1] = val;
+		}
+		return;
+	}
+	if(addr >= FRAME_BASE && addr < FRAME_BASE + 2 * FRAME_WORDS) {
+		p = &m->frame[(addr - FRAME_BASE) >> 1];
+		if(lanes & 2) {
+			*p = (*p & 0x00ff) | (val & 0xff00);
+		}
+		if(lanes & 1) {
+			*p = (*p & 0xff00) | (val & 0x00ff);
+		}
+		m->last_frame_write = now(m);
+		return;
+	}
+	if(addr >= UART_BASE && addr < UART_BASE + 16) {
+		uart_write(m, (addr - UART_BASE) >> 1, val >> 8);
+		return;
+	}
+	if((addr & ~1) == CONTROL_ADDR) {
+		m->control = val >> 8;
+		return;
+	}
+	if((addr & ~1) == LED_ADDR) {
+		m->leds = val >> 8;
+		return;
+	}
+}
+
+static void
+bus_write16(void *ctx, uint32_t addr, uint16_t val)
+{
+	bus_write(ctx, addr, val, 3);
+}
+
+static void
+bus_write8(void *ctx, uint32_t addr, uint8_t val)
+{
+	bus_write(ctx, addr, (val << 8) | val, (addr & 1) ? 1 : 2);
+}
+
+// Autovectors: cpu_bus.vhd answers level n with vector 0x18 + n.
+static int
+bus_iack(void *ctx, int level)
+{
+	return 0x18 + level;
+}
+
+static const m68k_bus_t bus = {
+	bus_read8,
+	bus_read16,
+	bus_write8,
+	bus_write16,
+	bus_iack,
+};
+
+static void
+update_ipl(MACHINE *m)
+{
+	uint8_t irq = 0;
+
+	if(uart_iir(&m->uart) != IIR_NONE) {
+		irq |= 1 << UART_LEVEL;
+	}
+	if(m->kb.ready) {
+		irq |= 1 << KB_LEVEL;
+	}
+
+	// cpu_bus.vhd stamps the time when the UART interrupt goes up.
+	if((irq & ~m->irq) & (1 << UART_LEVEL)) {
+		m->uart_stamp = now(m);
+	}
+	m->irq = irq;
+
+	if(irq & (1 << UART_LEVEL)) {
+		m->cpu.ipl = UART_LEVEL;
+	} else if(irq & (1 << KB_LEVEL)) {
+		m->cpu.ipl = KB_LEVEL;
+	} else {
+		m->cpu.ipl = 0;
+	}
+}
+
+// Power up with the given ROM image and DIP switch settings.
+void
+machine_init(MACHINE *m, uint8_t *pRom, int len, uint8_t dip)
+{
+	free(m->pTx);
+	memset(m, 0, sizeof(MACHINE));
+
+	if(len > ROM_SIZE) {
+		len = ROM_SIZE;
+	}
+	memcpy(m->rom, pRom, len);
+	m->dip = dip;
+
+	m->uart.rx_trigger = 1;
+	m->uart.lsr_errors = 0;
+
+	m68k_init(&m->cpu, &bus, m);
+	m68k_reset(&m->cpu);
+}
+
+// Run one instruction (or interrupt), then bring the devices up to date.
+// Returns the clock periods used.
+int
+machine_step(MACHINE *m)
+{
+	int cycles = m68k_step(&m->cpu);
+
+	uart_update(m);
+	kb_update(m);
+	update_ipl(m);
+
+	return cycles;
+}
+
+// Start the far end sending.  interval is the time for one character on
+// the wire, in clock periods.
+void
+machine_send(MACHINE *m, const uint8_t *pData, int len, uint64_t interval, int flow)
+{
+	SENDER *s = &m->sender;
+
+	memset(s, 0, sizeof(SENDER));
+	s->pData = pData;
+	s->len = len;
+	s->interval = interval;
+	s->flow = flow;
+}
+
+int
+machine_sender_done(MACHINE *m)
+{
+	return m->sender.pos == m->sender.len && m->uart.rx_count == 0;
+}
+
+void
+machine_key(MACHINE *m, uint8_t scan_code)
+{
+	KEYBOARD *k = &m->kb;
+
+	if(k->count < (int)sizeof(k->queue)) {
+		k->queue[(k->head + k->count) % sizeof(k->queue)] = scan_code;
+		k->count++;
+	}
+}
+
+// Read memory without side effects, for peeking at the stack.
+uint32_t
+machine_read32(MACHINE *m, uint32_t addr)
+{
+	uint32_t val = 0;
+	int i;
+
+	for(i = 0; i < 4; i++) {
+		uint32_t a = (addr + i) & 0xffffff;
+		uint8_t b = 0;
+
+		if(a < ROM_BASE + ROM_SIZE) {
+			b = m->rom[a];
+		} else if(a >= RAM_BASE && a < RAM_BASE + RAM_SIZE) {
+			b = m->ram[a - RAM_BASE];
+		}
+		val = (val << 8) | b;
+	}
+
+	return val;
+}
+
+// Print the frame RAM as 24 lines of 80 characters.  The cursor bit and
+// any control characters are shown as they would look: not at all.
+void
+machine_screen(MACHINE *m, FILE *fp)
+{
+	int row;
+	int col;
+	uint8_t c;
+
+	for(row = 0; row < ROWS; row++) {
+		for(col = 0; col < COLUMNS; col++) {
+			c = m->frame[row * COLUMNS + col] & 0x7f;
+			fputc((c < 0x20 || c == 0x7f) ? ' ' : c, fp);
+		}
+		fputc('\n', fp);
+	}
+}
@@ -0,0 +1,152 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _MACHINE_H_
+#define _MACHINE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "m68k.h"
+
+// The CPU clock is 88.5 MHz, but fx68k takes two of them (enPhi1 and
+// enPhi2) for each 68000 clock period.
+#define CPU_HZ		(44250000)
+
+// Memory map, as decoded by cpu_bus.vhd.
+#define ROM_BASE	(0x0000)
+#define ROM_SIZE	(0x4000)
+#define RAM_BASE	(0x4000)
+#define RAM_SIZE	(0x4000)
+#define FRAME_BASE	(0x8000)
+#define FRAME_WORDS	(1920)
+#define UART_BASE	(0xc000)
+#define DIP_ADDR	(0xc020)
+#define KB_BASE		(0xc040)
+#define CONTROL_ADDR	(0xc060)
+#define LED_ADDR	(0xc080)
+#define TIMER_BASE	(0xc0a0)
+
+#define COLUMNS		(80)
+#define ROWS		(24)
+
+// Interrupt levels, from cpu_bus.vhd.
+#define UART_LEVEL	(3)
+#define KB_LEVEL	(2)
+
+// DIP switches, as read by uart_set_baud().
+#define DIP_BAUD_MASK	(0x0f)
+#define DIP_SW_FLOW	(0x10)
+
+#define UART_FIFO	(16)
+
+// How the far end reacts to our flow control.
+#define FLOW_NONE	(0)	// Ignore it
+#define FLOW_RTS	(1)	// Stop sending while RTS is deasserted
+#define FLOW_XON	(2)	// Stop sending between XOFF and XON
+
+#define XON		(0x11)
+#define XOFF		(0x13)
+
+// The UART is a 16550 with the FIFOs always enabled (gh_uart_16550).
+typedef struct {
+	uint8_t		rx_fifo[UART_FIFO];
+	int		rx_head;
+	int		rx_count;
+	int		rx_trigger;
+	uint64_t	rx_timeout;		// Character timeout deadline, or 0
+	int		toi;			// Character timeout pending
+
+	uint8_t		tx_fifo[UART_FIFO];
+	int		tx_head;
+	int		tx_count;
+	uint64_t	tx_done;		// Shift register finishes, or 0
+	uint8_t		tx_shift;
+	int		thre_itr;		// THR empty interrupt pending
+
+	uint8_t		ier;
+	uint8_t		lcr;
+	uint8_t		mcr;
+	uint8_t		lsr_errors;		// OE, sticky until LSR is read
+	uint8_t		scr;
+	uint16_t	divisor;
+
+	long		overruns;
+} UART;
+
+// The keyboard controller holds one scan code at a time.
+typedef struct {
+	uint8_t		queue[64];
+	int		head;
+	int		count;
+	int		ready;
+	uint64_t	next;			// When the next code arrives
+} KEYBOARD;
+
+// The far end of the serial line.
+typedef struct {
+	const uint8_t	*pData;
+	int		len;
+	int		pos;
+	uint64_t	interval;		// Cycles per byte on the wire
+	int		flow;
+	uint64_t	next;			// Current byte completes, or 0
+	int		xoff;			// We sent XOFF
+
+	long		nonnull;		// Non-null bytes delivered
+	uint64_t	first;			// When the first byte began
+	uint64_t	last;			// When the last byte completed
+} SENDER;
+
+typedef struct machine {
+	m68k_t		cpu;
+
+	uint8_t		rom[ROM_SIZE];
+	uint8_t		ram[RAM_SIZE];
+	uint16_t	frame[FRAME_WORDS];
+	uint8_t		dip;
+	uint8_t		control;
+	uint8_t		leds;
+
+	UART		uart;
+	KEYBOARD	kb;
+	SENDER		sender;
+
+	// Everything the terminal transmitted.
+	uint8_t		*pTx;
+	int		tx_len;
+	int		tx_size;
+
+	uint64_t	last_frame_write;
+
+	// The free-running timer in cpu_bus.vhd.
+	uint16_t	timer_low;		// Latched by reading the high word
+	uint64_t	uart_stamp;		// When the UART interrupt went up
+
+	uint8_t		irq;			// Levels being requested, as bits
+} MACHINE;
+
+extern void machine_init(MACHINE *m, uint8_t *pRom, int len, uint8_t dip);
+extern int machine_step(MACHINE *m);
+extern void machine_send(MACHINE *m, const uint8_t *pData, int len, uint64_t interval, int flow);
+extern int machine_sender_done(MACHINE *m);
+extern void machine_key(MACHINE *m, uint8_t scan_code);
+extern uint32_t machine_read32(MACHINE *m, uint32_t addr);
+extern void machine_screen(MACHINE *m, FILE *fp);
+extern uint64_t uart_byte_cycles(uint16_t divisor);
+
+#endif // _MACHINE_H_
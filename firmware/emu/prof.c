@@ -0,0 +1,351 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Sampling profiler.  Every interval clock periods we note which function
+// the program counter is in, and the chain of calls that got us there.
+//
+// The call chain is a shadow of the real stack: JSR and BSR push a frame,
+// and a frame is popped once the stack pointer rises above the return
+// address it was entered with, which covers RTS, RTE and anything else
+// that unwinds the stack.  An exception starts a new chain, so time in
+// _level3 shows up on its own rather than under whatever it interrupted.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prof.h"
+#include "sym.h"
+
+#define MAX_DEPTH	(32)
+#define MAX_NODES	(8192)
+
+typedef struct {
+	int		sym;		// Function, as a symbol index + 1
+	uint32_t	sp;		// Stack pointer just after the call
+	int		exception;	// Entered by an exception, not a call
+} FRAME;
+
+// One node of the call tree, for a function reached by a given path.
+typedef struct {
+	int		sym;
+	int		parent;
+	int		child;
+	int		sibling;
+	long		self;
+	long		total;
+} NODE;
+
+static FRAME frames[MAX_DEPTH];
+static int depth;
+
+static NODE nodes[MAX_NODES];
+static int num_nodes;
+static int roots;
+
+static uint32_t interval;
+static uint64_t next_sample;
+static long samples;
+static long dropped;
+
+// Per function, indexed by symbol index + 1, so that 0 is "no symbol".
+static long *pSelf;
+static long *pTotal;
+static long *pSeen;
+
+static int
+func(uint32_t pc)
+{
+	return sym_index(pc) + 1;
+}
+
+static char *
+func_name(int f)
+{
+	uint32_t addr;
+
+	return sym_get(f - 1, &addr);
+}
+
+static int
+is_call(uint16_t op)
+{
+	return (op & 0xffc0) == 0x4e80 ||	// JSR
+		(op & 0xff00) == 0x6100;	// BSR
+}
+
+static void
+push(int sym, uint32_t sp, int exception)
+{
+	// Too deep to track.  The frames we do have still pop correctly,
+	// because they go by the stack pointer.
+	if(depth == MAX_DEPTH) {
+		return;
+	}
+
+	frames[depth].sym = sym;
+	frames[depth].sp = sp;
+	frames[depth].exception = exception;
+	depth++;
+}
+
+static int
+find_node(int parent, int sym)
+{
+	int *pLink = (parent < 0) ? &roots : &nodes[parent].child;
+	int i;
+
+	for(i = *pLink; i >= 0; i = nodes[i].sibling) {
+		if(nodes[i].sym == sym) {
+			return i;
+		}
+	}
+
+	if(num_nodes == MAX_NODES) {
+		return -1;
+	}
+
+	i = num_nodes++;
+	nodes[i].sym = sym;
+	nodes[i].parent = parent;
+	nodes[i].child = -1;
+	nodes[i].sibling = *pLink;
+	nodes[i].self = 0;
+	nodes[i].total = 0;
+	*pLink = i;
+
+	return i;
+}
+
+static void
+sample(uint32_t pc)
+{
+	int path[MAX_DEPTH + 1];
+	int len = 0;
+	int first;
+	int node;
+	int i;
+
+	// Start from the most recent exception, if there is one.
+	for(first = depth - 1; first > 0; first--) {
+		if(frames[first].exception) {
+			break;
+		}
+	}
+	for(i = (first < 0) ? 0 : first; i < depth; i++) {
+		path[len++] = frames[i].sym;
+	}
+
+	// We can be in a function that was jumped to rather than called.
+	i = func(pc);
+	if(len == 0 || path[len - 1] != i) {
+		path[len++] = i;
+	}
+
+	samples++;
+	pSelf[path[len - 1]]++;
+	for(i = 0; i < len; i++) {
+		// Count recursion once.
+		if(pSeen[path[i]] != samples) {
+			pSeen[path[i]] = samples;
+			pTotal[path[i]]++;
+		}
+	}
+
+	node = -1;
+	for(i = 0; i < len; i++) {
+		if((node = find_node(node, path[i])) < 0) {
+			dropped++;
+			return;
+		}
+		nodes[node].total++;
+	}
+	nodes[node].self++;
+}
+
+// Start a new profile.  Whatever was on the stack before now is not
+// tracked, so functions that are already running (main) only show up
+// when the program counter is in them.
+void
+prof_start(m68k_t *cpu, uint32_t every)
+{
+	int n = sym_count() + 1;
+
+	free(pSelf);
+	free(pTotal);
+	free(pSeen);
+	if((pSelf = calloc(n, sizeof(long))) == NULL ||
+			(pTotal = calloc(n, sizeof(long))) == NULL ||
+			(pSeen = calloc(n, sizeof(long))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	depth = 0;
+	num_nodes = 0;
+	roots = -1;
+	samples = 0;
+	dropped = 0;
+	interval = every ? every : 1;
+	next_sample = cpu->cycles + interval;
+}
+
+// Call after each m68k_step().  The cycles of a call are charged to the
+// caller and those of a return to the callee, but an exception is charged
+// to its handler.
+void
+prof_step(m68k_t *cpu, int cycles)
+{
+	uint32_t pc;
+
+	if(cpu->last_vector) {
+		push(func(cpu->pc), cpu->a[7], 1);
+		pc = cpu->pc;
+	} else {
+		pc = cpu->ppc;
+	}
+
+	while(cpu->cycles >= next_sample) {
+		sample(pc);
+		next_sample += interval;
+	}
+
+	while(depth > 0 && frames[depth - 1].sp < cpu->a[7]) {
+		depth--;
+	}
+
+	if(!cpu->last_vector && !cpu->stopped && !cpu->halted && is_call(cpu->ir)) {
+		push(func(cpu->pc), cpu->a[7], 0);
+	}
+}
+
+static int
+compare_funcs(const void *a, const void *b)
+{
+	int fA = *(const int *)a;
+	int fB = *(const int *)b;
+
+	if(pSelf[fA] != pSelf[fB]) {
+		return (pSelf[fA] < pSelf[fB]) ? 1 : -1;
+	}
+	if(pTotal[fA] != pTotal[fB]) {
+		return (pTotal[fA] < pTotal[fB]) ? 1 : -1;
+	}
+
+	return fA - fB;
+}
+
+static int
+compare_nodes(const void *a, const void *b)
+{
+	const NODE *pA = &nodes[*(const int *)a];
+	const NODE *pB = &nodes[*(const int *)b];
+
+	if(pA->total != pB->total) {
+		return (pA->total < pB->total) ? 1 : -1;
+	}
+
+	return pA->sym - pB->sym;
+}
+
+static double
+percent(long n)
+{
+	return 100.0 * n / (samples ? samples : 1);
+}
+
+// Print a node and its children, biggest first.
+static void
+report_node(FILE *fp, int node, int level, double cutoff)
+{
+	int *pList;
+	int n = 0;
+	int i;
+
+	if(node >= 0) {
+		if(percent(nodes[node].total) < cutoff) {
+			return;
+		}
+		fprintf(fp, "  %6.1f%% %6.1f%%  %*s%s\n",
+				percent(nodes[node].total),
+				percent(nodes[node].self),
+				level * 2, "",
+				func_name(nodes[node].sym));
+	}
+
+	for(i = (node < 0) ? roots : nodes[node].child; i >= 0; i = nodes[i].sibling) {
+		n++;
+	}
+	if(n == 0) {
+		return;
+	}
+	if((pList = malloc(n * sizeof(int))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	n = 0;
+	for(i = (node < 0) ? roots : nodes[node].child; i >= 0; i = nodes[i].sibling) {
+		pList[n++] = i;
+	}
+	qsort(pList, n, sizeof(int), compare_nodes);
+
+	for(i = 0; i < n; i++) {
+		report_node(fp, pList[i], level + 1, cutoff);
+	}
+	free(pList);
+}
+
+// Print the flat profile and the call tree, leaving out anything that
+// took less than cutoff percent of the samples.
+void
+prof_report(FILE *fp, double cutoff)
+{
+	int n = sym_count() + 1;
+	int *pList;
+	int count = 0;
+	int i;
+
+	if((pList = malloc(n * sizeof(int))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for(i = 0; i < n; i++) {
+		if(pTotal[i] && percent(pTotal[i]) >= cutoff) {
+			pList[count++] = i;
+		}
+	}
+	qsort(pList, count, sizeof(int), compare_funcs);
+
+	fprintf(fp, "  profile: %ld samples, one every %u cycles\n", samples, interval);
+	fprintf(fp, "  %7s %7s  %s\n", "self", "total", "function");
+	for(i = 0; i < count; i++) {
+		fprintf(fp, "  %6.1f%% %6.1f%%  %s\n",
+				percent(pSelf[pList[i]]),
+				percent(pTotal[pList[i]]),
+				func_name(pList[i]));
+	}
+	free(pList);
+
+	fprintf(fp, "\n  %7s %7s  %s\n", "total", "self", "call path");
+	report_node(fp, -1, -1, cutoff);
+	if(dropped) {
+		fprintf(fp, "  (%ld samples had too many call paths to track)\n", dropped);
+	}
+}
@@ -0,0 +1,30 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "m68k.h"
+
+extern void prof_start(m68k_t *cpu, uint32_t interval);
+extern void prof_step(m68k_t *cpu, int cycles);
+extern void prof_report(FILE *fp, double cutoff);
+
+#endif // _PROF_H_
@@ -0,0 +1,587 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Search for the byte streams that cost the firmware the most clock
+// periods per received byte.
+//
+// A candidate is a short pattern, repeated to make a stream, so that we
+// measure what it costs to keep doing it rather than what it costs once.
+// We start from a dictionary of the sequences that screen.c handles,
+// with the parameters that make them do the most work (CSI 999 A, LF at
+// the bottom margin, ESC [ 2 J, long parameter lists and so on), keep the
+// most expensive patterns found so far, and make new ones by mutating and
+// splicing those.  Each stream is run the way emu does its flow
+// controlled run, from a snapshot of the machine taken once it has
+// booted.
+//
+// The survivors are written out as a regression corpus: one file per
+// stream, and an index (CYCLES) with the cycles per byte of each.  With
+// -c, the corpus is measured again and compared with the index.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "machine.h"
+#include "stream.h"
+#include "sym.h"
+
+// DIP switch setting 13, and its divisor from uart.c.
+#define FASTEST_DIP	(13)
+#define FASTEST_DIVISOR	(6)
+
+#define PATTERN_MAX	(128)
+#define POPULATION_MAX	(64)
+
+// A check fails if a stream has got this much more expensive.
+#define CHECK_SLACK	(0.05)
+
+typedef struct {
+	uint8_t		data[PATTERN_MAX];
+	int		len;
+	double		cost;		// Clock periods per byte
+} PATTERN;
+
+static const char *dictionary[] = {
+	"\033[999A",			// CUU, CUD, CUF, CUB past the edges
+	"\033[999B",
+	"\033[999C",
+	"\033[999D",
+	"\033[H",			// CUP
+	"\033[24;80H",
+	"\033[24H",
+	"\033[99999;99999f",		// HVP
+	"\n",				// LF, and at the bottom, a scroll
+	"\013",				// VT and FF are LF too
+	"\014",
+	"\r",
+	"\b",
+	"\t",
+	"\033D",			// IND
+	"\033E",			// NEL
+	"\033M",			// RI, and at the top, a scroll down
+	"\0337",			// DECSC
+	"\0338",			// DECRC
+	"\033c",			// RIS
+	"\033#8",			// DECALN
+	"\033[J",			// ED
+	"\033[1J",
+	"\033[2J",
+	"\033[K",			// EL
+	"\033[1K",
+	"\033[2K",
+	"\033[r",			// DECSTBM
+	"\033[2;23r",
+	"\033[12;13r",
+	"\033[?6h",			// DECOM
+	"\033[?6l",
+	"\033[?3h",			// DECCOLM
+	"\033[?7h",			// DECAWM
+	"\033[?7l",
+	"\033[6n",			// DSR, which sends a reply
+	"\033[c",			// DA, likewise
+	"\033[1;2;3;4;5;6;7;8;9;10;11;12;13;14;15;16;17;18;19;20m",
+	"\033[99999999999999999999A",
+	"\033[;;;;;;;;;;;;;;;;;;;;H",
+	"\033[?1;2;3;4;5;6;7;8;9;10;11;12;13;14;15;16h",
+	"\033P1;2;3|0123456789\033\\",	// DCS, which is ignored
+	"\033]0;title\007",		// OSC, likewise
+	"A",
+	"~",
+	" ",
+	"\0",
+};
+
+#define DICTIONARY_SIZE	((int)(sizeof(dictionary) / sizeof(dictionary[0])))
+
+static MACHINE machine;
+static MACHINE booted;
+static uint8_t *pRom;
+static int rom_len;
+
+static PATTERN population[POPULATION_MAX];
+static int population_size;
+static int keep = 16;
+static int stream_len = 512;
+
+static uint8_t *pStream;
+
+// xorshift32, so that a given seed always gives the same search.
+static uint32_t seed = 1;
+
+static uint32_t
+random_number(uint32_t n)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+
+	return seed % n;
+}
+
+// The dictionary entries contain nulls, so we need their lengths.
+static int
+entry_len(int i)
+{
+	return (dictionary[i][0] == 0) ? 1 : strlen(dictionary[i]);
+}
+
+// Run a stream from the booted snapshot, and return the clock periods
+// per byte.  A stream that makes the firmware give up counts as the
+// slowest possible.
+static double
+measure(const uint8_t *pData, int len)
+{
+	RESULT r;
+
+	free(machine.pTx);
+	machine = booted;
+	machine.cpu.ctx = &machine;
+	stream_run(&machine, pData, len, uart_byte_cycles(FASTEST_DIVISOR), FLOW_RTS, NULL, &r);
+	if(r.timed_out) {
+		return 1e9;
+	}
+
+	return (double)r.busy / len;
+}
+
+// Repeat the pattern to make a stream of at least stream_len bytes.
+static int
+expand(PATTERN *p)
+{
+	int reps = (stream_len + p->len - 1) / p->len;
+	int i;
+
+	for(i = 0; i < reps; i++) {
+		memcpy(pStream + i * p->len, p->data, p->len);
+	}
+
+	return reps * p->len;
+}
+
+static void
+evaluate(PATTERN *p)
+{
+	p->cost = measure(pStream, expand(p));
+}
+
+static int
+insert(PATTERN *p, int at, const uint8_t *pData, int len)
+{
+	if(p->len + len > PATTERN_MAX) {
+		return 0;
+	}
+
+	memmove(p->data + at + len, p->data + at, p->len - at);
+	memcpy(p->data + at, pData, len);
+	p->len += len;
+
+	return 1;
+}
+
+static void
+delete(PATTERN *p, int at, int len)
+{
+	if(at + len > p->len) {
+		len = p->len - at;
+	}
+	if(p->len - len < 1) {
+		return;
+	}
+
+	memmove(p->data + at, p->data + at + len, p->len - at - len);
+	p->len -= len;
+}
+
+// Bytes that are likely to mean something to the parser.
+static uint8_t
+interesting_byte()
+{
+	static const char bytes[] = "\033[;?0123456789ABCDHJKMfhlmnr\n\r\b\t";
+
+	if(random_number(4) == 0) {
+		return random_number(256);
+	}
+
+	return bytes[random_number(sizeof(bytes) - 1)];
+}
+
+// Replace a run of digits (or insert one) with a number of up to five
+// digits, or a very long one.
+static void
+renumber(PATTERN *p)
+{
+	char number[32];
+	int at = random_number(p->len);
+	int len = 0;
+
+	while(at > 0 && p->data[at - 1] >= '0' && p->data[at - 1] <= '9') {
+		at--;
+	}
+	while(at + len < p->len && p->data[at + len] >= '0' && p->data[at + len] <= '9') {
+		len++;
+	}
+
+	if(random_number(8) == 0) {
+		strcpy(number, "99999999999999999999");
+	} else {
+		sprintf(number, "%u", random_number(100000) >> random_number(17));
+	}
+
+	delete(p, at, len);
+	insert(p, at, (uint8_t *)number, strlen(number));
+}
+
+static void
+mutate(PATTERN *p)
+{
+	PATTERN *pOther;
+	int count = 1 + random_number(3);
+	int at;
+	int len;
+	int i;
+
+	while(count--) {
+		at = random_number(p->len + 1);
+		switch(random_number(6)) {
+			case 0:
+				i = random_number(DICTIONARY_SIZE);
+				insert(p, at, (uint8_t *)dictionary[i], entry_len(i));
+				break;
+
+			case 1:
+				if(at < p->len) {
+					delete(p, at, 1 + random_number(8));
+				}
+				break;
+
+			case 2:
+				if(at < p->len) {
+					p->data[at] = interesting_byte();
+				} else {
+					uint8_t c = interesting_byte();
+
+					insert(p, at, &c, 1);
+				}
+				break;
+
+			case 3:
+				// Repeat part of the pattern.
+				i = random_number(p->len);
+				len = 1 + random_number(p->len - i);
+				if(p->len + len <= PATTERN_MAX) {
+					uint8_t copy[PATTERN_MAX];
+
+					memcpy(copy, p->data + i, len);
+					insert(p, at, copy, len);
+				}
+				break;
+
+			case 4:
+				renumber(p);
+				break;
+
+			case 5:
+				// Splice in part of another survivor.
+				pOther = &population[random_number(population_size)];
+				i = random_number(pOther->len);
+				len = 1 + random_number(pOther->len - i);
+				insert(p, at, pOther->data + i, len);
+				break;
+		}
+	}
+}
+
+static int
+compare_patterns(const void *a, const void *b)
+{
+	const PATTERN *pA = a;
+	const PATTERN *pB = b;
+
+	return (pA->cost < pB->cost) - (pA->cost > pB->cost);
+}
+
+// Keep the pattern if it beats the cheapest survivor and isn't one we
+// already have.
+static void
+consider(PATTERN *p)
+{
+	int i;
+
+	for(i = 0; i < population_size; i++) {
+		if(population[i].len == p->len && memcmp(population[i].data, p->data, p->len) == 0) {
+			return;
+		}
+	}
+
+	if(population_size < keep) {
+		population[population_size++] = *p;
+	} else if(p->cost > population[keep - 1].cost) {
+		population[keep - 1] = *p;
+	} else {
+		return;
+	}
+
+	qsort(population, population_size, sizeof(PATTERN), compare_patterns);
+}
+
+// Print a pattern with the control characters spelled out.
+static void
+print_pattern(FILE *fp, PATTERN *p)
+{
+	int i;
+	uint8_t c;
+
+	for(i = 0; i < p->len; i++) {
+		c = p->data[i];
+		if(c == 0x1b) {
+			fprintf(fp, "\\e");
+		} else if(c == '\\') {
+			fprintf(fp, "\\\\");
+		} else if(c < 0x20 || c >= 0x7f) {
+			fprintf(fp, "\\x%02x", c);
+		} else {
+			fputc(c, fp);
+		}
+	}
+}
+
+static void
+search(int rounds)
+{
+	PATTERN p;
+	int i;
+
+	for(i = 0; i < DICTIONARY_SIZE; i++) {
+		memset(&p, 0, sizeof(PATTERN));
+		insert(&p, 0, (uint8_t *)dictionary[i], entry_len(i));
+		evaluate(&p);
+		consider(&p);
+	}
+
+	for(i = 0; i < rounds; i++) {
+		p = population[random_number(population_size)];
+		mutate(&p);
+		evaluate(&p);
+		consider(&p);
+
+		if((i + 1) % 100 == 0) {
+			printf("round %d: worst %.1f cycles/byte\n", i + 1, population[0].cost);
+			fflush(stdout);
+		}
+	}
+}
+
+static void
+save(char *pDir)
+{
+	char name[1024];
+	FILE *fp;
+	FILE *fpIndex;
+	int i;
+	int len;
+
+	mkdir(pDir, 0777);
+
+	snprintf(name, sizeof(name), "%s/CYCLES", pDir);
+	if((fpIndex = fopen(name, "w")) == NULL) {
+		fprintf(stderr, "Cannot create %s\n", name);
+		exit(1);
+	}
+	fprintf(fpIndex, "# file cycles/byte pattern\n");
+
+	for(i = 0; i < population_size; i++) {
+		snprintf(name, sizeof(name), "%s/worst-%02d", pDir, i + 1);
+		if((fp = fopen(name, "w")) == NULL) {
+			fprintf(stderr, "Cannot create %s\n", name);
+			exit(1);
+		}
+		len = expand(&population[i]);
+		if(fwrite(pStream, 1, len, fp) != len) {
+			fprintf(stderr, "Cannot write %s\n", name);
+			exit(1);
+		}
+		fclose(fp);
+
+		fprintf(fpIndex, "worst-%02d %.1f ", i + 1, population[i].cost);
+		print_pattern(fpIndex, &population[i]);
+		fprintf(fpIndex, "\n");
+	}
+	fclose(fpIndex);
+}
+
+static void
+report()
+{
+	int i;
+
+	printf("\n%9s  %s\n", "cyc/byte", "pattern");
+	for(i = 0; i < population_size; i++) {
+		printf("%9.1f  ", population[i].cost);
+		print_pattern(stdout, &population[i]);
+		printf("\n");
+	}
+}
+
+// Measure each stream in the corpus again.  Returns the number that got
+// more expensive.
+static int
+check(char *pDir)
+{
+	char name[1024];
+	char line[1024];
+	char file[256];
+	double was;
+	double now;
+	uint8_t *pData;
+	int len;
+	int worse = 0;
+	FILE *fp;
+
+	snprintf(name, sizeof(name), "%s/CYCLES", pDir);
+	if((fp = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		exit(1);
+	}
+
+	printf("%-12s %10s %10s\n", "file", "was", "now");
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(line[0] == '#' || sscanf(line, "%255s %lf", file, &was) != 2) {
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "%s/%s", pDir, file);
+		pData = stream_load(name, &len);
+		now = len ? measure(pData, len) : 0;
+		free(pData);
+
+		printf("%-12s %10.1f %10.1f", file, was, now);
+		if(now > was * (1 + CHECK_SLACK)) {
+			printf("  worse");
+			worse++;
+		}
+		printf("\n");
+	}
+	fclose(fp);
+
+	return worse;
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-m map] [-n rounds] [-k keep] [-l length] [-s seed] [-o dir] [-c dir] fw.bin\n", pName);
+	fprintf(stderr, "\t-m = linker map (default: fw.map next to fw.bin)\n");
+	fprintf(stderr, "\t-n = mutations to try (default 2000)\n");
+	fprintf(stderr, "\t-k = how many of the worst patterns to keep (default 16)\n");
+	fprintf(stderr, "\t-l = stream length in bytes (default 512)\n");
+	fprintf(stderr, "\t-s = random number seed\n");
+	fprintf(stderr, "\t-o = write the worst streams here, as a corpus\n");
+	fprintf(stderr, "\t-c = measure a corpus again, rather than searching\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	char *pMap = NULL;
+	char *pOut = NULL;
+	char *pCheck = NULL;
+	char *pBin;
+	int rounds = 2000;
+
+	while((opt = getopt(argc, argv, "m:n:k:l:s:o:c:")) != -1) {
+		switch(opt) {
+			case 'm':
+				pMap = optarg;
+				break;
+			case 'n':
+				rounds = atoi(optarg);
+				break;
+			case 'k':
+				keep = atoi(optarg);
+				if(keep < 1 || keep > POPULATION_MAX) {
+					usage(argv[0]);
+				}
+				break;
+			case 'l':
+				stream_len = atoi(optarg);
+				if(stream_len < 1) {
+					usage(argv[0]);
+				}
+				break;
+			case 's':
+				seed = strtoul(optarg, NULL, 0);
+				if(seed == 0) {
+					seed = 1;
+				}
+				break;
+			case 'o':
+				pOut = optarg;
+				break;
+			case 'c':
+				pCheck = optarg;
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 1 != argc) {
+		usage(argv[0]);
+	}
+
+	pBin = argv[optind];
+	pRom = stream_load(pBin, &rom_len);
+
+	if(pMap == NULL) {
+		pMap = stream_sibling(pBin, ".map");
+	}
+	sym_load_map(pMap);
+	stream_init(pMap);
+
+	if((pStream = malloc(stream_len + PATTERN_MAX)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	// Boot once, and start every run from there.  The snapshot must not
+	// share the transmit buffer with the machine we run.
+	stream_boot(&booted, pRom, rom_len, FASTEST_DIP);
+	booted.pTx = NULL;
+	booted.tx_len = 0;
+	booted.tx_size = 0;
+
+	if(pCheck) {
+		exit(check(pCheck) ? 1 : 0);
+	}
+
+	search(rounds);
+	report();
+	if(pOut) {
+		save(pOut);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,274 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Send a byte stream to the firmware, and measure what it costs.
+//
+// Busy time is everything except main loop iterations in which
+// screen_handler() found nothing to do.  We find those by watching for
+// calls to screen_handler() and vtparse() - an iteration that never
+// reaches vtparse() was idle, apart from any interrupts taken during it.
+// The len argument of each vtparse() call tells us how many bytes got
+// through, so anything dropped by the FIFO or the receive ring shows up
+// as lost.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "stream.h"
+#include "sym.h"
+
+// Boot must reach the main loop within this many clock periods.
+#define BOOT_LIMIT	(100000000)
+
+// Give up on a run if the firmware spends this long on every byte.
+#define MAX_CYCLES_PER_BYTE	(200000)
+
+static uint32_t addr_screen_handler;
+static uint32_t addr_vtparse;
+
+static COSTS *pCosts;
+
+// Read a whole file.
+unsigned char *
+stream_load(char *pFile, int *pLen)
+{
+	int fd;
+	struct stat statbuf;
+	unsigned char *pData;
+
+	if((fd = open(pFile, O_RDONLY)) == -1) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	if(fstat(fd, &statbuf) == -1) {
+		fprintf(stderr, "Cannot get status for %s\n", pFile);
+		exit(1);
+	}
+
+	if((pData = malloc(statbuf.st_size + 1)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	if(read(fd, pData, statbuf.st_size) != statbuf.st_size) {
+		fprintf(stderr, "Cannot read %s\n", pFile);
+		exit(1);
+	}
+	close(fd);
+
+	*pLen = statbuf.st_size;
+
+	return pData;
+}
+
+// Replace the .bin on the end of a file name.
+char *
+stream_sibling(char *pBin, char *pSuffix)
+{
+	char *pName;
+	char *p;
+
+	if((pName = malloc(strlen(pBin) + strlen(pSuffix) + 1)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	strcpy(pName, pBin);
+	if((p = strrchr(pName, '.')) != NULL && strcmp(p, ".bin") == 0) {
+		*p = 0;
+	}
+	strcat(pName, pSuffix);
+
+	return pName;
+}
+
+// Find the functions we watch for.  The symbols must already be loaded.
+void
+stream_init(char *pMap)
+{
+	addr_screen_handler = sym_address("screen_handler");
+	addr_vtparse = sym_address("vtparse");
+	if(addr_screen_handler == SYM_NONE || addr_vtparse == SYM_NONE) {
+		fprintf(stderr, "%s does not have screen_handler and vtparse\n", pMap);
+		exit(1);
+	}
+}
+
+// Record what each byte and each interrupt costs during the next run, or
+// stop recording if pC is NULL.  The caller provides pByte and max.
+void
+stream_costs(COSTS *pC)
+{
+	if((pCosts = pC) != NULL) {
+		pCosts->bytes = 0;
+		pCosts->idle = UINT64_MAX;
+		pCosts->n = pCosts->sx = pCosts->sy = pCosts->sxx = pCosts->sxy = 0;
+	}
+}
+
+static void
+cost_iteration(uint64_t cycles, long bytes)
+{
+	long i;
+
+	if(bytes == 0) {
+		if(cycles < pCosts->idle) {
+			pCosts->idle = cycles;
+		}
+		return;
+	}
+
+	for(i = 0; i < bytes && pCosts->bytes < pCosts->max; i++) {
+		pCosts->pByte[pCosts->bytes++] = cycles / bytes;
+	}
+}
+
+static void
+cost_isr(uint64_t cycles, int bytes)
+{
+	double d;
+
+	pCosts->n++;
+	pCosts->sx += bytes;
+	pCosts->sy += cycles;
+	pCosts->sxx += (double)bytes * bytes;
+	pCosts->sxy += (double)bytes * cycles;
+
+	d = pCosts->n * pCosts->sxx - pCosts->sx * pCosts->sx;
+	if(d != 0) {
+		pCosts->isr_byte = (pCosts->n * pCosts->sxy - pCosts->sx * pCosts->sy) / d;
+		pCosts->isr_fixed = (pCosts->sy - pCosts->isr_byte * pCosts->sx) / pCosts->n;
+	} else {
+		pCosts->isr_byte = 0;
+		pCosts->isr_fixed = pCosts->sy / pCosts->n;
+	}
+}
+
+// True if the next step will execute the instruction at pc, rather than
+// taking an interrupt.
+static int
+about_to_execute(m68k_t *cpu, uint32_t pc)
+{
+	return cpu->pc == pc && !cpu->stopped && cpu->ipl <= ((cpu->sr >> 8) & 7);
+}
+
+// Reset, and run until the main loop first calls screen_handler().
+void
+stream_boot(MACHINE *m, uint8_t *pRom, int len, uint8_t dip)
+{
+	machine_init(m, pRom, len, dip);
+
+	while(!about_to_execute(&m->cpu, addr_screen_handler)) {
+		machine_step(m);
+		if(m->cpu.halted || m->cpu.cycles > BOOT_LIMIT) {
+			fprintf(stderr, "Firmware did not reach screen_handler (pc = 0x%06x)\n", m->cpu.pc);
+			exit(1);
+		}
+	}
+}
+
+// Send a stream and run until the firmware has dealt with all of it.
+void
+stream_run(MACHINE *m, const uint8_t *pData, int len, uint64_t interval, int flow, STEP_HOOK hook, RESULT *r)
+{
+	m68k_t *cpu = &m->cpu;
+	uint64_t start = cpu->cycles;
+	uint64_t limit;
+	uint64_t iter_start = start;
+	uint64_t iter_isr = 0;
+	uint64_t isr_start = 0;
+	uint64_t idle = 0;
+	int isr_depth = 0;
+	int iter_busy = 0;
+	long iter_bytes = 0;
+	int isr_fifo = 0;
+	int isr_pos = 0;
+	int n;
+
+	memset(r, 0, sizeof(RESULT));
+	m->uart.overruns = 0;
+	machine_send(m, pData, len, interval, flow);
+	limit = start + (uint64_t)len * (interval + MAX_CYCLES_PER_BYTE) + CPU_HZ;
+
+	while(1) {
+		if(about_to_execute(cpu, addr_vtparse)) {
+			// vtparse(parser, data, len) - len is the third
+			// argument on the stack.
+			n = machine_read32(m, cpu->a[7] + 12);
+			r->consumed += n;
+			iter_bytes += n;
+			iter_busy = 1;
+		} else if(about_to_execute(cpu, addr_screen_handler)) {
+			// A new main loop iteration.  Was the last one idle?
+			if(pCosts && iter_start != start) {
+				cost_iteration((cpu->cycles - iter_start) - (r->isr - iter_isr), iter_bytes);
+			}
+			if(!iter_busy) {
+				idle += (cpu->cycles - iter_start) - (r->isr - iter_isr);
+				if(machine_sender_done(m)) {
+					break;
+				}
+			}
+			iter_start = cpu->cycles;
+			iter_isr = r->isr;
+			iter_busy = 0;
+			iter_bytes = 0;
+		}
+
+		n = machine_step(m);
+		if(hook) {
+			hook(m, n);
+		}
+
+		if(cpu->last_vector >= 0x19 && cpu->last_vector <= 0x1f) {
+			if(isr_depth++ == 0) {
+				isr_start = cpu->cycles - n;
+				isr_fifo = m->uart.rx_count;
+				isr_pos = m->sender.pos;
+			}
+		} else if(cpu->last_vector == 0 && cpu->ir == 0x4e73 && isr_depth) {
+			// RTE
+			if(--isr_depth == 0) {
+				r->isr += cpu->cycles - isr_start;
+				if(pCosts) {
+					// Bytes read = what was there, plus
+					// what came in, less what is left.
+					cost_isr(cpu->cycles - isr_start,
+							isr_fifo + (m->sender.pos - isr_pos) - m->uart.rx_count);
+				}
+			}
+		}
+
+		if(cpu->halted || cpu->cycles > limit) {
+			r->timed_out = 1;
+			break;
+		}
+	}
+
+	r->elapsed = cpu->cycles - start;
+	r->busy = r->elapsed - idle;
+	r->overruns = m->uart.overruns;
+	r->lost = m->sender.nonnull - r->consumed;
+}
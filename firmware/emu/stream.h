@@ -0,0 +1,64 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdint.h>
+
+#include "machine.h"
+
+typedef struct {
+	uint64_t	elapsed;
+	uint64_t	busy;
+	uint64_t	isr;
+	long		consumed;
+	long		overruns;
+	long		lost;
+	int		timed_out;
+} RESULT;
+
+// What each part of the firmware costs, from a run with stream_costs() set.
+// An interrupt costs isr_fixed + isr_byte for each byte it reads from the
+// FIFO, fitted by least squares.
+typedef struct {
+	uint32_t	*pByte;		// Main loop cycles for each byte vtparse() got
+	long		bytes;
+	long		max;
+	uint64_t	idle;		// Cheapest idle main loop iteration
+	double		isr_fixed;
+	double		isr_byte;
+
+	// For the fit.
+	double		n;
+	double		sx;
+	double		sy;
+	double		sxx;
+	double		sxy;
+} COSTS;
+
+// Called after every step of a run, for profiling and the like.
+typedef void (*STEP_HOOK)(MACHINE *m, int cycles);
+
+extern unsigned char *stream_load(char *pFile, int *pLen);
+extern char *stream_sibling(char *pBin, char *pSuffix);
+extern void stream_init(char *pMap);
+extern void stream_costs(COSTS *pCosts);
+extern void stream_boot(MACHINE *m, uint8_t *pRom, int len, uint8_t dip);
+extern void stream_run(MACHINE *m, const uint8_t *pData, int len, uint64_t interval, int flow, STEP_HOOK hook, RESULT *r);
+
+#endif // _STREAM_H_
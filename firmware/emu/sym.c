@@ -0,0 +1,252 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Firmware symbols, taken from the linker map (build/fw.map).  The map
+// only lists global symbols, which is enough to find the entry points we
+// care about.  The disassembly (build/fw.dump) also labels static
+// functions, so it can be added on top when we need to say where every
+// sample of the program counter landed.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sym.h"
+
+#define MAX_SYMS	(2048)
+#define SYM_LEN		(64)
+
+typedef struct {
+	uint32_t	addr;
+	char		name[SYM_LEN];
+} SYM;
+
+static SYM syms[MAX_SYMS];
+static int num_syms;
+
+static int
+compare_syms(const void *a, const void *b)
+{
+	const SYM *pA = a;
+	const SYM *pB = b;
+
+	if(pA->addr < pB->addr) {
+		return -1;
+	}
+	if(pA->addr > pB->addr) {
+		return 1;
+	}
+
+	return strcmp(pA->name, pB->name);
+}
+
+static int
+is_identifier(char *p)
+{
+	if(!isalpha((unsigned char)*p) && *p != '_') {
+		return 0;
+	}
+	for(; *p; p++) {
+		if(!isalnum((unsigned char)*p) && *p != '_') {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Names are at most SYM_LEN - 1 characters, by way of sscanf().
+static void
+sym_add(uint32_t addr, char *pName)
+{
+	if(num_syms == MAX_SYMS) {
+		return;
+	}
+
+	syms[num_syms].addr = addr;
+	strcpy(syms[num_syms].name, pName);
+	num_syms++;
+}
+
+// Sort, and drop anything that both files told us about.
+static void
+sym_sort(void)
+{
+	int i;
+	int j;
+
+	qsort(syms, num_syms, sizeof(SYM), compare_syms);
+
+	for(i = j = 0; i < num_syms; i++) {
+		if(j > 0 && syms[j - 1].addr == syms[i].addr &&
+				strcmp(syms[j - 1].name, syms[i].name) == 0) {
+			continue;
+		}
+		syms[j++] = syms[i];
+	}
+	num_syms = j;
+}
+
+// Symbol lines in the map have exactly two fields, the address and the
+// name, for example:
+//
+//                 0x0000000000000d2c                screen_handler
+//
+// Assignments like "_sdata = ." have more fields, and section lines start
+// with the section name, so both are skipped.
+void
+sym_load_map(char *pFile)
+{
+	FILE *fp;
+	char line[256];
+	char addr[64];
+	char name[SYM_LEN];
+	char extra[8];
+
+	if((fp = fopen(pFile, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	num_syms = 0;
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(!isspace((unsigned char)line[0])) {
+			continue;
+		}
+		if(sscanf(line, "%63s %63s %7s", addr, name, extra) != 2) {
+			continue;
+		}
+		if(strncmp(addr, "0x", 2) != 0 || !is_identifier(name)) {
+			continue;
+		}
+
+		sym_add(strtoul(addr, NULL, 16), name);
+	}
+	fclose(fp);
+
+	sym_sort();
+}
+
+// Labels in the disassembly look like:
+//
+// 00000d2c <screen_handler>:
+//
+// The local labels in the libgcc assembler sources (L1, L2 and so on) end
+// up in the symbol table too, but they are in the middle of a function, so
+// we leave them out.
+void
+sym_load_dump(char *pFile)
+{
+	FILE *fp;
+	char line[256];
+	char name[SYM_LEN];
+	char *p;
+	unsigned long addr;
+
+	if((fp = fopen(pFile, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(sscanf(line, "%lx <%63[^>]>:", &addr, name) != 2) {
+			continue;
+		}
+		if((p = strchr(line, '>')) == NULL || p[1] != ':') {
+			continue;
+		}
+		if(!is_identifier(name) || (name[0] == 'L' && isdigit((unsigned char)name[1]))) {
+			continue;
+		}
+
+		sym_add(addr, name);
+	}
+	fclose(fp);
+
+	sym_sort();
+}
+
+// Return the address of a symbol, or SYM_NONE.
+uint32_t
+sym_address(char *pName)
+{
+	int i;
+
+	for(i = 0; i < num_syms; i++) {
+		if(strcmp(syms[i].name, pName) == 0) {
+			return syms[i].addr;
+		}
+	}
+
+	return SYM_NONE;
+}
+
+// Return the index of the symbol at or below an address, or -1.
+int
+sym_index(uint32_t addr)
+{
+	int lo = 0;
+	int hi = num_syms - 1;
+	int mid;
+
+	if(num_syms == 0 || addr < syms[0].addr) {
+		return -1;
+	}
+
+	while(lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if(syms[mid].addr <= addr) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return lo;
+}
+
+int
+sym_count(void)
+{
+	return num_syms;
+}
+
+// Return the name and address of a symbol by index.
+char *
+sym_get(int i, uint32_t *pAddr)
+{
+	if(i < 0 || i >= num_syms) {
+		*pAddr = 0;
+		return "?";
+	}
+
+	*pAddr = syms[i].addr;
+	return syms[i].name;
+}
+
+// Return the name of the symbol at or below an address, and the offset
+// from it.
+char *
+sym_name(uint32_t addr, uint32_t *pOffset)
+{
+	uint32_t start;
+	char *pName = sym_get(sym_index(addr), &start);
+
+	*pOffset = addr - start;
+	return pName;
+}
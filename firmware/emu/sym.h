@@ -0,0 +1,33 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef _SYM_H_
+#define _SYM_H_
+
+#include <stdint.h>
+
+#define SYM_NONE	(0xffffffff)
+
+extern void sym_load_map(char *pFile);
+extern void sym_load_dump(char *pFile);
+extern uint32_t sym_address(char *pName);
+extern int sym_index(uint32_t addr);
+extern int sym_count(void);
+extern char *sym_get(int i, uint32_t *pAddr);
+extern char *sym_name(uint32_t addr, uint32_t *pOffset);
+
+#endif // _SYM_H_
@@ -0,0 +1,257 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Time the firmware's vtparse() on its own.
+//
+// Rather than feeding bytes through the UART, we call vtparse_init() and
+// then vtparse() directly, as a debugger would: the arguments and a return
+// address go on the booted machine's stack, and we run until it returns.
+// The parser, an RTS for its callback, and the bytes to parse live in the
+// RAM above _edata, which nothing else uses.  So the cycles counted are
+// the parser's alone, plus a JSR and RTS for each action it hands out,
+// with nothing from screen.c.
+//
+// The firmware calls vtparse() with whatever run of uart_rb is waiting,
+// up to 128 bytes.  By default we do the same with full runs; -c
+// passes fewer per call, to see what a slower trickle costs.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "machine.h"
+#include "stream.h"
+#include "sym.h"
+
+// Keep below the stack, which fw.ld gives the top 2K of RAM.
+#define RAM_LIMIT	(RAM_BASE + 0x3800)
+
+// Room for a vtparse_t, which is under 100 bytes on the 68000.
+#define PARSER_SIZE	(256)
+
+#define RTS		(0x4e75)
+
+// A call that takes longer than this has gone wrong.
+#define CALL_LIMIT	(CPU_HZ * 10LL)
+
+static MACHINE machine;
+
+static uint32_t addr_vtparse_init;
+static uint32_t addr_vtparse;
+static uint32_t addr_parser;
+static uint32_t addr_callback;
+static uint32_t addr_return;
+static uint32_t addr_buffer;
+static int buffer_size;
+
+static void
+put8(MACHINE *m, uint32_t addr, uint8_t val)
+{
+	if(addr < RAM_BASE || addr >= RAM_BASE + RAM_SIZE) {
+		fprintf(stderr, "Scratch address 0x%06x is not in RAM\n", addr);
+		exit(1);
+	}
+	m->ram[addr - RAM_BASE] = val;
+}
+
+static void
+put16(MACHINE *m, uint32_t addr, uint16_t val)
+{
+	put8(m, addr, val >> 8);
+	put8(m, addr + 1, val);
+}
+
+static void
+put32(MACHINE *m, uint32_t addr, uint32_t val)
+{
+	put16(m, addr, val >> 16);
+	put16(m, addr + 2, val);
+}
+
+// Call a C function in the firmware, and return the clock periods it
+// took, from the JSR that would have called it to its RTS.
+static uint64_t
+call(MACHINE *m, uint32_t fn, int nargs, uint32_t *pArgs)
+{
+	m68k_t *cpu = &m->cpu;
+	uint32_t sp = cpu->a[7];
+	uint64_t start;
+	int i;
+
+	for(i = nargs - 1; i >= 0; i--) {
+		sp -= 4;
+		put32(m, sp, pArgs[i]);
+	}
+	sp -= 4;
+	put32(m, sp, addr_return);
+
+	cpu->a[7] = sp;
+	cpu->pc = fn;
+	cpu->sr |= 0x0700;
+	cpu->stopped = 0;
+
+	// The BSR that would have called it.
+	start = cpu->cycles;
+	cpu->cycles += 18;
+
+	while(cpu->pc != addr_return) {
+		machine_step(m);
+		if(cpu->halted || cpu->cycles - start > CALL_LIMIT) {
+			fprintf(stderr, "Call to 0x%06x did not return (pc = 0x%06x)\n", fn, cpu->pc);
+			exit(1);
+		}
+	}
+
+	// The caller pops the arguments.
+	cpu->a[7] = sp + 4 + 4 * nargs;
+
+	return cpu->cycles - start;
+}
+
+// Returns the clock periods spent in vtparse().
+static uint64_t
+bench(char *pFile, int chunk, long *pTotal)
+{
+	uint8_t *pData;
+	uint32_t args[3];
+	uint64_t cycles = 0;
+	int len;
+	int pos;
+	int n;
+	int i;
+
+	pData = stream_load(pFile, &len);
+	if(len == 0) {
+		free(pData);
+		return 0;
+	}
+
+	args[0] = addr_parser;
+	args[1] = addr_callback;
+	call(&machine, addr_vtparse_init, 2, args);
+
+	for(pos = 0; pos < len; pos += n) {
+		n = len - pos;
+		if(n > chunk) {
+			n = chunk;
+		}
+		for(i = 0; i < n; i++) {
+			put8(&machine, addr_buffer + i, pData[pos + i]);
+		}
+
+		args[0] = addr_parser;
+		args[1] = addr_buffer;
+		args[2] = n;
+		cycles += call(&machine, addr_vtparse, 3, args);
+	}
+
+	printf("  %-24s %10d bytes %10.1f cycles/byte\n", pFile, len, (double)cycles / len);
+
+	free(pData);
+	*pTotal += len;
+	return cycles;
+}
+
+static uint32_t
+need(char *pName)
+{
+	uint32_t addr = sym_address(pName);
+
+	if(addr == SYM_NONE) {
+		fprintf(stderr, "%s is not in the linker map\n", pName);
+		exit(1);
+	}
+
+	return addr;
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-m map] [-c bytes] fw.bin file ...\n", pName);
+	fprintf(stderr, "\t-m = linker map (default: fw.map next to fw.bin)\n");
+	fprintf(stderr, "\t-c = bytes per call to vtparse() (default 128, the most the firmware passes)\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	char *pMap = NULL;
+	char *pBin;
+	uint8_t *pRom;
+	int rom_len;
+	int chunk = 128;			// uart_span_max in uart.c
+	long total = 0;
+	uint64_t cycles = 0;
+
+	while((opt = getopt(argc, argv, "m:c:")) != -1) {
+		switch(opt) {
+			case 'm':
+				pMap = optarg;
+				break;
+			case 'c':
+				chunk = atoi(optarg);
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 2 > argc || chunk < 1) {
+		usage(argv[0]);
+	}
+
+	pBin = argv[optind++];
+	pRom = stream_load(pBin, &rom_len);
+
+	if(pMap == NULL) {
+		pMap = stream_sibling(pBin, ".map");
+	}
+	sym_load_map(pMap);
+	stream_init(pMap);
+
+	addr_vtparse_init = need("vtparse_init");
+	addr_vtparse = need("vtparse");
+
+	// The scratch area, after the initialized data.
+	addr_parser = (need("_edata") + 3) & ~3;
+	addr_callback = addr_parser + PARSER_SIZE;
+	addr_return = addr_callback + 2;
+	addr_buffer = addr_return + 2;
+	buffer_size = RAM_LIMIT - addr_buffer;
+	if(chunk > buffer_size) {
+		chunk = buffer_size;
+	}
+
+	stream_boot(&machine, pRom, rom_len, 0);
+	put16(&machine, addr_callback, RTS);
+	put16(&machine, addr_return, RTS);
+
+	printf("vtparse() with %d byte%s per call\n", chunk, chunk == 1 ? "" : "s");
+	for(; optind < argc; optind++) {
+		cycles += bench(argv[optind], chunk, &total);
+	}
+	printf("  %-24s %10ld bytes %10.1f cycles/byte\n", "all", total, total ? (double)cycles / total : 0);
+
+	exit(0);
+}
@@ -0,0 +1,1500 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Static worst case timing of the firmware, from the disassembly
+// (build/fw.dump).
+//
+// Each function reachable from an entry point is decoded by following its
+// branches, so jump tables and the data after them are never mistaken for
+// code.  Every instruction is then timed by running it once on the
+// emulator's 68000 core for each combination of condition codes, which
+// gives the worst case both when a branch is taken and when it falls
+// through.  MULU/MULS, DIVU/DIVS and shifts by a register count depend on
+// the data, so those are charged the worst case from the user's manual.
+//
+// Loops are found from the back edges of a depth first search, and each
+// one is collapsed to (bound * one trip around it), after which the
+// longest path through the function is easy.  The bound is the most times
+// the loop branches back to its header.  The compiler can't tell us that,
+// so it comes from a bounds file, and any loop without one is flagged and
+// counted as a single trip.  Indirect calls are handled the same way.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "m68k.h"
+#include "machine.h"
+#include "sym.h"
+
+#define MAX_FUNCS	(1024)
+#define MAX_LOOPS	(64)
+#define MAX_BOUNDS	(256)
+#define MAX_TARGETS	(32)
+
+// The scratch machine that instructions are timed on.  Address registers
+// point well away from the code, so that nothing we run can overwrite it.
+#define SCRATCH_SIZE	(0x1000000)
+#define SCRATCH_A	(0x100000)
+#define SCRATCH_SP	(0x200000)
+
+// Worst cases from the user's manual, for instructions whose timing
+// depends on the data.
+#define MUL_WORST	(70)
+#define DIVU_WORST	(140)
+#define DIVS_WORST	(158)
+#define SHIFT_WORST	(63)
+
+// What an instruction does to the flow of control.
+#define K_NORMAL	(0)
+#define K_BRANCH	(1)	// BRA
+#define K_COND		(2)	// Bcc
+#define K_DBCC		(3)
+#define K_CALL		(4)	// JSR or BSR to a known address
+#define K_ICALL		(5)	// JSR through a register
+#define K_TABLE		(6)	// JMP through a jump table
+#define K_IJUMP		(7)	// Any other computed JMP
+#define K_RETURN	(8)	// RTS, RTE or RTR
+
+// Successors that leave the function.
+#define EXIT		(-1)
+
+typedef struct {
+	uint32_t	addr;
+	uint16_t	op;
+	int		len;
+	int		kind;
+	uint32_t	target;
+	int		cost;		// Worst case, falling through
+	int		taken;		// Worst case, branching to target
+	int		data;		// Timing depends on the data
+	int		*pSucc;		// Instruction indices, or EXIT
+	uint32_t	*pSuccAddr;
+	int		num_succ;
+	int		callee;		// Function, for K_CALL
+	int		icall;		// Which indirect call, from 1
+	int		loop;		// Innermost loop, or -1
+	int		rpo;		// Reverse postorder
+} INSN;
+
+typedef struct {
+	int		header;
+	int		parent;
+	char		*pBody;
+	long		bound;		// -1 if unknown
+	long		trip;		// Worst case for one trip around
+} LOOP;
+
+typedef struct {
+	char		*pName;
+	uint32_t	start;
+	uint32_t	end;
+	INSN		*pInsn;
+	int		n;
+	int		*pOrder;	// Instructions in reverse postorder
+	LOOP		loops[MAX_LOOPS];
+	int		num_loops;
+	int		state;		// 0 = new, 1 = working on it, 2 = done
+	long		worst;
+	int		guess;		// Some part of worst is not a bound
+	int		printed;
+} FUNC;
+
+// Lines from the bounds file.
+typedef struct {
+	int		is_call;
+	char		function[64];
+	int		index;		// Loop or indirect call, from 1, or 0 for all
+	long		bound;
+	char		targets[MAX_TARGETS][64];
+	int		num_targets;
+	int		used;
+} BOUND;
+
+static uint8_t image[ROM_SIZE];
+static uint8_t loaded[ROM_SIZE];
+static uint8_t scratch[SCRATCH_SIZE];
+
+static FUNC funcs[MAX_FUNCS];
+static int num_funcs;
+
+static BOUND bounds[MAX_BOUNDS];
+static int num_bounds;
+
+static int problems;
+
+static uint16_t
+fetch(uint32_t addr)
+{
+	if(addr + 1 >= ROM_SIZE || !loaded[addr] || !loaded[addr + 1]) {
+		return 0x4afc;	// ILLEGAL
+	}
+
+	return (image[addr] << 8) | image[addr + 1];
+}
+
+static uint8_t
+scratch_read8(void *ctx, uint32_t addr)
+{
+	return scratch[addr & (SCRATCH_SIZE - 1)];
+}
+
+static uint16_t
+scratch_read16(void *ctx, uint32_t addr)
+{
+	return (scratch_read8(ctx, addr) << 8) | scratch_read8(ctx, addr + 1);
+}
+
+static void
+scratch_write8(void *ctx, uint32_t addr, uint8_t val)
+{
+	// Keep the code intact.
+	if((addr & (SCRATCH_SIZE - 1)) >= ROM_SIZE) {
+		scratch[addr & (SCRATCH_SIZE - 1)] = val;
+	}
+}
+
+static void
+scratch_write16(void *ctx, uint32_t addr, uint16_t val)
+{
+	scratch_write8(ctx, addr, val >> 8);
+	scratch_write8(ctx, addr + 1, val);
+}
+
+static int
+scratch_iack(void *ctx, int level)
+{
+	return 0x18 + level;
+}
+
+static const m68k_bus_t scratch_bus = {
+	scratch_read8,
+	scratch_read16,
+	scratch_write8,
+	scratch_write16,
+	scratch_iack,
+};
+
+// Read the code out of the disassembly.  Instruction lines look like:
+//
+//      d2c:	4e56 0000      	linkw %fp,#0
+//
+// and anything too long for one line carries on with the same layout but
+// no mnemonic.  Jump tables and other data in the text section show up as
+// instructions too, so we get every byte.
+static void
+load_dump(char *pFile)
+{
+	FILE *fp;
+	char line[256];
+	char *p;
+	char *pEnd;
+	unsigned long addr;
+	unsigned long word;
+
+	if((fp = fopen(pFile, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		addr = strtoul(line, &p, 16);
+		if(p == line || *p != ':' || !isspace((unsigned char)line[0])) {
+			continue;
+		}
+
+		// The words are separated by spaces, and end at a tab.
+		for(p++; *p == '\t'; p++) {
+		}
+		while(isxdigit((unsigned char)*p)) {
+			word = strtoul(p, &pEnd, 16);
+			if(pEnd - p != 4) {
+				break;
+			}
+			if(addr + 1 < ROM_SIZE) {
+				image[addr] = word >> 8;
+				image[addr + 1] = word;
+				loaded[addr] = loaded[addr + 1] = 1;
+			}
+			addr += 2;
+			p = pEnd;
+			if(*p == ' ') {
+				p++;
+			}
+		}
+	}
+	fclose(fp);
+
+	memcpy(scratch, image, ROM_SIZE);
+}
+
+// Lines are:
+//
+//	loop <function> <n> <bound>
+//	call <function> <n|*> <target> ...
+//
+// where n counts the loops or indirect calls in the function, in address
+// order, from 1.  See README.
+static void
+load_bounds(char *pFile)
+{
+	FILE *fp;
+	char line[1024];
+	char *pTok[MAX_TARGETS + 3];
+	char *p;
+	int n;
+	int i;
+	int lineno = 0;
+	BOUND *b;
+
+	if((fp = fopen(pFile, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		if((p = strchr(line, '#')) != NULL) {
+			*p = 0;
+		}
+
+		n = 0;
+		for(p = strtok(line, " \t\n"); p && n < MAX_TARGETS + 3; p = strtok(NULL, " \t\n")) {
+			pTok[n++] = p;
+		}
+		if(n == 0) {
+			continue;
+		}
+
+		if(num_bounds == MAX_BOUNDS) {
+			fprintf(stderr, "%s: too many bounds\n", pFile);
+			exit(1);
+		}
+		b = &bounds[num_bounds];
+		memset(b, 0, sizeof(BOUND));
+
+		if(n == 4 && strcmp(pTok[0], "loop") == 0) {
+			b->bound = atol(pTok[3]);
+		} else if(n >= 4 && strcmp(pTok[0], "call") == 0) {
+			b->is_call = 1;
+			for(i = 3; i < n; i++) {
+				snprintf(b->targets[b->num_targets++], 64, "%s", pTok[i]);
+			}
+		} else {
+			fprintf(stderr, "%s:%d: cannot parse\n", pFile, lineno);
+			exit(1);
+		}
+
+		snprintf(b->function, sizeof(b->function), "%s", pTok[1]);
+		b->index = (strcmp(pTok[2], "*") == 0) ? 0 : atoi(pTok[2]);
+		num_bounds++;
+	}
+	fclose(fp);
+}
+
+static BOUND *
+find_bound(char *pFunction, int is_call, int index)
+{
+	int i;
+
+	for(i = 0; i < num_bounds; i++) {
+		if(bounds[i].is_call == is_call &&
+				(bounds[i].index == index || bounds[i].index == 0) &&
+				strcmp(bounds[i].function, pFunction) == 0) {
+			bounds[i].used = 1;
+			return &bounds[i];
+		}
+	}
+
+	return NULL;
+}
+
+// Extension words for an effective address.
+static int
+ea_words(int mode, int reg, int size)
+{
+	switch(mode) {
+		case 5:		// d16(An)
+		case 6:		// d8(An,Xn)
+			return 1;
+
+		case 7:
+			switch(reg) {
+				case 1:		// abs.L
+					return 2;
+				case 4:		// #imm
+					return (size == 4) ? 2 : 1;
+				default:	// abs.W, d16(PC), d8(PC,Xn)
+					return 1;
+			}
+	}
+
+	return 0;
+}
+
+static int
+op_size(uint16_t op)
+{
+	switch((op >> 6) & 3) {
+		case 0:		return 1;
+		case 1:		return 2;
+		default:	return 4;
+	}
+}
+
+// Length of an instruction in bytes.
+static int
+insn_length(uint16_t op)
+{
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int size;
+
+	switch(op >> 12) {
+		case 0x0:
+			if(op & 0x0100) {
+				// MOVEP, or a bit operation with the bit number
+				// in a register.
+				return (mode == 1) ? 4 : 2 + 2 * ea_words(mode, reg, 1);
+			}
+			if((op & 0x0f00) == 0x0800) {
+				// Bit operation with an immediate bit number.
+				return 4 + 2 * ea_words(mode, reg, 1);
+			}
+			if((op & 0x00bf) == 0x003c) {
+				// To CCR or SR.
+				return 4;
+			}
+			size = op_size(op);
+			return 2 + ((size == 4) ? 4 : 2) + 2 * ea_words(mode, reg, size);
+
+		case 0x1:
+		case 0x2:
+		case 0x3:
+			size = ((op >> 12) == 1) ? 1 : ((op >> 12) == 3) ? 2 : 4;
+			return 2 + 2 * ea_words(mode, reg, size) + 2 * ea_words((op >> 6) & 7, (op >> 9) & 7, size);
+
+		case 0x4:
+			if((op & 0x01c0) == 0x01c0) {
+				return 2 + 2 * ea_words(mode, reg, 4);		// LEA
+			}
+			if((op & 0x01c0) == 0x0180) {
+				return 2 + 2 * ea_words(mode, reg, 2);		// CHK
+			}
+			switch((op >> 8) & 0xf) {
+				case 0x0:
+				case 0x2:
+				case 0x4:
+				case 0x6:
+					// NEGX, CLR, NEG, NOT and the moves to
+					// and from SR and CCR, which are words.
+					size = (((op >> 6) & 3) == 3) ? 2 : op_size(op);
+					return 2 + 2 * ea_words(mode, reg, size);
+
+				case 0x8:
+					if((op & 0x00c0) == 0x0000) {
+						return 2 + 2 * ea_words(mode, reg, 1);	// NBCD
+					}
+					if(mode == 0) {
+						return 2;				// SWAP, EXT
+					}
+					if((op & 0x00c0) == 0x0040) {
+						return 2 + 2 * ea_words(mode, reg, 4);	// PEA
+					}
+					return 4 + 2 * ea_words(mode, reg, 4);		// MOVEM
+
+				case 0xa:
+					size = (((op >> 6) & 3) == 3) ? 1 : op_size(op);
+					return 2 + 2 * ea_words(mode, reg, size);	// TST, TAS
+
+				case 0xc:
+					return 4 + 2 * ea_words(mode, reg, 4);		// MOVEM
+
+				case 0xe:
+					if(op & 0x0080) {
+						return 2 + 2 * ea_words(mode, reg, 4);	// JSR, JMP
+					}
+					if((op & 0xfff8) == 0x4e50 || op == 0x4e72) {
+						return 4;				// LINK, STOP
+					}
+					return 2;
+			}
+			return 2;
+
+		case 0x5:
+			if((op & 0x00c0) == 0x00c0) {
+				// DBcc or Scc.
+				return (mode == 1) ? 4 : 2 + 2 * ea_words(mode, reg, 1);
+			}
+			return 2 + 2 * ea_words(mode, reg, op_size(op));	// ADDQ, SUBQ
+
+		case 0x6:
+			return ((op & 0x00ff) == 0) ? 4 : 2;
+
+		case 0x8:
+		case 0x9:
+		case 0xb:
+		case 0xc:
+		case 0xd:
+			switch((op >> 6) & 7) {
+				case 0:
+				case 4:
+					size = 1;
+					break;
+				case 1:
+				case 5:
+					size = 2;
+					break;
+				case 3:
+					// DIVU, MULU, ADDA.W, SUBA.W, CMPA.W.
+					size = 2;
+					break;
+				case 7:
+					// DIVS and MULS are words, ADDA.L,
+					// SUBA.L and CMPA.L are not.
+					size = ((op >> 12) == 0x8 || (op >> 12) == 0xc) ? 2 : 4;
+					break;
+				default:
+					size = 4;
+					break;
+			}
+			return 2 + 2 * ea_words(mode, reg, size);
+
+		case 0xe:
+			if((op & 0x00c0) == 0x00c0) {
+				return 2 + 2 * ea_words(mode, reg, 2);		// Memory shift
+			}
+			return 2;
+
+		default:
+			// MOVEQ, and the A and F lines.
+			return 2;
+	}
+}
+
+// Where a JMP or JSR goes, if we can tell without running it.
+static int
+ea_target(uint32_t addr, uint16_t op, uint32_t *pTarget)
+{
+	if(((op >> 3) & 7) != 7) {
+		return 0;
+	}
+
+	switch(op & 7) {
+		case 0:
+			*pTarget = (int16_t)fetch(addr + 2);
+			return 1;
+		case 1:
+			*pTarget = (fetch(addr + 2) << 16) | fetch(addr + 4);
+			return 1;
+		case 2:
+			*pTarget = addr + 2 + (int16_t)fetch(addr + 2);
+			return 1;
+	}
+
+	return 0;
+}
+
+static void
+classify(INSN *p)
+{
+	uint16_t op = p->op;
+
+	p->kind = K_NORMAL;
+
+	if(op == 0x4e73 || op == 0x4e75 || op == 0x4e77) {
+		p->kind = K_RETURN;
+	} else if((op & 0xffc0) == 0x4ec0) {
+		if(ea_target(p->addr, op, &p->target)) {
+			p->kind = K_BRANCH;
+		} else if((op & 0x003f) == 0x003b) {
+			// JMP d8(PC,Xn), which is how gcc does a switch.
+			p->kind = K_TABLE;
+		} else {
+			p->kind = K_IJUMP;
+		}
+	} else if((op & 0xffc0) == 0x4e80) {
+		p->kind = ea_target(p->addr, op, &p->target) ? K_CALL : K_ICALL;
+	} else if((op & 0xf000) == 0x6000) {
+		p->target = p->addr + 2 + (((op & 0xff) == 0) ? (int16_t)fetch(p->addr + 2) : (int8_t)op);
+		switch((op >> 8) & 0xf) {
+			case 0:
+				p->kind = K_BRANCH;
+				break;
+			case 1:
+				p->kind = K_CALL;
+				break;
+			default:
+				p->kind = K_COND;
+				break;
+		}
+	} else if((op & 0xf0f8) == 0x50c8 && (op & 0x0f00) != 0x0000) {
+		// DBcc, except DBT, which never branches.
+		p->kind = K_DBCC;
+		p->target = p->addr + 2 + (int16_t)fetch(p->addr + 2);
+	}
+}
+
+// Time an instruction by running it for each combination of condition
+// codes, with the loop counter for DBcc both expiring and not.
+static void
+measure(INSN *p)
+{
+	static m68k_t cpu;
+	uint16_t op = p->op;
+	int mode = (op >> 3) & 7;
+	int reg = op & 7;
+	int ccr;
+	int set;
+	int cycles;
+	int i;
+
+	p->cost = 0;
+	p->taken = 0;
+	for(set = 0; set < 2; set++) {
+		for(ccr = 0; ccr < 32; ccr++) {
+			m68k_init(&cpu, &scratch_bus, NULL);
+			for(i = 0; i < 8; i++) {
+				cpu.d[i] = set ? 0 : 0x10;
+				cpu.a[i] = SCRATCH_A + i * 0x1000;
+			}
+			cpu.a[7] = SCRATCH_SP;
+			cpu.sr = M68K_SR_S | M68K_SR_IPL | ccr;
+			cpu.pc = p->addr;
+
+			cycles = m68k_step(&cpu);
+			if(cpu.last_vector == M68K_VEC_ADDRESS_ERROR) {
+				continue;
+			}
+			if(cpu.pc == p->addr + p->len) {
+				if(cycles > p->cost) {
+					p->cost = cycles;
+				}
+			} else if(cycles > p->taken) {
+				p->taken = cycles;
+			}
+		}
+	}
+
+	if(p->kind != K_COND && p->kind != K_DBCC) {
+		// Only conditional branches have two costs.  Anything else
+		// that changes the flow (or traps) costs the same either way.
+		if(p->taken > p->cost) {
+			p->cost = p->taken;
+		}
+		p->taken = p->cost;
+	}
+
+	if((op & 0xf0c0) == 0xc0c0) {
+		p->cost = p->taken = MUL_WORST + m68k_ea_cycles(mode, reg, 2);
+		p->data = 1;
+	} else if((op & 0xf1c0) == 0x80c0) {
+		p->cost = p->taken = DIVU_WORST + m68k_ea_cycles(mode, reg, 2);
+		p->data = 1;
+	} else if((op & 0xf1c0) == 0x81c0) {
+		p->cost = p->taken = DIVS_WORST + m68k_ea_cycles(mode, reg, 2);
+		p->data = 1;
+	} else if((op & 0xf0c0) != 0xe0c0 && (op & 0xf020) == 0xe020) {
+		p->cost = p->taken = (((op & 0x00c0) == 0x0080) ? 8 : 6) + 2 * SHIFT_WORST;
+		p->data = 1;
+	}
+}
+
+static FUNC *
+find_func(uint32_t addr)
+{
+	int i;
+	int s;
+	uint32_t next;
+	FUNC *f;
+
+	for(i = 0; i < num_funcs; i++) {
+		if(funcs[i].start == addr) {
+			return &funcs[i];
+		}
+	}
+
+	if(num_funcs == MAX_FUNCS) {
+		fprintf(stderr, "Too many functions\n");
+		exit(1);
+	}
+
+	f = &funcs[num_funcs++];
+	memset(f, 0, sizeof(FUNC));
+	f->start = addr;
+	f->end = ROM_SIZE;
+
+	// The function ends where the next symbol starts.
+	s = sym_index(addr);
+	f->pName = sym_get(s, &next);
+	if(s < 0 || next != addr) {
+		if((f->pName = malloc(16)) == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		sprintf(f->pName, "0x%x", addr);
+	}
+	for(s++; s < sym_count(); s++) {
+		sym_get(s, &next);
+		if(next > addr) {
+			f->end = next;
+			break;
+		}
+	}
+
+	return f;
+}
+
+static int
+func_index(FUNC *f)
+{
+	return f - funcs;
+}
+
+static int
+insn_at(FUNC *f, uint32_t addr)
+{
+	int lo = 0;
+	int hi = f->n - 1;
+	int mid;
+
+	while(lo <= hi) {
+		mid = (lo + hi) / 2;
+		if(f->pInsn[mid].addr == addr) {
+			return mid;
+		}
+		if(f->pInsn[mid].addr < addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return -1;
+}
+
+static void
+add_succ(INSN *p, uint32_t addr)
+{
+	if((p->pSucc = realloc(p->pSucc, (p->num_succ + 1) * sizeof(int))) == NULL ||
+			(p->pSuccAddr = realloc(p->pSuccAddr, (p->num_succ + 1) * sizeof(uint32_t))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	p->pSuccAddr[p->num_succ++] = addr;
+}
+
+// gcc's switch is
+//
+//	move.w	table(%pc,%d0.l),%d0
+//	jmp	2(%pc,%d0.w)
+// table:
+//	.word	case0 - table
+//	...
+//
+// and the first case follows the table, so the table ends at the lowest
+// target seen so far.
+static void
+jump_table(FUNC *f, INSN *p)
+{
+	uint32_t base = p->addr + 2 + (int8_t)fetch(p->addr + 2);
+	uint32_t lowest = f->end;
+	uint32_t entry;
+	uint32_t target;
+
+	for(entry = base; entry < lowest; entry += 2) {
+		target = base + (int16_t)fetch(entry);
+		if(target < f->start || target >= f->end || (target & 1)) {
+			break;
+		}
+		add_succ(p, target);
+		if(target < lowest && target > base) {
+			lowest = target;
+		}
+	}
+
+	if(p->num_succ == 0) {
+		printf("  %s+0x%x: cannot find the jump table\n", f->pName, p->addr - f->start);
+		problems++;
+	}
+}
+
+static int
+compare_insns(const void *a, const void *b)
+{
+	const INSN *pA = a;
+	const INSN *pB = b;
+
+	return (pA->addr > pB->addr) - (pA->addr < pB->addr);
+}
+
+// Find every instruction reachable from the start of the function.
+static void
+decode(FUNC *f)
+{
+	uint32_t *pWork;
+	char *pSeen;
+	int work = 0;
+	int size = f->end - f->start;
+	int max = 0;
+	int icall = 0;
+	uint32_t addr;
+	INSN *p;
+	int i;
+	int j;
+
+	if((pWork = malloc(size * sizeof(uint32_t))) == NULL ||
+			(pSeen = calloc(size, 1)) == NULL ||
+			(f->pInsn = calloc(size / 2 + 1, sizeof(INSN))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	max = size / 2 + 1;
+
+	pWork[work++] = f->start;
+	pSeen[0] = 1;
+	while(work) {
+		addr = pWork[--work];
+		if(f->n == max) {
+			break;
+		}
+
+		p = &f->pInsn[f->n++];
+		p->addr = addr;
+		p->op = fetch(addr);
+		p->len = insn_length(p->op);
+		p->callee = -1;
+		p->loop = -1;
+		classify(p);
+
+		switch(p->kind) {
+			case K_BRANCH:
+				add_succ(p, p->target);
+				break;
+			case K_COND:
+			case K_DBCC:
+				add_succ(p, p->addr + p->len);
+				add_succ(p, p->target);
+				break;
+			case K_TABLE:
+				jump_table(f, p);
+				break;
+			case K_IJUMP:
+			case K_RETURN:
+				break;
+			default:
+				add_succ(p, p->addr + p->len);
+				break;
+		}
+
+		for(i = 0; i < p->num_succ; i++) {
+			if(p->pSuccAddr[i] < f->start || p->pSuccAddr[i] >= f->end) {
+				continue;
+			}
+			if(!pSeen[p->pSuccAddr[i] - f->start]) {
+				pSeen[p->pSuccAddr[i] - f->start] = 1;
+				pWork[work++] = p->pSuccAddr[i];
+			}
+		}
+	}
+	free(pWork);
+	free(pSeen);
+
+	qsort(f->pInsn, f->n, sizeof(INSN), compare_insns);
+
+	for(i = 0; i < f->n; i++) {
+		p = &f->pInsn[i];
+
+		for(j = 0; j < p->num_succ; j++) {
+			if(p->pSuccAddr[j] >= f->start && p->pSuccAddr[j] < f->end) {
+				p->pSucc[j] = insn_at(f, p->pSuccAddr[j]);
+			} else if(p->kind == K_BRANCH) {
+				// A jump into another function is a tail call.
+				p->pSucc[j] = EXIT;
+				p->callee = func_index(find_func(p->pSuccAddr[j]));
+			} else {
+				p->pSucc[j] = EXIT;
+				printf("  %s+0x%x: runs off the end of the function\n", f->pName, p->addr - f->start);
+				problems++;
+			}
+		}
+
+		if(p->kind == K_CALL) {
+			p->callee = func_index(find_func(p->target));
+		} else if(p->kind == K_ICALL) {
+			p->icall = ++icall;
+		} else if(p->kind == K_IJUMP) {
+			printf("  %s+0x%x: computed jump, which we cannot follow\n", f->pName, p->addr - f->start);
+			problems++;
+		}
+
+		measure(p);
+	}
+}
+
+// Depth first search from the entry, giving the reverse postorder and the
+// back edges, and from those the loops.
+static void
+find_loops(FUNC *f)
+{
+	int *pStack;
+	int *pNext;
+	char *pState;
+	int *pWork;
+	int sp = 0;
+	int order;
+	int i;
+	int j;
+	int s;
+	int k;
+	int l;
+	int work;
+	LOOP *pLoop;
+
+	if((pStack = malloc(f->n * sizeof(int))) == NULL ||
+			(pNext = calloc(f->n, sizeof(int))) == NULL ||
+			(pState = calloc(f->n, 1)) == NULL ||
+			(pWork = malloc(f->n * sizeof(int))) == NULL ||
+			(f->pOrder = malloc(f->n * sizeof(int))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	order = f->n;
+	pStack[sp++] = 0;
+	pState[0] = 1;
+	while(sp) {
+		i = pStack[sp - 1];
+		if(pNext[i] < f->pInsn[i].num_succ) {
+			s = f->pInsn[i].pSucc[pNext[i]++];
+			if(s < 0) {
+				continue;
+			}
+			if(pState[s] == 0) {
+				pState[s] = 1;
+				pStack[sp++] = s;
+			} else if(pState[s] == 1) {
+				// A back edge, so s is a loop header.
+				for(l = 0; l < f->num_loops; l++) {
+					if(f->loops[l].header == s) {
+						break;
+					}
+				}
+				if(l == f->num_loops) {
+					if(l == MAX_LOOPS) {
+						fprintf(stderr, "%s: too many loops\n", f->pName);
+						exit(1);
+					}
+					pLoop = &f->loops[f->num_loops++];
+					pLoop->header = s;
+					pLoop->parent = -1;
+					if((pLoop->pBody = calloc(f->n, 1)) == NULL) {
+						fprintf(stderr, "Out of memory\n");
+						exit(1);
+					}
+					pLoop->pBody[s] = 1;
+				}
+
+				// The natural loop: everything that reaches i
+				// without going through s.
+				pLoop = &f->loops[l];
+				work = 0;
+				if(!pLoop->pBody[i]) {
+					pLoop->pBody[i] = 1;
+					pWork[work++] = i;
+				}
+				while(work) {
+					k = pWork[--work];
+					for(j = 0; j < f->n; j++) {
+						if(pLoop->pBody[j]) {
+							continue;
+						}
+						for(s = 0; s < f->pInsn[j].num_succ; s++) {
+							if(f->pInsn[j].pSucc[s] == k) {
+								break;
+							}
+						}
+						if(s < f->pInsn[j].num_succ) {
+							if(j == 0) {
+								printf("  %s+0x%x: loop entered other than at its header\n",
+										f->pName, f->pInsn[pLoop->header].addr - f->start);
+								problems++;
+							}
+							pLoop->pBody[j] = 1;
+							pWork[work++] = j;
+						}
+					}
+				}
+			}
+		} else {
+			pState[i] = 2;
+			f->pOrder[--order] = i;
+			f->pInsn[i].rpo = order;
+			sp--;
+		}
+	}
+
+	// Unreachable instructions (after a call that never returns, say) go
+	// at the front, where nothing will reach them.
+	for(i = 0; i < f->n; i++) {
+		if(pState[i] == 0) {
+			f->pOrder[--order] = i;
+			f->pInsn[i].rpo = order;
+		}
+	}
+
+	free(pStack);
+	free(pNext);
+	free(pState);
+	free(pWork);
+
+	// Number the loops by address, so the bounds file can name them.
+	for(i = 1; i < f->num_loops; i++) {
+		for(j = i; j > 0 && f->loops[j].header < f->loops[j - 1].header; j--) {
+			LOOP t = f->loops[j];
+
+			f->loops[j] = f->loops[j - 1];
+			f->loops[j - 1] = t;
+		}
+	}
+
+	// The parent of a loop is the smallest other loop that holds its
+	// header, and an instruction belongs to the smallest loop holding it.
+	for(i = 0; i < f->num_loops; i++) {
+		int best = -1;
+		int best_size = f->n + 1;
+
+		for(j = 0; j < f->num_loops; j++) {
+			if(j == i || !f->loops[j].pBody[f->loops[i].header]) {
+				continue;
+			}
+			for(k = s = 0; k < f->n; k++) {
+				s += f->loops[j].pBody[k];
+			}
+			if(s < best_size) {
+				best = j;
+				best_size = s;
+			}
+		}
+		f->loops[i].parent = best;
+	}
+	for(k = 0; k < f->n; k++) {
+		int best_size = f->n + 1;
+
+		for(j = 0; j < f->num_loops; j++) {
+			if(!f->loops[j].pBody[k]) {
+				continue;
+			}
+			for(l = s = 0; l < f->n; l++) {
+				s += f->loops[j].pBody[l];
+			}
+			if(s < best_size) {
+				f->pInsn[k].loop = j;
+				best_size = s;
+			}
+		}
+	}
+}
+
+static long analyse(FUNC *f);
+
+// The cost of going from instruction i to successor number k, including
+// anything it calls.
+static long
+edge(FUNC *f, INSN *p, int k)
+{
+	long cost = (p->kind == K_COND || p->kind == K_DBCC) ?
+		((p->pSuccAddr[k] == p->target) ? p->taken : p->cost) : p->cost;
+	BOUND *b;
+	long worst;
+	long w;
+	uint32_t addr;
+	int i;
+
+	if(p->callee >= 0) {
+		cost += analyse(&funcs[p->callee]);
+		f->guess |= funcs[p->callee].guess;
+	}
+
+	if(p->kind == K_ICALL) {
+		if((b = find_bound(f->pName, 1, p->icall)) == NULL) {
+			f->guess = 1;
+			return cost;
+		}
+		worst = 0;
+		for(i = 0; i < b->num_targets; i++) {
+			if((addr = sym_address(b->targets[i])) == SYM_NONE) {
+				fprintf(stderr, "No function called %s\n", b->targets[i]);
+				exit(1);
+			}
+			w = analyse(find_func(addr));
+			f->guess |= find_func(addr)->guess;
+			if(w > worst) {
+				worst = w;
+			}
+		}
+		cost += worst;
+	}
+
+	return cost;
+}
+
+// The loop, directly inside loop l (or the function, if l is -1), that
+// instruction i is in, or -1 if it is in l itself.
+static int
+child_loop(FUNC *f, int l, int i)
+{
+	int c = f->pInsn[i].loop;
+
+	while(c >= 0 && f->loops[c].parent != l) {
+		c = f->loops[c].parent;
+	}
+
+	return c;
+}
+
+static void
+relax(long *pDist, int i, long d)
+{
+	if(d > pDist[i]) {
+		pDist[i] = d;
+	}
+}
+
+// Longest paths from the header of loop l (or the start of the function)
+// to every instruction directly in it.  Loops inside are collapsed to
+// bound * trip.  Anything that leaves goes in pExit, indexed by where it
+// goes, or by n for a return, and edges back to the header go in *pBack.
+static void
+region(FUNC *f, int l, long *pDist, long *pExit, long *pBack)
+{
+	int start = (l < 0) ? 0 : f->loops[l].header;
+	long *pInner;
+	long *pInnerExit;
+	long back;
+	long trips;
+	long d;
+	INSN *p;
+	int c;
+	int i;
+	int k;
+	int s;
+
+	for(i = 0; i < f->n; i++) {
+		pDist[i] = -1;
+		pExit[i] = -1;
+	}
+	pExit[f->n] = -1;
+	*pBack = -1;
+	pDist[start] = 0;
+
+	for(k = f->pInsn[start].rpo; k < f->n; k++) {
+		i = f->pOrder[k];
+		if(pDist[i] < 0) {
+			continue;
+		}
+		if(l >= 0 && !f->loops[l].pBody[i]) {
+			continue;
+		}
+
+		c = child_loop(f, l, i);
+		if(c >= 0 && i != start) {
+			if(f->loops[c].header != i) {
+				continue;
+			}
+
+			// Collapse the inner loop.
+			if((pInner = malloc(f->n * sizeof(long))) == NULL ||
+					(pInnerExit = malloc((f->n + 1) * sizeof(long))) == NULL) {
+				fprintf(stderr, "Out of memory\n");
+				exit(1);
+			}
+			region(f, c, pInner, pInnerExit, &back);
+			f->loops[c].trip = (back < 0) ? 0 : back;
+
+			trips = f->loops[c].bound;
+			if(trips < 0) {
+				trips = 1;
+				f->guess = 1;
+			}
+			d = pDist[i] + trips * f->loops[c].trip;
+
+			for(s = 0; s <= f->n; s++) {
+				if(pInnerExit[s] < 0) {
+					continue;
+				}
+				if(s == f->n) {
+					relax(pExit, s, d + pInnerExit[s]);
+				} else if(s == start && l >= 0) {
+					if(d + pInnerExit[s] > *pBack) {
+						*pBack = d + pInnerExit[s];
+					}
+				} else if(l < 0 || f->loops[l].pBody[s]) {
+					relax(pDist, s, d + pInnerExit[s]);
+				} else {
+					relax(pExit, s, d + pInnerExit[s]);
+				}
+			}
+			free(pInner);
+			free(pInnerExit);
+			continue;
+		}
+
+		p = &f->pInsn[i];
+		if(p->kind == K_RETURN || p->kind == K_IJUMP) {
+			relax(pExit, f->n, pDist[i] + p->cost);
+			continue;
+		}
+
+		for(s = 0; s < p->num_succ; s++) {
+			d = pDist[i] + edge(f, p, s);
+			if(p->pSucc[s] < 0) {
+				// Tail call, or a problem already reported.
+				relax(pExit, f->n, d);
+			} else if(p->pSucc[s] == start && l >= 0) {
+				if(d > *pBack) {
+					*pBack = d;
+				}
+			} else if(l < 0 || f->loops[l].pBody[p->pSucc[s]]) {
+				if(f->pInsn[p->pSucc[s]].rpo <= k) {
+					// Only an irreducible loop gets here, and
+					// that has already been reported.
+					continue;
+				}
+				relax(pDist, p->pSucc[s], d);
+			} else {
+				relax(pExit, p->pSucc[s], d);
+			}
+		}
+	}
+}
+
+// Worst case for a call to the function, from its first instruction to
+// the end of its RTS.
+static long
+analyse(FUNC *f)
+{
+	long *pDist;
+	long *pExit;
+	long back;
+	BOUND *b;
+	int i;
+
+	if(f->state == 2) {
+		return f->worst;
+	}
+	if(f->state == 1) {
+		printf("  %s: recursive, counted once\n", f->pName);
+		problems++;
+		f->guess = 1;
+		return 0;
+	}
+	f->state = 1;
+
+	decode(f);
+	find_loops(f);
+	for(i = 0; i < f->num_loops; i++) {
+		b = find_bound(f->pName, 0, i + 1);
+		f->loops[i].bound = b ? b->bound : -1;
+	}
+
+	if((pDist = malloc(f->n * sizeof(long))) == NULL ||
+			(pExit = malloc((f->n + 1) * sizeof(long))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	region(f, -1, pDist, pExit, &back);
+	f->worst = (pExit[f->n] < 0) ? 0 : pExit[f->n];
+	free(pDist);
+	free(pExit);
+
+	f->state = 2;
+	return f->worst;
+}
+
+// One trip around the outermost loop in f that calls the function at
+// addr.  This is for main(), which never returns.
+static long
+one_trip(FUNC *f, uint32_t addr)
+{
+	long *pDist;
+	long *pExit;
+	long back;
+	int best = -1;
+	int i;
+	int l;
+
+	analyse(f);
+	for(i = 0; i < f->n; i++) {
+		if(f->pInsn[i].kind != K_CALL || f->pInsn[i].target != addr) {
+			continue;
+		}
+		for(l = f->pInsn[i].loop; l >= 0 && f->loops[l].parent >= 0; l = f->loops[l].parent) {
+		}
+		if(l >= 0) {
+			best = l;
+		}
+	}
+	if(best < 0) {
+		return -1;
+	}
+
+	if((pDist = malloc(f->n * sizeof(long))) == NULL ||
+			(pExit = malloc((f->n + 1) * sizeof(long))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	region(f, best, pDist, pExit, &back);
+	free(pDist);
+	free(pExit);
+
+	return back;
+}
+
+static void
+print_tree(FUNC *f, int level)
+{
+	int i;
+	int j;
+	int seen;
+
+	printf("  %*s%-*s %8ld%s\n", level * 2, "", 32 - level * 2, f->pName,
+			f->worst, f->guess ? "+" : "");
+	if(f->printed) {
+		return;
+	}
+	f->printed = 1;
+
+	// Each function called, once.
+	for(i = 0; i < f->n; i++) {
+		if(f->pInsn[i].callee < 0) {
+			continue;
+		}
+		for(seen = 0, j = 0; j < i; j++) {
+			if(f->pInsn[j].callee == f->pInsn[i].callee) {
+				seen = 1;
+				break;
+			}
+		}
+		if(!seen) {
+			print_tree(&funcs[f->pInsn[i].callee], level + 1);
+		}
+	}
+}
+
+static double
+usec(long cycles)
+{
+	return cycles * 1e6 / CPU_HZ;
+}
+
+// Is the address in the autovector table?
+static int
+is_interrupt(uint32_t addr)
+{
+	int v;
+
+	for(v = 25; v <= 31; v++) {
+		if(((fetch(v * 4) << 16) | fetch(v * 4 + 2)) == addr) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+report_entry(char *pEntry)
+{
+	char name[128];
+	char *pCallee;
+	uint32_t addr;
+	uint32_t callee;
+	FUNC *f;
+	long worst;
+
+	snprintf(name, sizeof(name), "%s", pEntry);
+	if((pCallee = strchr(name, '/')) != NULL) {
+		*pCallee++ = 0;
+	}
+
+	if((addr = sym_address(name)) == SYM_NONE) {
+		fprintf(stderr, "No function called %s\n", name);
+		exit(1);
+	}
+	f = find_func(addr);
+
+	if(pCallee) {
+		if((callee = sym_address(pCallee)) == SYM_NONE) {
+			fprintf(stderr, "No function called %s\n", pCallee);
+			exit(1);
+		}
+		if((worst = one_trip(f, callee)) < 0) {
+			fprintf(stderr, "%s has no loop that calls %s\n", name, pCallee);
+			exit(1);
+		}
+		printf("%s: one trip around the loop that calls %s: %ld%s clock periods, %.1f us\n",
+				name, pCallee, worst, f->guess ? "+" : "", usec(worst));
+	} else {
+		worst = analyse(f);
+		if(is_interrupt(addr)) {
+			worst += M68K_CYCLES_INTERRUPT;
+			printf("%s: %ld%s clock periods, %.1f us, including %d to take the interrupt\n",
+					name, worst, f->guess ? "+" : "", usec(worst), M68K_CYCLES_INTERRUPT);
+		} else {
+			printf("%s: %ld%s clock periods, %.1f us\n",
+					name, worst, f->guess ? "+" : "", usec(worst));
+		}
+	}
+
+	print_tree(f, 0);
+	printf("\n");
+}
+
+// Everything a bound would have helped with, and anything that depends
+// on the data.
+static void
+report_flags(void)
+{
+	FUNC *f;
+	INSN *p;
+	BOUND *b;
+	int i;
+	int j;
+
+	printf("Loops (bound = most times round, from the bounds file):\n");
+	for(i = 0; i < num_funcs; i++) {
+		f = &funcs[i];
+		for(j = 0; j < f->num_loops; j++) {
+			if(f->loops[j].bound < 0) {
+				printf("  %-24s loop %d at 0x%04x: %6ld per trip, no bound - depends on the data\n",
+						f->pName, j + 1, f->pInsn[f->loops[j].header].addr,
+						f->loops[j].trip);
+			} else {
+				printf("  %-24s loop %d at 0x%04x: %6ld per trip, bound %ld\n",
+						f->pName, j + 1, f->pInsn[f->loops[j].header].addr,
+						f->loops[j].trip, f->loops[j].bound);
+			}
+		}
+	}
+
+	printf("\nIndirect calls:\n");
+	for(i = 0; i < num_funcs; i++) {
+		f = &funcs[i];
+		for(j = 0; j < f->n; j++) {
+			p = &f->pInsn[j];
+			if(p->kind != K_ICALL) {
+				continue;
+			}
+			if((b = find_bound(f->pName, 1, p->icall)) == NULL) {
+				printf("  %s call %d at 0x%04x: no targets given - not counted\n", f->pName, p->icall, p->addr);
+			} else {
+				printf("  %s call %d at 0x%04x: %s%s\n", f->pName, p->icall, p->addr,
+						b->targets[0], (b->num_targets > 1) ? " ..." : "");
+			}
+		}
+	}
+
+	printf("\nCharged the worst case for any data:\n");
+	for(i = 0; i < num_funcs; i++) {
+		f = &funcs[i];
+		for(j = 0; j < f->n; j++) {
+			p = &f->pInsn[j];
+			if(p->data) {
+				printf("  %s+0x%x: %s, %d\n", f->pName, p->addr - f->start,
+						((p->op & 0xf000) == 0xe000) ? "shift by a register" :
+						((p->op & 0xf000) == 0xc000) ? "multiply" : "divide",
+						p->cost);
+			}
+		}
+	}
+
+	for(i = 0; i < num_bounds; i++) {
+		if(!bounds[i].used) {
+			printf("\nBound for %s %s %d was not used\n",
+					bounds[i].is_call ? "call" : "loop",
+					bounds[i].function, bounds[i].index);
+		}
+	}
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-b bounds] fw.dump [entry ...]\n", pName);
+	fprintf(stderr, "\t-b = loop bounds and indirect call targets\n");
+	fprintf(stderr, "\tentry = function, or function/callee for one trip around the\n");
+	fprintf(stderr, "\t        loop in function that calls callee\n");
+	fprintf(stderr, "\tThe default entries are _level3, _level2 and main/screen_handler.\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static char *default_entries[] = { "_level3", "_level2", "main/screen_handler" };
+	char *pBounds = NULL;
+	char *pDump;
+	int opt;
+	int i;
+
+	while((opt = getopt(argc, argv, "b:")) != -1) {
+		switch(opt) {
+			case 'b':
+				pBounds = optarg;
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind >= argc) {
+		usage(argv[0]);
+	}
+
+	pDump = argv[optind++];
+	load_dump(pDump);
+	sym_load_dump(pDump);
+	if(pBounds) {
+		load_bounds(pBounds);
+	}
+
+	printf("Worst case at %d Hz, in 68000 clock periods.  A + means it includes\n", CPU_HZ);
+	printf("a loop or indirect call with no bound, which was counted once.\n\n");
+	if(optind < argc) {
+		for(; optind < argc; optind++) {
+			report_entry(argv[optind]);
+		}
+	} else {
+		for(i = 0; i < 3; i++) {
+			report_entry(default_entries[i]);
+		}
+	}
+
+	report_flags();
+
+	if(problems) {
+		printf("\n%d problems, see above\n", problems);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,253 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Golden screen checker for the host-native build.
+//
+// Each test in the directory is a byte stream, listed in the BUDGET index,
+// with the screen it should leave behind in name.screen: 24 lines of 80
+// characters, then the row and column of the cursor.  We run each stream
+// through screen_handler() from a cold start and compare the frame RAM
+// with that.  With -u, the screens are written instead, so check the
+// differences with git before committing them.
+//
+// The cycle budgets in the index need the real firmware, so they are
+// checked by emu/build/golden, not here.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "host.h"
+#include "screen.h"
+#include "uart.h"
+
+#define ROWS		(24)
+#define COLUMNS		(80)
+#define CURSOR		(0x80)
+
+// The rows, each with a newline, and a line for the cursor.
+#define SCREEN_MAX	(ROWS * (COLUMNS + 1) + 64)
+
+// Read a whole file.  Nulls are left in; uart_receive_span() drops them.
+static unsigned char *
+load(char *pFile, int *pLen)
+{
+	int fd;
+	struct stat statbuf;
+	unsigned char *pData;
+
+	if((fd = open(pFile, O_RDONLY)) == -1) {
+		return NULL;
+	}
+
+	if(fstat(fd, &statbuf) == -1) {
+		fprintf(stderr, "Cannot get status for %s\n", pFile);
+		exit(1);
+	}
+
+	if((pData = malloc(statbuf.st_size + 1)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	if(read(fd, pData, statbuf.st_size) != statbuf.st_size) {
+		fprintf(stderr, "Cannot read %s\n", pFile);
+		exit(1);
+	}
+	close(fd);
+
+	pData[statbuf.st_size] = 0;
+	*pLen = statbuf.st_size;
+
+	return pData;
+}
+
+// The frame RAM as text.  Anything that isn't printable shows as a space,
+// as emu -s does.
+static void
+render(char *pScreen)
+{
+	int row;
+	int col;
+	int cursor = -1;
+	unsigned short w;
+	unsigned char c;
+	char *p = pScreen;
+
+	for(row = 0; row < ROWS; row++) {
+		for(col = 0; col < COLUMNS; col++) {
+			w = host_frame_ram[row * COLUMNS + col];
+			if((w & CURSOR) && cursor < 0) {
+				cursor = row * COLUMNS + col;
+			}
+			c = w & 0x7f;
+			*p++ = (c < 0x20 || c == 0x7f) ? ' ' : c;
+		}
+		*p++ = '\n';
+	}
+
+	if(cursor < 0) {
+		sprintf(p, "cursor none\n");
+	} else {
+		sprintf(p, "cursor %d %d\n", cursor / COLUMNS + 1, cursor % COLUMNS + 1);
+	}
+}
+
+// Print the rows that differ.
+static void
+differences(char *pWant, char *pGot)
+{
+	char *pW = pWant;
+	char *pG = pGot;
+	char *pWEnd;
+	char *pGEnd;
+	int line = 1;
+
+	while(*pW && *pG) {
+		pWEnd = strchr(pW, '\n');
+		pGEnd = strchr(pG, '\n');
+		if(pWEnd == NULL || pGEnd == NULL) {
+			break;
+		}
+		if(pWEnd - pW != pGEnd - pG || memcmp(pW, pG, pWEnd - pW) != 0) {
+			printf("  %2d want |%.*s|\n", line, (int)(pWEnd - pW), pW);
+			printf("  %2d got  |%.*s|\n", line, (int)(pGEnd - pG), pG);
+		}
+		pW = pWEnd + 1;
+		pG = pGEnd + 1;
+		line++;
+	}
+}
+
+// Returns 1 if the screen is wrong.
+static int
+check(char *pDir, char *pTest, int update)
+{
+	char name[1024];
+	char got[SCREEN_MAX];
+	unsigned char *pData;
+	unsigned char *pWant;
+	int len;
+	int want_len;
+	FILE *fp;
+
+	snprintf(name, sizeof(name), "%s/%s", pDir, pTest);
+	if((pData = load(name, &len)) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		exit(1);
+	}
+
+	uart_initialize();
+	screen_initialize(0);
+	host_uart_feed(pData, len);
+	while(host_uart_pending()) {
+		screen_handler();
+	}
+	render(got);
+	free(pData);
+
+	snprintf(name, sizeof(name), "%s/%s.screen", pDir, pTest);
+	if(update) {
+		if((fp = fopen(name, "w")) == NULL) {
+			fprintf(stderr, "Cannot create %s\n", name);
+			exit(1);
+		}
+		fputs(got, fp);
+		fclose(fp);
+		printf("%-16s written\n", pTest);
+		return 0;
+	}
+
+	if((pWant = load(name, &want_len)) == NULL) {
+		printf("%-16s no %s\n", pTest, name);
+		return 1;
+	}
+
+	if(strcmp((char *)pWant, got) != 0) {
+		printf("%-16s wrong screen\n", pTest);
+		differences((char *)pWant, got);
+		free(pWant);
+		return 1;
+	}
+
+	printf("%-16s ok\n", pTest);
+	free(pWant);
+	return 0;
+}
+
+static void
+usage(char *pName)
+{
+	fprintf(stderr, "Usage: %s [-u] dir\n", pName);
+	fprintf(stderr, "\t-u = write the screens rather than checking them\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	int update = 0;
+	int failed = 0;
+	char name[1024];
+	char line[1024];
+	char test[256];
+	FILE *fp;
+
+	while((opt = getopt(argc, argv, "u")) != -1) {
+		switch(opt) {
+			case 'u':
+				update = 1;
+				break;
+
+			default: /* '?' */
+				usage(argv[0]);
+		}
+	}
+
+	if(optind + 1 != argc) {
+		usage(argv[0]);
+	}
+
+	snprintf(name, sizeof(name), "%s/BUDGET", argv[optind]);
+	if((fp = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "Cannot open %s\n", name);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(line[0] == '#' || sscanf(line, "%255s", test) != 1) {
+			continue;
+		}
+		failed += check(argv[optind], test, update);
+	}
+	fclose(fp);
+
+	if(failed) {
+		printf("%d failed\n", failed);
+		exit(1);
+	}
+
+	exit(0);
+}
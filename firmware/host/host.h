@@ -0,0 +1,51 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Host-native build shim.
+//
+// This file is force-included (gcc -include) ahead of each firmware source
+// file in the host build, so it may only contain declarations and macros.
+// It redirects the hardware addresses used by the firmware to plain memory
+// that lives in shim.c.
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+// Frame RAM: 0x8000 to 0x8eff on the real hardware, 1920 16-bit words.
+#define host_frame_words	(1920)
+extern volatile unsigned short host_frame_ram[host_frame_words];
+#define screen_base_address	(host_frame_ram)
+
+// UART registers: 0xc000 to 0xc00f on the real hardware.  Only the even
+// addresses are decoded, so there are 8 of them.
+extern volatile unsigned char host_uart_regs[8];
+
+// Queue a buffer of received characters.  The buffer is not copied, so it
+// must stay valid until host_uart_pending() returns 0.
+extern void host_uart_feed(const unsigned char *data, int len);
+
+// Return the number of received characters not yet taken by
+// uart_receive_span().
+extern int host_uart_pending();
+
+// Everything sent via uart_transmit() is captured here, so that replies
+// (cursor position reports, etc.) can be examined.
+#define host_tx_depth		(256)
+extern unsigned char host_tx_buffer[host_tx_depth];
+extern int host_tx_count;
+
+#endif // _HOST_H_
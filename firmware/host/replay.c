@@ -0,0 +1,420 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Replay driver for the host-native build.
+//
+// We read recorded byte streams (vim sessions, "cat" of large files,
+// "ls -lR", etc.) and push them through screen_handler(), exactly as the
+// main loop does on the real hardware.  We report the overall throughput,
+// and we also break the time down by escape sequence, so we can see which
+// sequences are expensive.
+//
+// To capture a new stream, see the "record" script in this directory.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "host.h"
+#include "screen.h"
+#include "uart.h"
+#include "parser/vtparse.h"
+
+#define MAX_CLASSES	(256)
+#define CLASS_NAME_LEN	(16)
+
+// A class is a kind of escape sequence, like "CSI H" or "ESC 7", or
+// a C0 control, or a run of printable text.
+typedef struct {
+	char		name[CLASS_NAME_LEN];
+	long		count;
+	long		bytes;
+	double		ns;
+} CLASS;
+
+// A token is one complete sequence as recognized by the parser.
+typedef struct {
+	int		start;
+	int		len;
+	int		class;
+} TOKEN;
+
+static CLASS classes[MAX_CLASSES];
+static int num_classes;
+
+static TOKEN *tokens;
+static int num_tokens;
+
+// Set by the classifier callback when the parser completes a sequence.
+static int classify_pending;
+static char classify_name[CLASS_NAME_LEN];
+
+static double
+now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((double)ts.tv_sec * 1E9) + (double)ts.tv_nsec;
+}
+
+// Figure out how long an empty timing interval takes, so we can subtract
+// it from each token.
+static double
+timer_overhead()
+{
+	int i;
+	double t0;
+	double t1;
+	double total = 0;
+
+	for(i = 0; i < 100000; i++) {
+		t0 = now_ns();
+		t1 = now_ns();
+		total += t1 - t0;
+	}
+
+	return total / 100000;
+}
+
+static int
+find_class(char *name)
+{
+	int i;
+
+	for(i = 0; i < num_classes; i++) {
+		if(strcmp(classes[i].name, name) == 0) {
+			return i;
+		}
+	}
+
+	if(num_classes == MAX_CLASSES) {
+		// Lump everything else together.
+		return MAX_CLASSES - 1;
+	}
+
+	memset(&classes[num_classes], 0, sizeof(CLASS));
+	strncpy(classes[num_classes].name, name, CLASS_NAME_LEN - 1);
+
+	return num_classes++;
+}
+
+// The classifier is a second copy of the parser, with a callback that
+// just names whatever it sees.  That way, our idea of where a sequence
+// ends is exactly the same as the real parser's idea.
+static void
+classify_callback(vtparse_t *parser, vtparse_action_t action, unsigned char c)
+{
+	char intermediates[MAX_INTERMEDIATE_CHARS + 1];
+	int i;
+
+	for(i = 0; i < parser->num_intermediate_chars; i++) {
+		intermediates[i] = parser->intermediate_chars[i];
+	}
+	intermediates[i] = 0;
+
+	switch(action) {
+		case VTPARSE_ACTION_PRINT:
+			strcpy(classify_name, "text");
+			break;
+
+		case VTPARSE_ACTION_EXECUTE:
+			snprintf(classify_name, CLASS_NAME_LEN, "C0 0x%02x", c);
+			break;
+
+		case VTPARSE_ACTION_CSI_DISPATCH:
+			snprintf(classify_name, CLASS_NAME_LEN, "CSI %s%c", intermediates, c);
+			break;
+
+		case VTPARSE_ACTION_ESC_DISPATCH:
+			snprintf(classify_name, CLASS_NAME_LEN, "ESC %s%c", intermediates, c);
+			break;
+
+		default:
+			// Strings, etc.  Name them by action, and let them
+			// end with whatever byte we are on.
+			snprintf(classify_name, CLASS_NAME_LEN, "%s", ACTION_NAMES[action]);
+			break;
+	}
+
+	classify_pending = 1;
+}
+
+// Split the stream into tokens.  Runs of printable text are merged into
+// a single token.
+static void
+classify(unsigned char *data, int len)
+{
+	vtparse_t parser;
+	unsigned char c;
+	int start = 0;
+	int i;
+	int class;
+	int text_class = find_class("text");
+
+	tokens = malloc(len * sizeof(TOKEN));
+	if(tokens == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	num_tokens = 0;
+
+	vtparse_init(&parser, classify_callback);
+
+	for(i = 0; i < len; i++) {
+		// Fold the same way uart_store_char() does.
+		c = data[i];
+		if(c >= 0xa0) {
+			c -= 0x80;
+		}
+
+		classify_pending = 0;
+		vtparse(&parser, &c, 1);
+		if(!classify_pending) {
+			// Still in the middle of a sequence.
+			continue;
+		}
+
+		class = find_class(classify_name);
+		if(class == text_class && num_tokens > 0 &&
+				tokens[num_tokens - 1].class == text_class) {
+			// Extend the previous run of text.
+			tokens[num_tokens - 1].len += (i + 1) - start;
+		} else {
+			tokens[num_tokens].start = start;
+			tokens[num_tokens].len = (i + 1) - start;
+			tokens[num_tokens].class = class;
+			num_tokens++;
+		}
+		start = i + 1;
+	}
+
+	// Anything left over is an unfinished sequence.
+	if(start < len) {
+		tokens[num_tokens].start = start;
+		tokens[num_tokens].len = len - start;
+		tokens[num_tokens].class = find_class("partial");
+		num_tokens++;
+	}
+}
+
+// Read a whole file, dropping nulls, since the UART interrupt service
+// routine never stores them.
+static unsigned char *
+load(char *pFile, int *pLen)
+{
+	int fd;
+	struct stat statbuf;
+	unsigned char *pData;
+	int i;
+	int j;
+
+	if((fd = open(pFile, O_RDONLY)) == -1) {
+		fprintf(stderr, "Cannot open %s\n", pFile);
+		exit(1);
+	}
+
+	if(fstat(fd, &statbuf) == -1) {
+		fprintf(stderr, "Cannot get status for %s\n", pFile);
+		exit(1);
+	}
+
+	if((pData = malloc(statbuf.st_size + 1)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	if(read(fd, pData, statbuf.st_size) != statbuf.st_size) {
+		fprintf(stderr, "Cannot read %s\n", pFile);
+		exit(1);
+	}
+	close(fd);
+
+	for(i = 0, j = 0; i < statbuf.st_size; i++) {
+		if(pData[i]) {
+			pData[j++] = pData[i];
+		}
+	}
+
+	*pLen = j;
+
+	return pData;
+}
+
+static int
+compare_classes(const void *a, const void *b)
+{
+	const CLASS *pA = a;
+	const CLASS *pB = b;
+
+	if(pA->ns < pB->ns) {
+		return 1;
+	}
+	if(pA->ns > pB->ns) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+replay(char *pFile, int iterations, int breakdown, double overhead)
+{
+	unsigned char *pData;
+	int len;
+	int n;
+	int i;
+	double t0;
+	double t1;
+	double total;
+	double timed;
+	TOKEN *pToken;
+
+	pData = load(pFile, &len);
+	if(len == 0) {
+		printf("%s: empty\n", pFile);
+		free(pData);
+		return;
+	}
+
+	num_classes = 0;
+	classify(pData, len);
+
+	// Straight throughput first, with nothing in the loop but the
+	// screen handler.
+	total = 0;
+	for(n = 0; n < iterations; n++) {
+		uart_initialize();
+		screen_initialize(0);
+		host_uart_feed(pData, len);
+
+		t0 = now_ns();
+		while(host_uart_pending()) {
+			screen_handler();
+		}
+		t1 = now_ns();
+
+		total += t1 - t0;
+	}
+
+	printf("%s: %d bytes, %d iterations\n", pFile, len, iterations);
+	printf("  %.0f bytes/sec, %.2f ns/byte\n",
+			((double)len * iterations) / (total / 1E9),
+			total / ((double)len * iterations));
+
+	if(!breakdown) {
+		free(pData);
+		free(tokens);
+		return;
+	}
+
+	// Now time each token separately.
+	for(n = 0; n < iterations; n++) {
+		uart_initialize();
+		screen_initialize(0);
+
+		for(i = 0; i < num_tokens; i++) {
+			pToken = &tokens[i];
+
+			// screen_handler() takes everything pending, so feed
+			// one token at a time.
+			host_uart_feed(pData + pToken->start, pToken->len);
+
+			t0 = now_ns();
+			while(host_uart_pending()) {
+				screen_handler();
+			}
+			t1 = now_ns();
+
+			classes[pToken->class].ns += (t1 - t0) - overhead;
+			if(n == 0) {
+				classes[pToken->class].count++;
+				classes[pToken->class].bytes += pToken->len;
+			}
+		}
+	}
+
+	timed = 0;
+	for(i = 0; i < num_classes; i++) {
+		classes[i].ns /= iterations;
+		timed += classes[i].ns;
+	}
+
+	qsort(classes, num_classes, sizeof(CLASS), compare_classes);
+
+	printf("  %-16s %9s %9s %10s %10s %7s\n",
+			"sequence", "count", "bytes", "ns/each", "ns/byte", "%time");
+	for(i = 0; i < num_classes; i++) {
+		printf("  %-16s %9ld %9ld %10.1f %10.2f %6.1f%%\n",
+				classes[i].name,
+				classes[i].count,
+				classes[i].bytes,
+				classes[i].ns / classes[i].count,
+				classes[i].ns / classes[i].bytes,
+				100.0 * classes[i].ns / timed);
+	}
+
+	free(pData);
+	free(tokens);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt;
+	int iterations = 10;
+	int breakdown = 1;
+	double overhead;
+
+	while((opt = getopt(argc, argv, "n:t")) != -1) {
+		switch(opt) {
+			case 'n':
+				iterations = atoi(optarg);
+				break;
+			case 't':
+				breakdown = 0;
+				break;
+
+			default: /* '?' */
+				fprintf(stderr, "Usage: %s [-n iterations] [-t] file ...\n", argv[0]);
+				fprintf(stderr, "\t-t = throughput only, no per-sequence breakdown\n");
+				exit(1);
+		}
+	}
+
+	if(optind >= argc || iterations < 1) {
+		fprintf(stderr, "Usage: %s [-n iterations] [-t] file ...\n", argv[0]);
+		exit(1);
+	}
+
+	overhead = timer_overhead();
+
+	for(; optind < argc; optind++) {
+		replay(argv[optind], iterations, breakdown, overhead);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,165 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Host-native replacement for uart.c.
+//
+// The frame RAM and the UART registers are backed by plain memory.  Rather
+// than taking interrupts, the receiver is fed from a buffer supplied by the
+// replay driver.  uart_receive_span() copies as much of what is pending as
+// the real driver would hand out at once into a buffer, tossing nulls and
+// folding GR onto GL as its interrupt service routine does.
+
+#include <string.h>
+
+#include "host.h"
+#include "uart.h"
+
+// UART register indices (even addresses only, so divided by 2).
+#define uart_THR_i		(0)
+#define uart_LCR_i		(3)
+#define uart_MCR_i		(4)
+#define uart_LSR_i		(5)
+
+#define uart_LCR_SBRK_v		(0x40)
+#define uart_MCR_INIT		(0x03)
+#define uart_LSR_THRE_v		(0x20)
+
+volatile unsigned short host_frame_ram[host_frame_words];
+volatile unsigned char host_uart_regs[8];
+
+unsigned char host_tx_buffer[host_tx_depth];
+int host_tx_count;
+
+int uart_break_timer;
+
+// Nothing can go wrong on the host, so these stay at 0.
+UART_STATS uart_stats;
+
+static const unsigned char *host_rx_data;
+static int host_rx_len;
+static int host_rx_pos;
+
+// uart_span_max in uart.c.
+#define host_rb_depth		(128)
+
+static uint8_t host_rb[host_rb_depth];
+
+void
+host_uart_feed(const unsigned char *data, int len)
+{
+	host_rx_data = data;
+	host_rx_len = len;
+	host_rx_pos = 0;
+}
+
+int
+host_uart_pending()
+{
+	return host_rx_len - host_rx_pos;
+}
+
+void
+uart_initialize()
+{
+	host_rx_data = 0;
+	host_rx_len = 0;
+	host_rx_pos = 0;
+
+	host_tx_count = 0;
+
+	host_uart_regs[uart_MCR_i] = uart_MCR_INIT;
+	host_uart_regs[uart_LSR_i] = uart_LSR_THRE_v;
+}
+
+void
+uart_test_interrupt(uint8_t lsr)
+{
+	// There are no interrupts on the host.
+}
+
+int
+uart_transmit(unsigned char c, int wait)
+{
+	if(uart_break_timer != 0) {
+		return 0;
+	}
+
+	host_uart_regs[uart_THR_i] = c;
+
+	// Keep the most recent replies.
+	host_tx_buffer[host_tx_count++ & (host_tx_depth - 1)] = c;
+
+	return 1;
+}
+
+void
+uart_transmit_string(char *pString, int wait)
+{
+	char *p = pString;
+
+	while(*p != 0) {
+		uart_transmit(*p++, wait);
+	}
+}
+
+int
+uart_receive_span(uint8_t **ppData)
+{
+	uint8_t val;
+	int n = 0;
+
+	while(n < host_rb_depth && host_rx_pos < host_rx_len) {
+		val = host_rx_data[host_rx_pos++];
+
+		// Toss nulls, as the interrupt service routine does.
+		if(!val) {
+			continue;
+		}
+		if(val >= 0xa0) {
+			val -= 0x80;
+		}
+		host_rb[n++] = val;
+	}
+
+	*ppData = host_rb;
+	return n;
+}
+
+void
+uart_receive_done(int n)
+{
+	// uart_receive_span() already took them.
+}
+
+void
+uart_clear_stats()
+{
+	memset(&uart_stats, 0, sizeof(uart_stats));
+}
+
+void
+uart_start_break()
+{
+	uart_break_timer = 7777;
+	host_uart_regs[uart_LCR_i] |= uart_LCR_SBRK_v;
+}
+
+void
+uart_stop_break()
+{
+	host_uart_regs[uart_LCR_i] &= ~uart_LCR_SBRK_v;
+}
@@ -0,0 +1,145 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// Interrupt timing statistics, built in with "make IPL_STATS=1".
+//
+// cpu_bus.vhd has a free-running timer that counts the 88.5 MHz clock,
+// and copies it into a time stamp register whenever the UART raises its
+// interrupt.  We use them to record:
+//
+// - the longest time the main loop spent with interrupts masked, between
+//   an spl() that raised the level from 0 and the splx() that put it back,
+//
+// - how long the UART interrupt waited before _level3 (in init.S) ran,
+//   as a histogram, and
+//
+// - the longest time from the UART interrupt going up until
+//   _level3 was done with it.
+//
+// Pressing BREAK prints them, once the break is over.  The times are in
+// 88.5 MHz clocks, which is two per 68000 clock period.  The emulator
+// (emu -i) gives the same numbers without any of this in the image.
+
+#include "ipl_stats.h"
+#include "debug.h"
+
+#ifdef IPL_STATS
+
+#define timer_HIGH		(*(volatile uint16_t *)(0xc0a0))	// Reading latches timer_LOW
+#define timer_LOW		(*(volatile uint16_t *)(0xc0a2))
+#define timer_STAMP_HIGH	(*(volatile uint16_t *)(0xc0a4))	// When the UART interrupt went up
+#define timer_STAMP_LOW		(*(volatile uint16_t *)(0xc0a6))
+
+// Powers of two, so bucket n holds times from 2^n to 2^(n+1) - 1.
+#define ipl_stats_buckets	(16)
+
+static int ipl_stats_masked;
+static uint32_t ipl_stats_masked_start;
+static uint32_t ipl_stats_masked_max;
+
+static uint32_t ipl_stats_uart_stamp;
+static uint32_t ipl_stats_latency_max;
+static uint32_t ipl_stats_latency[ipl_stats_buckets];
+static uint32_t ipl_stats_service_max;
+
+static uint32_t
+timer_read()
+{
+	uint32_t high = timer_HIGH;
+
+	return (high << 16) | timer_LOW;
+}
+
+// Called by _spl() when it raises the level from 0.
+void
+ipl_stats_raise()
+{
+	ipl_stats_masked = 1;
+	ipl_stats_masked_start = timer_read();
+}
+
+// Called by splx() when it puts the level back to 0.
+void
+ipl_stats_lower()
+{
+	uint32_t elapsed;
+
+	if(ipl_stats_masked) {
+		elapsed = timer_read() - ipl_stats_masked_start;
+		if(elapsed > ipl_stats_masked_max) {
+			ipl_stats_masked_max = elapsed;
+		}
+		ipl_stats_masked = 0;
+	}
+}
+
+// Called at the start of _level3.
+void
+ipl_stats_uart_entry()
+{
+	uint32_t elapsed;
+	int bucket = 0;
+
+	ipl_stats_uart_stamp = ((uint32_t)timer_STAMP_HIGH << 16) | timer_STAMP_LOW;
+	elapsed = timer_read() - ipl_stats_uart_stamp;
+
+	if(elapsed > ipl_stats_latency_max) {
+		ipl_stats_latency_max = elapsed;
+	}
+
+	// No divide or multiply, just shifts.
+	while(elapsed > 1 && bucket < ipl_stats_buckets - 1) {
+		elapsed >>= 1;
+		bucket++;
+	}
+	ipl_stats_latency[bucket]++;
+}
+
+// Called at the end of _level3.
+void
+ipl_stats_uart_exit()
+{
+	uint32_t elapsed = timer_read() - ipl_stats_uart_stamp;
+
+	if(elapsed > ipl_stats_service_max) {
+		ipl_stats_service_max = elapsed;
+	}
+}
+
+// Print everything, and start again.
+void
+ipl_stats_report()
+{
+	int i;
+
+	dump("masked max", ipl_stats_masked_max);
+	dump("uart latency max", ipl_stats_latency_max);
+	dump("uart service max", ipl_stats_service_max);
+	for(i = 0; i < ipl_stats_buckets; i++) {
+		if(ipl_stats_latency[i]) {
+			dump("uart latency 2^n, n", i);
+			dump("    count", ipl_stats_latency[i]);
+		}
+		ipl_stats_latency[i] = 0;
+	}
+
+	ipl_stats_masked_max = 0;
+	ipl_stats_latency_max = 0;
+	ipl_stats_service_max = 0;
+}
+
+#endif // IPL_STATS
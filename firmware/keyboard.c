@@ -48,10 +48,13 @@
 #define KB_EXTENSION_E1_GOING_UP	(6)
 static int keyboard_state;
 
+// The scan code ring.  As with uart_rb, the interrupt service routine only
+// writes keyboard_rb_input and keyboard_handler() only writes
+// keyboard_rb_output, so neither has to mask interrupts, and the
+// difference between them is how many scan codes are waiting.
 static uint8_t keyboard_rb[keyboard_depth];
-static int keyboard_rb_input;
-static int keyboard_rb_output;
-static int keyboard_rb_count;
+static volatile uint16_t keyboard_rb_input;
+static volatile uint16_t keyboard_rb_output;
 
 static int keyboard_modifiers;
 
@@ -62,7 +65,6 @@ keyboard_initialize()
 	// Clear the scan code receive buffer.
 	keyboard_rb_input = 0;
 	keyboard_rb_output = 0;
-	keyboard_rb_count = 0;
 
 	// Reset the state machine.
 	keyboard_state = KB_NORMAL;
@@ -89,14 +91,11 @@ keyboard_test_interrupt()
 		scan_code = keyboard_SCAN_CODE;
 
 		// Store the scan code if there is room.
-		if(keyboard_rb_count < keyboard_depth) {
-			keyboard_rb[keyboard_rb_input] = scan_code;
+		if((uint16_t)(keyboard_rb_input - keyboard_rb_output) < keyboard_depth) {
+			keyboard_rb[keyboard_rb_input & (keyboard_depth - 1)] = scan_code;
 
 			// One more now available.
-			++keyboard_rb_count;
-
-			// Move the input pointer, keeping it in range.
-			keyboard_rb_input = (keyboard_rb_input + 1) & (keyboard_depth - 1);
+			++keyboard_rb_input;
 		}
 	}
 }
@@ -784,49 +783,27 @@ keyboard_decode(uint8_t scan_code)
 int
 keyboard_handler()
 {
-	uint16_t sr;
-
-	// Assume nothing available.
-	int rv = 0;
-
-	// I shouldn't need to initialize scan_code here, because rv != 0
-	// protects the call to keyboard_decode().  But gcc gives an
-	// "uninitialized variable" warning.
-	uint8_t scan_code = 0;
-
-	// We need mutual exclusion with our interrupt service routine.
-	// It runs at level 2, so mask out interrupts at level 2 and below.
-	sr = spl2();
-
-	// See if there is anything waiting to be processed.
-	if(keyboard_rb_count != 0) {
-		// We have a new scan code.  Flag it for use by the screensaver
-		// timeout logic.  Note that just pressing "shift" or "control"
-		// will wake the screensaver, and that is exactly the behavior
-		// that we want.
-		rv = 1;
-
-		// Get the scan code.
-		scan_code = keyboard_rb[keyboard_rb_output];
-
-		// One less now available.
-		--keyboard_rb_count;
+	uint8_t scan_code;
 
-		// Move the output pointer, keeping it in range.
-		keyboard_rb_output = (keyboard_rb_output + 1) & (keyboard_depth - 1);
+	// See if there is anything waiting to be processed.  The interrupt
+	// service routine only adds scan codes, so no mutual exclusion is
+	// needed.
+	if(keyboard_rb_input == keyboard_rb_output) {
+		return 0;
 	}
 
-	// Go back to the previous interrupt level (should be 0, because we
-	// don't do preemption).
-	splx(sr);
+	// Get the scan code.
+	scan_code = keyboard_rb[keyboard_rb_output & (keyboard_depth - 1)];
 
-	// We want to do the decode outside of the interrupt mask, because
-	// this process can be slow, especially if we have to wait for the
-	// uart when sending a keystroke.
-	if(rv != 0) {
-		// Decode it.
-		keyboard_decode(scan_code);
-	}
+	// Give the slot back, but only once the scan code has been read.
+	barrier();
+	++keyboard_rb_output;
+
+	// We have a new scan code.  Decode it, and flag it for use by the
+	// screensaver timeout logic.  Note that just pressing "shift" or
+	// "control" will wake the screensaver, and that is exactly the
+	// behavior that we want.
+	keyboard_decode(scan_code);
 
-	return rv;
+	return 1;
 }
@@ -18,6 +18,7 @@
 // Main program.
 
 #include "debug.h"
+#include "ipl_stats.h"
 #include "keyboard.h"
 #include "screen.h"
 #include "uart.h"
@@ -92,6 +93,9 @@ main()
 			--uart_break_timer;
 			if(uart_break_timer == 0) {
 				uart_stop_break();
+#ifdef IPL_STATS
+				ipl_stats_report();
+#endif
 			}
 		}
 	}
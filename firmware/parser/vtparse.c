@@ -10,17 +10,92 @@
 
 void vtparse_init(vtparse_t *parser, vtparse_callback_t cb)
 {
+    int i;
+
     parser->state                  = VTPARSE_STATE_GROUND;
     parser->num_intermediate_chars = 0;
     parser->num_params             = 0;
     parser->ignore_flagged         = 0;
     parser->cb                     = cb;
+    parser->print                  = 0;
+
+    /* do_clear() only clears the parameters that were used. */
+    for(i = 0; i < MAX_PARAMS; i++) {
+        parser->params[i] = 0;
+    }
 }
 
-static void do_action(vtparse_t *parser, vtparse_action_t action, char ch)
+static void do_collect(vtparse_t *parser, char ch)
+{
+    /* Append the character to the intermediate params */
+    if(parser->num_intermediate_chars + 1 > MAX_INTERMEDIATE_CHARS)
+        parser->ignore_flagged = 1;
+    else
+        parser->intermediate_chars[parser->num_intermediate_chars++] = ch;
+}
+
+static void do_param(vtparse_t *parser, char ch)
+{
+    /* process the param character */
+    if(ch == ';')
+    {
+        if(parser->num_params < MAX_PARAMS) {
+            parser->num_params += 1;
+        }
+        parser->params[parser->num_params-1] = 0;
+    }
+    else
+    {
+        /* the character is a digit */
+        unsigned short *param;
+
+        if(parser->num_params == 0)
+        {
+            parser->num_params = 1;
+            parser->params[0]  = 0;
+        }
+
+        /* The parameters are 16 bits, so that the multiply is a MULU
+         * rather than a call to __mulsi3, and stick at VTPARSE_PARAM_MAX
+         * rather than wrapping. */
+        param = &parser->params[parser->num_params - 1];
+        if(*param < VTPARSE_PARAM_MAX / 10 ||
+           (*param == VTPARSE_PARAM_MAX / 10 && ch - '0' <= VTPARSE_PARAM_MAX % 10))
+            *param = *param * 10 + (ch - '0');
+        else
+            *param = VTPARSE_PARAM_MAX;
+    }
+}
+
+static void do_clear(vtparse_t *parser)
 {
     int i;
 
+    /* Only the parameters below num_params are ever set, so the rest are
+     * still clear.  That is usually none or one or two of them. */
+    for(i = 0; i < parser->num_params; i++) {
+        parser->params[i] = 0;
+    }
+
+    parser->num_intermediate_chars = 0;
+    parser->num_params            = 0;
+    parser->ignore_flagged        = 0;
+}
+
+#ifdef VTPARSE_FUSED
+
+/* The fused encoding does each state change with one trip through a
+ * generated switch, rather than do_state_change() below. */
+#ifdef VTPARSE_TABLE
+#include "vtparse_fused.h"
+#else
+#include "build/vtparse_fused.h"
+#endif
+
+#else
+
+static void do_action(vtparse_t *parser, vtparse_action_t action, char ch)
+{
     /* Some actions we handle internally (like parsing parameters), others
      * we hand to our client for processing */
 
@@ -43,52 +118,15 @@ static void do_action(vtparse_t *parser, vtparse_action_t action, char ch)
             break;
 
         case VTPARSE_ACTION_COLLECT:
-        {
-            /* Append the character to the intermediate params */
-            if(parser->num_intermediate_chars + 1 > MAX_INTERMEDIATE_CHARS)
-                parser->ignore_flagged = 1;
-            else
-                parser->intermediate_chars[parser->num_intermediate_chars++] = ch;
-
+            do_collect(parser, ch);
             break;
-        }
 
         case VTPARSE_ACTION_PARAM:
-        {
-            /* process the param character */
-            if(ch == ';')
-            {
-	        if(parser->num_params < MAX_PARAMS) {
-                    parser->num_params += 1;
-	        }
-                parser->params[parser->num_params-1] = 0;
-            }
-            else
-            {
-                /* the character is a digit */
-                int current_param;
-
-                if(parser->num_params == 0)
-                {
-                    parser->num_params = 1;
-                    parser->params[0]  = 0;
-                }
-
-                current_param = parser->num_params - 1;
-                parser->params[current_param] *= 10;
-                parser->params[current_param] += (ch - '0');
-            }
-
+            do_param(parser, ch);
             break;
-        }
 
         case VTPARSE_ACTION_CLEAR:
-            parser->num_intermediate_chars = 0;
-            parser->num_params            = 0;
-            parser->ignore_flagged        = 0;
-	    for(i = 0; i < MAX_PARAMS; i++) {
-		    parser->params[i] = 0;
-	    }
+            do_clear(parser);
             break;
 
         default:
@@ -132,14 +170,38 @@ static void do_state_change(vtparse_t *parser, state_change_t change, char ch)
     }
 }
 
+#endif
+
 void vtparse(vtparse_t *parser, unsigned char *data, int len)
 {
     int i;
     for(i = 0; i < len; i++)
     {
         unsigned char ch = data[i];
-        state_change_t change = STATE_TABLE[parser->state-1][ch];
+        state_change_t change;
+
+        /* GROUND prints VTPARSE_PRINT_FIRST to VTPARSE_PRINT_LAST without
+         * leaving, so find the end of the run and hand it over whole. */
+        if(parser->state == VTPARSE_STATE_GROUND && parser->print &&
+           ch >= VTPARSE_PRINT_FIRST && ch <= VTPARSE_PRINT_LAST)
+        {
+            int start = i;
+
+            while(i + 1 < len && data[i+1] >= VTPARSE_PRINT_FIRST &&
+                  data[i+1] <= VTPARSE_PRINT_LAST)
+                i++;
+
+            parser->print(parser, data + start, i + 1 - start);
+            continue;
+        }
+
+        change = STATE_CHANGE(parser->state, ch);
+#ifdef VTPARSE_FUSED
+        do_fused(parser, ACTION(change), ch);
+        parser->state = STATE(change);
+#else
         do_state_change(parser, change, ch);
+#endif
     }
 }
 
@@ -13,26 +13,41 @@
 extern "C" {
 #endif
 
+/* VTPARSE_TABLE picks another set of generated tables, so that encodings
+ * can be compared side by side (see the bench target in the Makefile). */
+#ifdef VTPARSE_TABLE
+#include VTPARSE_TABLE
+#else
 #include "build/vtparse_table.h"
+#endif
 
+/* ACTION() and STATE() come from vtparse_table.h, because they depend on
+ * how the generator was told to encode STATE_TABLE. */
 #define MAX_INTERMEDIATE_CHARS 2
-#define ACTION(state_change) (state_change & 0x0F)
-#define STATE(state_change)  (state_change >> 4)
 #define MAX_PARAMS 16
 
+/* Where a parameter sticks if it is given more digits than fit. */
+#define VTPARSE_PARAM_MAX 65535
+
 struct vtparse;
 
 typedef void (*vtparse_callback_t)(struct vtparse*, vtparse_action_t, unsigned char);
 
+/* Optional: if the client sets this after vtparse_init(), each run of
+ * characters that GROUND would print one at a time is handed to it in one
+ * call instead, rather than as a PRINT action per character. */
+typedef void (*vtparse_print_t)(struct vtparse*, unsigned char *, int);
+
 typedef struct vtparse {
     vtparse_state_t    state;
     vtparse_callback_t cb;
     unsigned char      intermediate_chars[MAX_INTERMEDIATE_CHARS+1];
     int                num_intermediate_chars;
     char               ignore_flagged;
-    int                params[MAX_PARAMS];
+    unsigned short     params[MAX_PARAMS];
     int                num_params;
     void*              user_data;
+    vtparse_print_t    print;
 } vtparse_t;
 
 void vtparse_init(vtparse_t *parser, vtparse_callback_t cb);
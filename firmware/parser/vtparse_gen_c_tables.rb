@@ -1,5 +1,70 @@
 
-require '../vtparse_tables'
+require_relative 'vtparse_tables'
+
+# How each entry of STATE_TABLE holds its action and new state.  They all
+# parse the same way; vtparse_test -b compares their speed.
+#
+#   nibble - one byte, the action in the low 4 bits and the state in the high 4
+#   byte   - a 16 bit word, the action in the low byte and the state in the high
+#   pair   - two bytes, the action then the state, so neither needs a shift
+#   class  - nibble entries, but rather than a row of 256 for each state,
+#            CHAR_CLASS sorts the characters into classes that every state
+#            treats alike, and STATE_TABLE has a row of 16 states for each
+#            class.  So a lookup is two loads and a shift, in a fifth of the
+#            space.
+#   fused  - classes as above, with pair entries.  The action in each entry
+#            is a code for everything the change does: the exit action of
+#            the old state, the action of the transition and the entry
+#            action of the new state.  The state is the new one, or the old
+#            one if it doesn't change, so vtparse() can always store it.  The
+#            switch that carries out each code is generated too, into
+#            vtparse_fused.h.
+$encodings = ["nibble", "byte", "pair", "class", "fused"]
+$encoding = ARGV[0] || "nibble"
+if not $encodings.include?($encoding)
+    abort "Unknown encoding #{$encoding}, expected one of #{$encodings.join(", ")}"
+end
+
+# The classes, and the class of each character.  Two characters are in the
+# same class if every state does the same thing with them.
+$columns = (0..255).map { |ch| $states_in_order.map { |state| $state_tables[state][ch] } }
+$classes = $columns.uniq
+$char_class = $columns.map { |column| $classes.index(column) }
+
+# A class's row is indexed by the state itself, which starts at 1.
+if $states_in_order.length > 15
+    abort "Too many states for the class encoding"
+end
+
+$classed = ["class", "fused"].include?($encoding)
+
+# The fused actions.  Each is the list of actions it does in order, with the
+# character the transition's own action is given.  IGNORE does nothing, and
+# an entry with no transition at all is an error, as in do_action().
+def fused(state, state_change)
+    return [[:error, "0"]] if not state_change
+
+    (action,) = state_change.find_all { |s| s.kind_of?(Symbol) }
+    (to,)     = state_change.find_all { |s| s.kind_of?(StateTransition) }
+    steps = []
+    steps << [$states[state][:on_exit], "0"] if to
+    steps << [action, "ch"]
+    steps << [$states[to.to_state][:on_entry], "0"] if to
+    steps.reject { |action, ch| action.nil? or action == :ignore }
+end
+
+def fused_name(steps)
+    "VTPARSE_DO_" + (steps.empty? ? "NOTHING" : steps.map { |action, ch| action.to_s.upcase }.join("_"))
+end
+
+$fused = {}
+$states_in_order.each { |state|
+    (0..255).each { |ch|
+        steps = fused(state, $state_tables[state][ch])
+        $fused[fused_name(steps)] = steps
+    }
+}
+$fused_in_order = $fused.keys.sort
 
 class String
     def pad(len)
@@ -7,6 +72,31 @@ class String
     end
 end
 
+# One STATE_TABLE entry, as C.
+def state_change_str(state_change)
+    return ($encoding == "pair" ? "{ 0, 0 }" : "0") if not state_change
+
+    (action,) = state_change.find_all { |s| s.kind_of?(Symbol) }
+    (state,)  = state_change.find_all { |s| s.kind_of?(StateTransition) }
+    action_str = action ? "VTPARSE_ACTION_#{action.to_s.upcase}" : "0"
+    state_str =  state ? "VTPARSE_STATE_#{state.to_state.to_s}" : "0"
+    case $encoding
+    when "nibble", "class"
+        "#{action_str.pad(33)} | (#{state_str.pad(33)} << 4)"
+    when "byte"
+        "#{action_str.pad(33)} | (#{state_str.pad(33)} << 8)"
+    when "pair"
+        "{ #{action_str.pad(33)}, #{state_str.pad(33)} }"
+    end
+end
+
+# One fused STATE_TABLE entry, as C.
+def fused_str(state, state_change)
+    to = state_change && state_change.find { |s| s.kind_of?(StateTransition) }
+    state_str = "VTPARSE_STATE_#{(to ? to.to_state : state).to_s}"
+    "{ #{fused_name(fused(state, state_change)).pad(33)}, #{state_str.pad(33)} }"
+end
+
 File.open("vtparse_table.h", "w") { |f|
     f.puts "typedef enum {"
     $states_in_order.each_with_index { |state, i|
@@ -20,10 +110,52 @@ File.open("vtparse_table.h", "w") { |f|
     }
     f.puts "} vtparse_action_t;"
     f.puts
-    f.puts "typedef unsigned char state_change_t;"
-    f.puts "extern const state_change_t STATE_TABLE[#{$states_in_order.length}][256];"
-    f.puts "extern const vtparse_action_t ENTRY_ACTIONS[#{$states_in_order.length}];"
-    f.puts "extern const vtparse_action_t EXIT_ACTIONS[#{$states_in_order.length}];"
+    if $encoding == "fused"
+        f.puts "typedef enum {"
+        $fused_in_order.each_with_index { |name, i|
+            f.puts "   #{name} = #{i},"
+        }
+        f.puts "} vtparse_fused_t;"
+        f.puts
+        f.puts "#define VTPARSE_FUSED"
+    end
+    f.puts "#define STATE_TABLE_ENCODING \"#{$encoding}\""
+    case $encoding
+    when "nibble", "class"
+        f.puts "typedef unsigned char state_change_t;"
+        f.puts "#define ACTION(state_change) ((state_change) & 0x0F)"
+        f.puts "#define STATE(state_change)  ((state_change) >> 4)"
+    when "byte"
+        f.puts "typedef unsigned short state_change_t;"
+        f.puts "#define ACTION(state_change) ((state_change) & 0xFF)"
+        f.puts "#define STATE(state_change)  ((state_change) >> 8)"
+    when "pair", "fused"
+        f.puts "typedef struct { unsigned char action, state; } state_change_t;"
+        f.puts "#define ACTION(state_change) ((state_change).action)"
+        f.puts "#define STATE(state_change)  ((state_change).state)"
+    end
+    # The characters GROUND prints without leaving, which vtparse() can
+    # hand over a run at a time.  It only checks the two ends.
+    print = (0..255).select { |i| $state_tables[:GROUND][i] == [:print] }
+    if print.empty? or print.last - print.first + 1 != print.length
+        abort "GROUND's printing characters are not one range"
+    end
+    f.puts "#define VTPARSE_PRINT_FIRST 0x#{print.first.to_s(16)}"
+    f.puts "#define VTPARSE_PRINT_LAST  0x#{print.last.to_s(16)}"
+    if $classed
+        f.puts "extern const unsigned char CHAR_CLASS[256];"
+        f.puts "extern const state_change_t STATE_TABLE[#{$classes.length}][16];"
+        f.puts "#define STATE_CHANGE(state, ch) (STATE_TABLE[CHAR_CLASS[ch]][state])"
+        f.puts "#define STATE_TABLE_BYTES (sizeof(CHAR_CLASS) + sizeof(STATE_TABLE))"
+    else
+        f.puts "extern const state_change_t STATE_TABLE[#{$states_in_order.length}][256];"
+        f.puts "#define STATE_CHANGE(state, ch) (STATE_TABLE[(state)-1][ch])"
+        f.puts "#define STATE_TABLE_BYTES (sizeof(STATE_TABLE))"
+    end
+    if $encoding != "fused"
+        f.puts "extern const vtparse_action_t ENTRY_ACTIONS[#{$states_in_order.length}];"
+        f.puts "extern const vtparse_action_t EXIT_ACTIONS[#{$states_in_order.length}];"
+    end
     f.puts "extern const char *ACTION_NAMES[#{$actions_in_order.length+1}];"
     f.puts "extern const char *STATE_NAMES[#{$states_in_order.length+1}];"
     f.puts
@@ -49,25 +181,45 @@ File.open("vtparse_table.c", "w") { |f|
     }
     f.puts "};"
     f.puts
-    f.puts "const state_change_t STATE_TABLE[#{$states_in_order.length}][256] = {"
-    $states_in_order.each_with_index { |state, i|
-        f.puts "  {  /* VTPARSE_STATE_#{state.to_s.upcase} = #{i} */"
-        $state_tables[state].each_with_index { |state_change, i|
-            if not state_change
-                f.puts "    0,"
-            else
-                (action,) = state_change.find_all { |s| s.kind_of?(Symbol) }
-                (state,)  = state_change.find_all { |s| s.kind_of?(StateTransition) }
-                action_str = action ? "VTPARSE_ACTION_#{action.to_s.upcase}" : "0"
-                state_str =  state ? "VTPARSE_STATE_#{state.to_state.to_s}" : "0"
-                f.puts "/*#{i.to_s.pad(3)}*/  #{action_str.pad(33)} | (#{state_str.pad(33)} << 4),"
-            end
+    if $classed
+        f.puts "const unsigned char CHAR_CLASS[256] = {"
+        $char_class.each_slice(16).each_with_index { |classes, i|
+            f.puts "/*0x#{(i * 16).to_s(16).rjust(2, "0")}*/  " + classes.map { |c| "#{c},".pad(4) }.join.rstrip
+        }
+        f.puts "};"
+        f.puts
+        f.puts "const state_change_t STATE_TABLE[#{$classes.length}][16] = {"
+        $classes.each_with_index { |column, i|
+            chars = (0..255).select { |ch| $char_class[ch] == i }
+            f.puts "  {  /* class #{i}: 0x#{chars.first.to_s(16)}#{chars.length > 1 ? "..0x#{chars.last.to_s(16)}" : ""}, #{chars.length} character#{chars.length > 1 ? "s" : ""} */"
+            f.puts($encoding == "fused" ? "    { 0, 0 }," : "    0,")
+            $states_in_order.each_with_index { |state, j|
+                entry = $encoding == "fused" ? fused_str(state, column[j]) : state_change_str(column[j])
+                f.puts "/*#{state.to_s.pad(19)}*/  #{entry},"
+            }
+            f.puts "  },"
+        }
+        f.puts "};"
+        f.puts
+    else
+        f.puts "const state_change_t STATE_TABLE[#{$states_in_order.length}][256] = {"
+        $states_in_order.each_with_index { |state, i|
+            f.puts "  {  /* VTPARSE_STATE_#{state.to_s.upcase} = #{i} */"
+            $state_tables[state].each_with_index { |state_change, i|
+                if not state_change
+                    f.puts($encoding == "pair" ? "    { 0, 0 }," : "    0,")
+                else
+                    f.puts "/*#{i.to_s.pad(3)}*/  #{state_change_str(state_change)},"
+                end
+            }
+            f.puts "  },"
         }
-        f.puts "  },"
-    }
 
-    f.puts "};"
-    f.puts
+        f.puts "};"
+        f.puts
+    end
+    next if $encoding == "fused"
+
     f.puts "const vtparse_action_t ENTRY_ACTIONS[] = {"
     $states_in_order.each { |state|
         actions = $states[state]
@@ -94,3 +246,30 @@ File.open("vtparse_table.c", "w") { |f|
 
 puts "Wrote vtparse_table.c"
 
+# The switch for the fused actions, which vtparse.c includes after the
+# helpers it calls.  The other encodings leave it empty.
+File.open("vtparse_fused.h", "w") { |f|
+    next if $encoding != "fused"
+
+    f.puts "static void do_fused(vtparse_t *parser, vtparse_fused_t fused, unsigned char ch)"
+    f.puts "{"
+    f.puts "    switch(fused) {"
+    $fused_in_order.each { |name|
+        f.puts "        case #{name}:"
+        $fused[name].each { |action, ch|
+            case action
+            when :clear
+                f.puts "            do_clear(parser);"
+            when :collect, :param
+                f.puts "            do_#{action}(parser, #{ch});"
+            else
+                f.puts "            parser->cb(parser, VTPARSE_ACTION_#{action.to_s.upcase}, #{ch});"
+            end
+        }
+        f.puts "            break;"
+    }
+    f.puts "    }"
+    f.puts "}"
+}
+
+puts "Wrote vtparse_fused.h"
@@ -6,10 +6,31 @@
  * This code is in the public domain.
  */
 
+/*
+ * With no arguments, print the actions for whatever arrives on stdin.
+ *
+ * With -b, time vtparse() alone over the files given, with a callback that
+ * only counts the actions, so the number is the parser's and not the
+ * screen's.  Each file is parsed over and over until at least -m megabytes
+ * have gone through, and the result is in host nanoseconds per byte.  Build
+ * it once for each STATE_TABLE encoding to compare them ("make bench").
+ * Printing characters are counted a run at a time, as the firmware takes
+ * them, unless -1 asks for them one at a time.
+ */
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
+
+#include <sys/stat.h>
+
 #include "vtparse.h"
 
+#define NUM_ACTIONS (sizeof(ACTION_NAMES) / sizeof(ACTION_NAMES[0]))
+
+static long action_counts[NUM_ACTIONS];
+
 void parser_callback(vtparse_t *parser, vtparse_action_t action, unsigned char ch)
 {
     int i;
@@ -33,11 +54,148 @@ void parser_callback(vtparse_t *parser, vtparse_action_t action, unsigned char c
     printf("\n");
 }
 
-int main()
+void counting_callback(vtparse_t *parser, vtparse_action_t action, unsigned char ch)
+{
+    action_counts[action]++;
+}
+
+void counting_print(vtparse_t *parser, unsigned char *run, int len)
+{
+    action_counts[VTPARSE_ACTION_PRINT] += len;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1E9 + ts.tv_nsec;
+}
+
+static unsigned char *load(char *file, long *len)
+{
+    FILE *fp;
+    struct stat statbuf;
+    unsigned char *data;
+
+    if((fp = fopen(file, "r")) == NULL || fstat(fileno(fp), &statbuf) == -1)
+    {
+        fprintf(stderr, "Cannot open %s\n", file);
+        exit(1);
+    }
+
+    if((data = malloc(statbuf.st_size + 1)) == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    if(fread(data, 1, statbuf.st_size, fp) != statbuf.st_size)
+    {
+        fprintf(stderr, "Cannot read %s\n", file);
+        exit(1);
+    }
+    fclose(fp);
+
+    *len = statbuf.st_size;
+    return data;
+}
+
+/* Returns the nanoseconds spent. */
+static double bench(char *file, long min_bytes, int runs, long *total)
+{
+    vtparse_t parser;
+    unsigned char *data;
+    long len;
+    long done = 0;
+    double t0;
+    double t1;
+
+    data = load(file, &len);
+    if(len == 0)
+    {
+        free(data);
+        return 0;
+    }
+
+    vtparse_init(&parser, counting_callback);
+    if(runs)
+        parser.print = counting_print;
+
+    t0 = now_ns();
+    do {
+        vtparse(&parser, data, len);
+        done += len;
+    } while(done < min_bytes);
+    t1 = now_ns();
+
+    printf("  %-24s %10ld bytes %8.2f ns/byte\n", file, done, (t1 - t0) / done);
+
+    free(data);
+    *total += done;
+    return t1 - t0;
+}
+
+static void usage(char *name)
+{
+    fprintf(stderr, "Usage: %s [-b [-m megabytes] [-1] file ...]\n", name);
+    fprintf(stderr, "\t-b = time the parser over the files, rather than printing stdin's actions\n");
+    fprintf(stderr, "\t-m = parse each file until this many megabytes have gone through (default 16)\n");
+    fprintf(stderr, "\t-1 = hand out printing characters one at a time, rather than in runs\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
 {
     unsigned char buf[1024];
     int bytes;
     vtparse_t parser;
+    int opt;
+    int benchmark = 0;
+    int runs = 1;
+    long min_bytes = 16L << 20;
+    long total = 0;
+    double ns = 0;
+    int i;
+
+    while((opt = getopt(argc, argv, "bm:1")) != -1)
+    {
+        switch(opt)
+        {
+            case 'b':
+                benchmark = 1;
+                break;
+            case 'm':
+                min_bytes = atol(optarg) << 20;
+                break;
+            case '1':
+                runs = 0;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(benchmark)
+    {
+        if(optind >= argc)
+            usage(argv[0]);
+
+        printf("STATE_TABLE encoding %s, %d bytes, printing %s\n", STATE_TABLE_ENCODING,
+               (int)STATE_TABLE_BYTES, runs ? "in runs" : "one at a time");
+        for(; optind < argc; optind++)
+            ns += bench(argv[optind], min_bytes, runs, &total);
+
+        printf("  %-24s %10ld bytes %8.2f ns/byte\n", "all", total, total ? ns / total : 0);
+        printf("  actions:");
+        for(i = 1; i < NUM_ACTIONS; i++)
+            if(action_counts[i])
+                printf(" %s %ld", ACTION_NAMES[i], action_counts[i]);
+        printf("\n");
+
+        return 0;
+    }
 
     vtparse_init(&parser, parser_callback);
 
@@ -48,4 +206,3 @@ int main()
 
     return 0;
 }
-
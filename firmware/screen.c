@@ -28,7 +28,11 @@
 #include "parser/vtparse.h"
 #include "build/version.h"
 
-// Dual-ported video memory - 1920 shorts.
+// Dual-ported video memory - 1920 shorts.  The host build (see host/)
+// supplies its own frame memory in place of the hardware address.
+#ifndef screen_base_address
+#define screen_base_address	(0x8000)
+#endif
 #define screen_cols		(80)					// Number of columns
 #define screen_lines		(24)					// Number of lines
 #define screen_length		(screen_cols * screen_lines)		// Length of whole screen
@@ -55,7 +59,7 @@
 
 static vtparse_t		screen_parser;		// Parses all received uart characters
 
-static volatile uint16_t	*screen_base = (volatile uint16_t *)(0x8000);
+static volatile uint16_t	*screen_base = (volatile uint16_t *)(screen_base_address);
 
 static volatile uint16_t	*screen_cursor_location;	// Pointer into video memory.
 static volatile uint16_t	*screen_cursor_location_save;	// A place to save the cursor for ESC-7 and ESC-8
@@ -68,10 +72,13 @@ static uint8_t	screen_dec_bottom_margin;	// Prevent scrolling below the bottom m
 static uint8_t	screen_origin_mode;		// Absolute (0) or Relative (1)
 static uint8_t	screen_autowrap_mode;		// 1 = autowrap, 0 = no autowrap
 
+// Every escape sequence handler takes the parser and the final character.
+typedef void (*screen_sequence_t)(vtparse_t *parser, uint8_t c);
+
 // Forward references:
 static void screen_announce();
-static void screen_save_cursor_position();
-static void screen_restore_cursor_position();
+static void screen_save_cursor_position(vtparse_t *parser, uint8_t c);
+static void screen_restore_cursor_position(vtparse_t *parser, uint8_t c);
 static int screen_cursor_in_line();
 static int screen_cursor_in_column();
 static volatile uint16_t *screen_cursor_start_of_line();
@@ -79,32 +86,36 @@ static void screen_scroll_up();
 static void screen_scroll_down();
 static void screen_handle_lf();
 static void screen_handle_cr();
-static void screen_handle_esc_lf();
-static void screen_handle_esc_cr_lf();
-static void screen_handle_reverse_scroll();
+static void screen_handle_esc_lf(vtparse_t *parser, uint8_t c);
+static void screen_handle_esc_cr_lf(vtparse_t *parser, uint8_t c);
+static void screen_handle_reverse_scroll(vtparse_t *parser, uint8_t c);
 static void screen_handle_bs();
 static void screen_handle_ht();
-static void screen_send_primary_device_attributes();
-static void screen_move_cursor_numeric(vtparse_t *parser);
-static void screen_set_margins(vtparse_t *parser);
-static void screen_num_to_uart(int n);
-static void screen_report(vtparse_t *parser);
-static void screen_move_cursor_up(vtparse_t *parser);
-static void screen_move_cursor_down(vtparse_t *parser);
-static void screen_move_cursor_right(vtparse_t *parser);
-static void screen_move_cursor_left(vtparse_t *parser);
-static void screen_clear_rows(vtparse_t *parser);
-static void screen_clear_columns(vtparse_t *parser);
-static void screen_escape_in_sharp(uint8_t c);
+static void screen_send_primary_device_attributes(vtparse_t *parser, uint8_t c);
+static void screen_move_cursor_numeric(vtparse_t *parser, uint8_t c);
+static void screen_set_margins(vtparse_t *parser, uint8_t c);
+static void screen_num_to_uart(uint32_t n);
+static void screen_report(vtparse_t *parser, uint8_t c);
+static void screen_private_report(vtparse_t *parser, uint8_t c);
+static void screen_move_cursor_up(vtparse_t *parser, uint8_t c);
+static void screen_move_cursor_down(vtparse_t *parser, uint8_t c);
+static void screen_move_cursor_right(vtparse_t *parser, uint8_t c);
+static void screen_move_cursor_left(vtparse_t *parser, uint8_t c);
+static void screen_clear_rows(vtparse_t *parser, uint8_t c);
+static void screen_clear_columns(vtparse_t *parser, uint8_t c);
 static void screen_normal_char(uint8_t c);
+static void screen_print_run(vtparse_t *parser, unsigned char *run, int len);
 static void screen_control_char(uint8_t c);
-static void screen_simple_escape(uint8_t c);
-static void screen_parse_ansi_csi_command(vtparse_t *parser, uint8_t c);
-static void screen_parse_dec_csi_command(vtparse_t *parser, uint8_t c);
-static void screen_csi_escape(vtparse_t *parser, uint8_t c);
-static void screen_non_csi_escape(vtparse_t *parser, uint8_t c);
+static void screen_set_dec_mode(vtparse_t *parser, uint8_t c);
+static void screen_reset(vtparse_t *parser, uint8_t c);
+static void screen_alignment_display(vtparse_t *parser, uint8_t c);
+static void screen_sequence(vtparse_t *parser, int kind, uint8_t c);
 static void screen_parser_callback(vtparse_t *parser, vtparse_action_t action, unsigned char c);
 
+// The handlers for escape sequences, and the tables screen_sequence() finds
+// them with, which screen_dispatch.rb generates.
+#include "build/screen_dispatch.h"
+
 // Announce our information on the screen - only for cold-start.
 static void
 screen_announce()
@@ -175,18 +186,19 @@ screen_initialize(int cold)
 
 	// Set up the parser.
 	vtparse_init(&screen_parser, screen_parser_callback);
+	screen_parser.print = screen_print_run;
 }
 
 // screen_save_cursor_position - esc-7
 static void
-screen_save_cursor_position()
+screen_save_cursor_position(vtparse_t *parser, uint8_t c)
 {
 	screen_cursor_location_save = screen_cursor_location;
 }
 
 // screen_restore_cursor_position - esc-8
 static void
-screen_restore_cursor_position()
+screen_restore_cursor_position(vtparse_t *parser, uint8_t c)
 {
 	// Remove the old cursor.
 	*screen_cursor_location &= ~null_cursor;
@@ -391,7 +403,7 @@ screen_handle_cr()
 
 // screen_handle_esc_lf - ESC D
 static void
-screen_handle_esc_lf()
+screen_handle_esc_lf(vtparse_t *parser, uint8_t c)
 {
 	//This seems to be like <LF>
 	screen_handle_lf();
@@ -399,7 +411,7 @@ screen_handle_esc_lf()
 
 // screen_handle_esc_cr_lf - ESC E
 static void
-screen_handle_esc_cr_lf()
+screen_handle_esc_cr_lf(vtparse_t *parser, uint8_t c)
 {
 	// This seems to be like <CR><LF>
 	screen_handle_cr();
@@ -408,7 +420,7 @@ screen_handle_esc_cr_lf()
 
 // screen_handle_reverse_scroll - ESC M
 static void
-screen_handle_reverse_scroll()
+screen_handle_reverse_scroll(vtparse_t *parser, uint8_t c)
 {
 	volatile uint16_t *proposed_new_position;
 
@@ -429,64 +441,9 @@ screen_handle_reverse_scroll()
 	*screen_cursor_location |= null_cursor;
 }
 
-// screen_parse_ansi_csi_command
+// screen_set_dec_mode - ESC [ ? h or ESC [ ? l
 static void
-screen_parse_ansi_csi_command(vtparse_t *parser, uint8_t c)
-{
-	switch(c) {
-		case 'c': // DA
-			screen_send_primary_device_attributes();
-			break;
-
-		case 'f': // HVP
-			screen_move_cursor_numeric(parser);
-			break;
-
-		case 'n':
-			screen_report(parser);
-			break;
-
-		case 'r': // DECSTBM
-			screen_set_margins(parser);
-			break;
-
-		case 'A': // CUU
-			screen_move_cursor_up(parser);
-			break;
-
-		case 'B': // CUD
-			screen_move_cursor_down(parser);
-			break;
-
-		case 'C': // CUF
-			screen_move_cursor_right(parser);
-			break;
-
-		case 'D': // CUB
-			screen_move_cursor_left(parser);
-			break;
-
-		case 'H': // CUP
-			screen_move_cursor_numeric(parser);
-			break;
-
-		case 'J': // ED
-			screen_clear_rows(parser);
-			break;
-
-		case 'K': // EL
-			screen_clear_columns(parser);
-			break;
-
-		default:
-			// This is not a sequence we handle.
-			break;
-	}
-}
-
-// screen_parse_dec_csi_command
-static void
-screen_parse_dec_csi_command(vtparse_t *parser, uint8_t c)
+screen_set_dec_mode(vtparse_t *parser, uint8_t c)
 {
 	// We don't handle most of these, but DECCOLM has the side-effect of
 	// reinitializing the screen, and we need that to pass vttest.
@@ -604,7 +561,7 @@ screen_handle_ht()
 
 // screen_send_primary_device_attributes Esc [ c
 static void
-screen_send_primary_device_attributes()
+screen_send_primary_device_attributes(vtparse_t *parser, uint8_t c)
 {
 	// This is a request for our attributes.  Claim that we are a VT100.
 	uart_transmit_string("[?1;0c", UART_WAIT);
@@ -612,7 +569,7 @@ screen_send_primary_device_attributes()
 
 // screen_move_cursor_numeric - ESC [ H or ESC [ f
 static void
-screen_move_cursor_numeric(vtparse_t *parser)
+screen_move_cursor_numeric(vtparse_t *parser, uint8_t c)
 {
 	int digits0 = parser->params[0];
 	int digits1 = parser->params[1];
@@ -672,11 +629,11 @@ screen_move_cursor_numeric(vtparse_t *parser)
 }
 
 // Send a number out the uart as a base-10 string.
-// We use this for position reports, so we don't
-// need much range.
-#define NUM_PLACES 3
+// We use this for position reports and the receive
+// statistics, so it has to cover 32 bits.
+#define NUM_PLACES 10
 static void
-screen_num_to_uart(int n)
+screen_num_to_uart(uint32_t n)
 {
 	int i;
 	int suppress;
@@ -713,9 +670,51 @@ screen_num_to_uart(int n)
 	}
 }
 
+// screen_private_report - ESC [ ? n
+//
+// 900 reports the receive statistics (see UART_STATS), as
+// ESC [ ? 900 ; overruns ; parity ; framing ; dropped ; pauses ; peak n
+// and 901 does the same, then clears them.
+static void
+screen_private_report(vtparse_t *parser, uint8_t c)
+{
+	// We need exactly one parameter, in order to process this.
+	if(parser->num_params != 1) {
+		return;
+	}
+
+	switch(parser->params[0]) {
+		case 900: // Receive statistics.
+		case 901: // Receive statistics, then clear them.
+			uart_transmit_string("[?", UART_WAIT);
+			screen_num_to_uart(parser->params[0]);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.overruns);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.parity);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.framing);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.dropped);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.pauses);
+			uart_transmit(';', UART_WAIT);
+			screen_num_to_uart(uart_stats.peak);
+			uart_transmit('n', UART_WAIT);
+
+			if(parser->params[0] == 901) {
+				uart_clear_stats();
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
 // screen_report - ESC [ n
 static void
-screen_report(vtparse_t *parser)
+screen_report(vtparse_t *parser, uint8_t c)
 {
 	int line = screen_cursor_in_line() + 1;
 	int column = screen_cursor_in_column() + 1;
@@ -738,7 +737,7 @@ screen_report(vtparse_t *parser)
 
 // screen_set_margins - ESC [ r
 static void
-screen_set_margins(vtparse_t *parser)
+screen_set_margins(vtparse_t *parser, uint8_t c)
 {
 	int digits0 = parser->params[0];
 	int digits1 = parser->params[1];
@@ -799,7 +798,7 @@ screen_set_margins(vtparse_t *parser)
 
 // screen_move_cursor_up - ESC [ A
 static void
-screen_move_cursor_up(vtparse_t *parser)
+screen_move_cursor_up(vtparse_t *parser, uint8_t c)
 {
 	int i;
 	int to_move = parser->params[0];
@@ -838,7 +837,7 @@ screen_move_cursor_up(vtparse_t *parser)
 
 // screen_move_cursor_down - ESC [ B
 static void
-screen_move_cursor_down(vtparse_t *parser)
+screen_move_cursor_down(vtparse_t *parser, uint8_t c)
 {
 	int i;
 	int to_move = parser->params[0];
@@ -877,7 +876,7 @@ screen_move_cursor_down(vtparse_t *parser)
 
 // screen_move_cursor_right - ESC [ C
 static void
-screen_move_cursor_right(vtparse_t *parser)
+screen_move_cursor_right(vtparse_t *parser, uint8_t c)
 {
 	int to_move = parser->params[0];
 	volatile uint16_t *start_of_line;
@@ -911,7 +910,7 @@ screen_move_cursor_right(vtparse_t *parser)
 
 // screen_move_cursor_left - ESC [ D
 static void
-screen_move_cursor_left(vtparse_t *parser)
+screen_move_cursor_left(vtparse_t *parser, uint8_t c)
 {
 	int to_move = parser->params[0];
 	volatile uint16_t *start_of_line;
@@ -943,7 +942,7 @@ screen_move_cursor_left(vtparse_t *parser)
 
 // screen_clear_rows - ESC [ J
 static void
-screen_clear_rows(vtparse_t *parser)
+screen_clear_rows(vtparse_t *parser, uint8_t c)
 {
 	volatile uint16_t *p;
 
@@ -984,7 +983,7 @@ screen_clear_rows(vtparse_t *parser)
 
 // screen_clear_columns - ESC [ K
 static void
-screen_clear_columns(vtparse_t *parser)
+screen_clear_columns(vtparse_t *parser, uint8_t c)
 {
 	volatile uint16_t *p;
 	volatile uint16_t *line_start;
@@ -1025,31 +1024,22 @@ screen_clear_columns(vtparse_t *parser)
 	*screen_cursor_location |= null_cursor;
 }
 
-// screen_escape_in_sharp - got the first char after ESC #
+// screen_alignment_display - ESC # 8
 static void
-screen_escape_in_sharp(uint8_t c)
+screen_alignment_display(vtparse_t *parser, uint8_t c)
 {
 	volatile uint16_t *p;
 	int i;
 
-	switch(c) {
-		case '8': // DECALN
-			// Fill the screen with the letter 'E'.
-			p = screen_base;
-			for(i = 0; i < screen_length; i++) {
-				*p++ = 'E';
-			}
-
-			// Initialize the cursor pointer.
-			screen_cursor_location = screen_base;
-			*screen_cursor_location |= null_cursor;
-			break;
-
-		default:
-			break;
+	// Fill the screen with the letter 'E'.
+	p = screen_base;
+	for(i = 0; i < screen_length; i++) {
+		*p++ = 'E';
 	}
 
-	return;
+	// Initialize the cursor pointer.
+	screen_cursor_location = screen_base;
+	*screen_cursor_location |= null_cursor;
 }
 
 // screen_normal_char - handle a normal printing character.
@@ -1122,20 +1112,59 @@ screen_normal_char(uint8_t c)
 	return;
 }
 
+// screen_print_run - handle a run of normal printing characters.
+//
+// The parser hands us everything it would print between one control or
+// escape and the next.  Whatever fits before column 79 of the cursor's line
+// goes straight into video memory, and the cursor is lit once at the end.
+// screen_normal_char() deals with column 79 and wrapping, a character at a
+// time.
+static void
+screen_print_run(vtparse_t *parser, unsigned char *run, int len)
+{
+	volatile uint16_t *p;
+	volatile uint16_t *end;
+
+	while(len > 0) {
+		if(!screen_col79_flag) {
+			p = screen_cursor_location;
+			end = screen_cursor_start_of_line() + (screen_cols - 1);
+			if(p < end) {
+				if(end - p > len) {
+					end = p + len;
+				}
+				len -= end - p;
+
+				// Each character overwrites the cursor as it goes.
+				while(p < end) {
+					*p++ = *run++;
+				}
+
+				// Make the new position a cursor.
+				screen_cursor_location = p;
+				*p |= null_cursor;
+				continue;
+			}
+		}
+
+		screen_normal_char(*run++);
+		len--;
+	}
+}
+
 // screen_handler - read from the uart and update the screen
+//
+// We hand vtparse() everything the uart has waiting in one go, or as much
+// as is contiguous in its buffer, rather than a character at a time.
 void
 screen_handler()
 {
-	int rv;
-	unsigned char c;
-
-	if((rv = uart_receive()) != -1) {
-		// We process one character at a time.
-		c = rv & 0xff;
-		if(c >= 0xa0) {
-			c -= 0x80;
-		}
-		vtparse(&screen_parser, &c, 1);
+	uint8_t *pData;
+	int n;
+
+	if((n = uart_receive_span(&pData)) != 0) {
+		vtparse(&screen_parser, pData, n);
+		uart_receive_done(n);
 	}
 
 	return;
@@ -1181,85 +1210,45 @@ screen_control_char(uint8_t c)
 	}
 }
 
+// screen_reset - ESC c
 static void
-screen_simple_escape(uint8_t c)
+screen_reset(vtparse_t *parser, uint8_t c)
 {
-	switch(c) {
-		case '7': // DECSC
-			screen_save_cursor_position();
-			break;
-
-		case '8': // DECRC
-			screen_restore_cursor_position();
-			break;
-
-		case 'D': // IND
-			screen_handle_esc_lf();
-			break;
-
-		case 'E': // NEL
-			screen_handle_esc_cr_lf();
-			break;
-
-		case 'M': // RI
-			screen_handle_reverse_scroll();
-			break;
-
-		case 'c': // RIS
-			screen_initialize(1);
-			break;
-
-		default:
-			// No idea what to do with this case.
-			break;
-	}
+	screen_initialize(1);
 }
 
+// screen_sequence - handle a CSI or ESC sequence.
+//
+// The sequence's kind and intermediate character, if any, pick a row of
+// screen_dispatch, and its final character picks the handler from that.
+// Anything that isn't in screen_dispatch.rb finds no handler.
 static void
-screen_csi_escape(vtparse_t *parser, uint8_t c)
+screen_sequence(vtparse_t *parser, int kind, uint8_t c)
 {
-	// The only intermediate character we expect here is '?'.
+	int class;
+	screen_sequence_t handler;
+
 	switch(parser->num_intermediate_chars) {
 		case 0:
-			// These are ANSI escapes.
-			screen_parse_ansi_csi_command(parser, c);
+			class = screen_plain_class[kind];
 			break;
 
 		case 1:
-			// Handle a DEC private '?' sequence.  Ignore other
-			// intermediate characters.
-			if(parser->intermediate_chars[0] == '?') {
-				screen_parse_dec_csi_command(parser, c);
-			}
+			class = screen_intermediate_class[kind][parser->intermediate_chars[0] & SCREEN_INTERMEDIATE_MASK];
 			break;
 
 		default:
 			// No idea what to do with this case.
-			break;
+			return;
 	}
-}
 
-static void
-screen_non_csi_escape(vtparse_t *parser, uint8_t c)
-{
-	// The only intermediate character we expect here is '#'.
-	switch(parser->num_intermediate_chars) {
-		case 0:
-			// These are generally single-character escapes.
-			screen_simple_escape(c);
-			break;
-
-		case 1:
-			// Handle a sharp sequence.  Ignore other
-			// intermediate characters.
-			if(parser->intermediate_chars[0] == '#') {
-				screen_escape_in_sharp(c);
-			}
-			break;
+	if(class == SCREEN_NO_CLASS || c < SCREEN_FINAL_FIRST || c > SCREEN_FINAL_LAST) {
+		return;
+	}
 
-		default:
-			// No idea what to do with this case.
-			break;
+	handler = screen_sequences[screen_dispatch[class][c - SCREEN_FINAL_FIRST]];
+	if(handler) {
+		handler(parser, c);
 	}
 }
 
@@ -1285,12 +1274,12 @@ screen_parser_callback(
 
 		case VTPARSE_ACTION_CSI_DISPATCH:
 			// This is an escape sequence of the CSI type.
-			screen_csi_escape(parser, c);
+			screen_sequence(parser, SCREEN_CSI, c);
 			break;
 
 		case VTPARSE_ACTION_ESC_DISPATCH:
 			// This is a non-CSI escape sequence.
-			screen_non_csi_escape(parser, c);
+			screen_sequence(parser, SCREEN_ESC, c);
 			break;
 
 		case VTPARSE_ACTION_HOOK:
@@ -0,0 +1,155 @@
+# ANSI Terminal
+#
+# (c) 2021 Steven A. Falco
+#
+# ANSI Terminal is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# ANSI Terminal is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+# The escape sequences screen.c handles, and the function that handles each.
+# This writes the tables screen_sequence() in screen.c dispatches through:
+#
+# $ ruby screen_dispatch.rb build/screen_dispatch.h
+#
+# A sequence is found by its kind (CSI or ESC), its intermediate character,
+# if any, and its final character.  Each kind and intermediate that some
+# sequence uses is a class, with a row of handler numbers indexed by the
+# final character, and the numbers index a list of the handlers.  So adding
+# a sequence is adding a line here, and finding it costs the same however
+# many there are.  Every handler takes the parser and the final character.
+
+$sequences = [
+    # kind  intermediate  final  handler                                  name
+    [:csi,  "",           "A",   :screen_move_cursor_up,                  "CUU"],
+    [:csi,  "",           "B",   :screen_move_cursor_down,                "CUD"],
+    [:csi,  "",           "C",   :screen_move_cursor_right,               "CUF"],
+    [:csi,  "",           "D",   :screen_move_cursor_left,                "CUB"],
+    [:csi,  "",           "H",   :screen_move_cursor_numeric,             "CUP"],
+    [:csi,  "",           "J",   :screen_clear_rows,                      "ED"],
+    [:csi,  "",           "K",   :screen_clear_columns,                   "EL"],
+    [:csi,  "",           "c",   :screen_send_primary_device_attributes,  "DA"],
+    [:csi,  "",           "f",   :screen_move_cursor_numeric,             "HVP"],
+    [:csi,  "",           "n",   :screen_report,                          "DSR"],
+    [:csi,  "",           "r",   :screen_set_margins,                     "DECSTBM"],
+    [:csi,  "?",          "h",   :screen_set_dec_mode,                    "DECSET"],
+    [:csi,  "?",          "l",   :screen_set_dec_mode,                    "DECRST"],
+    [:csi,  "?",          "n",   :screen_private_report,                  "DSR"],
+    [:esc,  "",           "7",   :screen_save_cursor_position,            "DECSC"],
+    [:esc,  "",           "8",   :screen_restore_cursor_position,         "DECRC"],
+    [:esc,  "",           "D",   :screen_handle_esc_lf,                   "IND"],
+    [:esc,  "",           "E",   :screen_handle_esc_cr_lf,                "NEL"],
+    [:esc,  "",           "M",   :screen_handle_reverse_scroll,           "RI"],
+    [:esc,  "",           "c",   :screen_reset,                           "RIS"],
+    [:esc,  "#",          "8",   :screen_alignment_display,               "DECALN"],
+]
+
+$kinds = [:csi, :esc]
+
+# Final characters run from 0x30 (ESC 7) to 0x7e; CSI finals start at 0x40.
+$final_first = 0x30
+$final_last = 0x7e
+
+# Intermediates, and the private markers that share their slot in the
+# parser, are 0x20-0x2f and 0x3c-0x3f, so the low five bits tell them apart.
+$intermediate_mask = 0x1f
+
+# No class for this kind and intermediate.
+$no_class = 0xff
+
+$sequences.each { |kind, intermediate, final, handler, name|
+    ch = final.ord
+    if ch < $final_first or ch > $final_last
+        abort "#{name}: final character #{final} is out of range"
+    end
+    if intermediate.length > 1
+        abort "#{name}: only one intermediate character is supported"
+    end
+}
+
+# Index 0 is no handler.
+$handlers = [nil] + $sequences.map { |s| s[3] }.uniq
+$classes = $sequences.map { |s| [s[0], s[1]] }.uniq.sort_by { |kind, intermediate|
+    [$kinds.index(kind), intermediate]
+}
+
+if $handlers.length > 256 or $classes.length >= $no_class
+    abort "Too many handlers or classes"
+end
+
+def class_of(kind, intermediate)
+    $classes.index([kind, intermediate]) || $no_class
+end
+
+def hex(n)
+    "0x#{n.to_s(16).rjust(2, "0")}"
+end
+
+out = ARGV[0] or abort "Usage: ruby screen_dispatch.rb output.h"
+
+File.open(out, "w") { |f|
+    f.puts "// Generated by screen_dispatch.rb from its list of sequences."
+    f.puts
+    $kinds.each_with_index { |kind, i|
+        f.puts "#define SCREEN_#{kind.to_s.upcase}\t\t\t(#{i})"
+    }
+    f.puts "#define SCREEN_FINAL_FIRST\t\t(#{hex($final_first)})"
+    f.puts "#define SCREEN_FINAL_LAST\t\t(#{hex($final_last)})"
+    f.puts "#define SCREEN_INTERMEDIATE_MASK\t(#{hex($intermediate_mask)})"
+    f.puts "#define SCREEN_NO_CLASS\t\t\t(#{hex($no_class)})"
+    f.puts
+    f.puts "// The handlers.  0 is none."
+    f.puts "static const screen_sequence_t screen_sequences[] = {"
+    f.puts "\t0,"
+    $handlers[1..-1].each { |handler|
+        names = $sequences.find_all { |s| s[3] == handler }.map { |s| s[4] }.uniq
+        f.puts "\t#{handler},".ljust(48) + "// #{names.join(", ")}"
+    }
+    f.puts "};"
+    f.puts
+    f.puts "// The class of a sequence with no intermediate, by kind."
+    f.puts "static const uint8_t screen_plain_class[] = {"
+    $kinds.each { |kind|
+        f.puts "\t#{hex(class_of(kind, ""))},".ljust(16) + "// #{kind.to_s.upcase}"
+    }
+    f.puts "};"
+    f.puts
+    f.puts "// The class of a sequence with one intermediate, by kind and by the"
+    f.puts "// intermediate's low five bits."
+    f.puts "static const uint8_t screen_intermediate_class[][#{$intermediate_mask + 1}] = {"
+    $kinds.each { |kind|
+        row = (0..$intermediate_mask).map { |low|
+            chars = ((0x20..0x2f).to_a + (0x3c..0x3f).to_a).find_all { |ch| ch & $intermediate_mask == low }
+            chars.map { |ch| class_of(kind, ch.chr) }.min || $no_class
+        }
+        f.puts "\t{ // #{kind.to_s.upcase}"
+        row.each_slice(8) { |slice|
+            f.puts "\t\t" + slice.map { |c| "#{hex(c)}," }.join(" ")
+        }
+        f.puts "\t},"
+    }
+    f.puts "};"
+    f.puts
+    f.puts "// The handler number, by class and by final character."
+    f.puts "static const uint8_t screen_dispatch[][#{$final_last - $final_first + 1}] = {"
+    $classes.each { |kind, intermediate|
+        f.puts "\t{ // #{kind.to_s.upcase}#{intermediate.empty? ? "" : " " + intermediate}"
+        ($final_first..$final_last).each_slice(16) { |finals|
+            numbers = finals.map { |ch|
+                s = $sequences.find { |s| s[0] == kind and s[1] == intermediate and s[2].ord == ch }
+                s ? $handlers.index(s[3]) : 0
+            }
+            f.puts "\t\t/*#{hex(finals.first)}*/ " + numbers.map { |n| "#{n}," }.join(" ")
+        }
+        f.puts "\t},"
+    }
+    f.puts "};"
+}
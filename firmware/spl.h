@@ -29,6 +29,30 @@
 #define spl1()		_spl(0x2100)	// Supervisor mode | mask 1
 #define spl0()		_spl(0x2000)	// Supervisor mode | mask 0
 
+#ifdef HOST_BUILD
+
+// The host build (see host/) has no interrupts to mask, so the spl
+// functions just pass the level through.
+static inline uint16_t
+_spl(uint16_t s)
+{
+	return 0x2000;
+}
+
+static inline void
+splx(uint16_t s)
+{
+}
+
+static inline void
+barrier()
+{
+}
+
+#else // HOST_BUILD
+
+#include "ipl_stats.h"
+
 // Change the current interrupt level, and return the previous level.
 //
 // Since asm statements are not used that frequently, here are the details
@@ -62,6 +86,12 @@ _spl(uint16_t s)
 
 	asm volatile (" mov.w %%sr,%0; mov.w %1,%%sr" : "=&d" (sr) : "di" (s) : "cc", "memory");
 
+#ifdef IPL_STATS
+	if(!(sr & 0x0700) && (s & 0x0700)) {
+		ipl_stats_raise();
+	}
+#endif
+
 	return sr;
 }
 
@@ -77,7 +107,26 @@ _spl(uint16_t s)
 static inline void
 splx(uint16_t s)
 {
+#ifdef IPL_STATS
+	if(!(s & 0x0700)) {
+		ipl_stats_lower();
+	}
+#endif
+
 	asm volatile (" mov.w %0,%%sr" :: "di" (s) : "cc", "memory");
 }
 
+// Keep the compiler from moving memory accesses across this point.  The
+// receive rings need it, because they are shared with interrupt service
+// routines without masking interrupts: a slot must be read before the
+// output index that gives it back to the interrupt service routine is
+// written.  The 68000 itself never reorders.
+static inline void
+barrier()
+{
+	asm volatile ("" ::: "memory");
+}
+
+#endif // HOST_BUILD
+
 #endif // _SPL_H_
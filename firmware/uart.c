@@ -16,9 +16,14 @@
 // along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
 
 // UART driver.  We respond to UART receiver interrupts, and store the
-// characters in a circular buffer.  If our circular buffer becomes too
+// characters in a circular buffer.  Characters to send go in another
+// circular buffer, which the same interrupt service routine empties into
+// the transmit FIFO whenever it runs dry.  If our circular buffer becomes too
 // full, we deassert the RTS signal to stop the sender (assuming the
-// sender supports hardware flow control).
+// sender supports hardware flow control), or send XOFF.  Once it has
+// drained to the low water mark, rather than all the way to empty, we let
+// the sender go again, so that new characters are arriving before we run
+// out.
 //
 // 2.11bsd as implemented via Sytse's FPGA runs the console at 9600
 // baud, and we can keep up with that, even without flow control.  That
@@ -44,6 +49,22 @@
 #define uart_DLL		(*(volatile uint8_t *)(uart_base + 0x00))	// Divisor Latch Low Byte (only when DLAB=1)
 #define uart_DLM		(*(volatile uint8_t *)(uart_base + 0x02))	// Divisor Latch High Byte (only when DLAB=1)
 
+// Our own registers in gh_uart_16550, for a deep receive FIFO and for
+// flow control.  FPGA images without them read 0 here.
+#define uart_XTL		(*(volatile uint8_t *)(uart_base + 0x10))	// Receive trigger level, in 4s (0 = FCR's)
+#define uart_XFD		(*(volatile uint8_t *)(uart_base + 0x12))	// log2 of receive FIFO depth - read-only
+#define uart_XFC		(*(volatile uint8_t *)(uart_base + 0x14))	// Flow Control
+
+// The receive DMA in uart_dma.vhd, which fills uart_rb itself.  FPGA
+// images without it read 0 here.
+#define dma_base		(0xc0c0)
+#define dma_BASE		(*(volatile uint16_t *)(dma_base + 0x00))	// Address of the ring (writing empties it)
+#define dma_HEAD		(*(volatile uint16_t *)(dma_base + 0x02))	// Characters stored - read-only
+#define dma_TAIL		(*(volatile uint16_t *)(dma_base + 0x04))	// Characters taken
+#define dma_HIGH		(*(volatile uint16_t *)(dma_base + 0x06))	// Pause the sender above this
+#define dma_LOW			(*(volatile uint16_t *)(dma_base + 0x08))	// Let it go at or below this
+#define dma_CTL			(*(volatile uint16_t *)(dma_base + 0x0a))	// Control
+
 // UART register bits
 
 // IER
@@ -60,6 +81,7 @@
 
 // IER convenience
 #define uart_IER_INIT		(uart_IER_ERBFI_v)
+#define uart_IER_INIT_DMA	(uart_IER_ELSI_v)
 
 // IIR
 #define uart_IIR_PENDING_b	(0)						// Interrupt pending when 0
@@ -111,31 +133,94 @@
 // MCR
 #define uart_MCR_DTR_b		(0)						// Data Terminal Ready
 #define uart_MCR_RTS_b		(1)						// Request To Send
+#define uart_MCR_AFE_b		(5)						// Auto Flow Control Enable (16750)
 
 // MCR bits as values
 #define uart_MCR_DTR_v		(1 << uart_MCR_DTR_b)
 #define uart_MCR_RTS_v		(1 << uart_MCR_RTS_b)
+#define uart_MCR_AFE_v		(1 << uart_MCR_AFE_b)
 
 // MCR convenience
 #define uart_MCR_INIT		(uart_MCR_DTR_v | uart_MCR_RTS_v)
 
+// XFC
+#define uart_XFC_PAUSE_b	(0)						// Stop the sender
+#define uart_XFC_XAUTO_b	(1)						// Send XOFF and XON as PAUSE changes
+#define uart_XFC_FIFO_b		(2)						// Also stop it while the receive FIFO is 7/8 full
+
+// XFC bits as values
+#define uart_XFC_PAUSE_v	(1 << uart_XFC_PAUSE_b)
+#define uart_XFC_XAUTO_v	(1 << uart_XFC_XAUTO_b)
+#define uart_XFC_FIFO_v		(1 << uart_XFC_FIFO_b)
+
+// dma_CTL
+#define dma_CTL_ON_v		(0x0001)					// Take the receive FIFO
+
 // LSR
 #define uart_LSR_DR_b		(0)						// Received data ready
+#define uart_LSR_OE_b		(1)						// Overrun Error
+#define uart_LSR_PE_b		(2)						// Parity Error
+#define uart_LSR_FE_b		(3)						// Framing Error
 #define uart_LSR_THRE_b		(5)						// Transmitter Holding Register Empty
-#define uart_LSR_TEMT_b		(5)						// Transmitter Empty
+#define uart_LSR_TEMT_b		(6)						// Transmitter Empty
 
 // LSR bits as values
 #define uart_LSR_DR_v		(1 << uart_LSR_DR_b)
+#define uart_LSR_OE_v		(1 << uart_LSR_OE_b)
+#define uart_LSR_PE_v		(1 << uart_LSR_PE_b)
+#define uart_LSR_FE_v		(1 << uart_LSR_FE_b)
 #define uart_LSR_THRE_v		(1 << uart_LSR_THRE_b)
 #define uart_LSR_TEMT_v		(1 << uart_LSR_TEMT_b)
 
+// LSR convenience
+#define uart_LSR_ERRORS		(uart_LSR_OE_v | uart_LSR_PE_v | uart_LSR_FE_v)
+
+// The diagnostic LEDs show which kinds of trouble there have been since
+// the statistics were last cleared.
+#define uart_LED_OVERRUN	(0x01)
+#define uart_LED_PARITY		(0x02)
+#define uart_LED_FRAMING	(0x04)
+#define uart_LED_DROPPED	(0x08)
+#define uart_LED_PAUSED		(0x10)
+
 // Baud rate, etc. dip switches
 #define dipSW			(*(volatile uint8_t *)(0xc020))
 #define dipBaudMask		(0x0f)
 #define dipFlowMask		(0x10)						// 0 = RTS/CTS, 1 = XON/XOFF
 
-#define uart_depth		(128)						// SW receiver fifo depth
-#define uart_high_water		(64)
+// The receive ring takes 4K of the RAM below the stack (see fw.ld).  It
+// must be a power of 2 no bigger than 32K, because of the way
+// uart_rb_input and uart_rb_output wrap.  _level3 in init.S has a copy,
+// and so does ringBits in ../uart_dma.vhd.
+#define uart_depth		(4096)						// SW receiver fifo depth
+#define uart_fifo_depth		(16)						// gh_uart_16550 receive FIFO
+#define uart_fifo_bits_max	(10)						// Deepest block RAM FIFO
+
+// The most uart_receive_span() hands out at once, so that the main loop
+// still gets round to the keyboard during a long burst.
+#define uart_span_max		(128)
+
+// The transmit ring only ever holds keystrokes and replies, so it can be
+// small.  It must be a power of 2.
+#define uart_tx_depth		(256)						// SW transmitter fifo depth
+#define uart_tx_fifo_depth	(16)						// gh_uart_16550 transmit FIFO
+
+// How the far end reacts to flow control, for uart_set_water().  It keeps
+// sending for a while after being told to stop, and takes a while to start
+// again when told to go.  Part of that is a time (a driver noticing CTS,
+// or a host noticing XOFF and XON), and part is characters it had already
+// committed to its transmitter (a 16550 FIFO, or a USB adapter's buffer).
+// XON/XOFF is much slower, because the whole round trip is in software.
+#define rts_react_us		(1000)
+#define rts_react_chars		(16)
+#define xon_react_us		(10000)
+#define xon_react_chars		(64)
+
+// The 68000 clock, in kHz.  A character takes 80 of these per unit of
+// divisor: the UART clock is twice the 68000's, it samples 16 times a
+// bit, and there are 10 bits to a character.
+#define cpu_khz			(44250)
+#define clocks_per_char		(80)
 
 #define XON			(0x11)						// ^Q (DC1)
 #define XOFF			(0x13)						// ^S (DC3)
@@ -144,9 +229,24 @@
 
 int uart_break_timer;
 
+UART_STATS uart_stats;
+static uint8_t uart_leds;
+
 static int uart_flow;
 static int uart_flow_state;							// 1 if paused, else 0
 
+// What we keep in XFC, apart from the pause bit, if the UART can pause
+// the sender itself.  0 if it can't, and we drop RTS or send XOFF.
+static uint8_t uart_xfc;
+
+// Stop the sender above uart_high_water, and let it go again at or below
+// uart_low_water.  Set by uart_set_water().
+uint16_t uart_high_water;
+static uint16_t uart_low_water;
+
+// How many characters the receive FIFO holds.  See uart_initialize().
+static uint16_t uart_rx_fifo;
+
 // These divisors are based on our 88.5 MHz CPU clock.
 static uint16_t baud_table[] = {
 	50284,	// sw=0 for 110 baud
@@ -167,6 +267,63 @@ static uint16_t baud_table[] = {
 	6,	// sw=15 for 921600 baud
 };
 
+// uart_set_water - set the flow control thresholds for a divisor
+//
+// Stopping the sender has to leave room for everything it sends before
+// it reacts, plus whatever is in the FIFO.  Letting it go again has to
+// leave enough buffered to keep us busy until the first new character
+// arrives, and we only check between runs from uart_receive_span(), so
+// we add one of those.  Both are counted in characters at the line rate,
+// which is the most we could take in that time.
+//
+// Otherwise, the less we hold the better.  Whatever is in uart_rb has to
+// be drawn before anything typed after it, such as a ^C, can take effect,
+// and the far end can't throw it away.  So the high water mark is only as
+// far above the low water mark as the stop headroom, which keeps the slow
+// rates down to a couple of hundred characters.  At the fast rates,
+// XON/XOFF needs most of the ring.
+static void
+uart_set_water(uint16_t divisor)
+{
+	uint32_t react_us;
+	uint32_t react_chars;
+	uint32_t stop;
+	uint32_t go;
+	uint32_t high;
+	uint32_t low;
+
+	if(uart_flow == HW_FLOW) {
+		react_us = rts_react_us;
+		react_chars = rts_react_chars;
+	} else {
+		react_us = xon_react_us;
+		react_chars = xon_react_chars;
+	}
+
+	// Characters that arrive during the reaction time.
+	go = (react_us * cpu_khz) / (1000 * clocks_per_char * (uint32_t)divisor);
+	if(uart_flow == SW_FLOW) {
+		// The XON or XOFF itself has to be sent first.
+		go++;
+	}
+
+	stop = go + react_chars + uart_rx_fifo;
+	low = go + uart_span_max;
+	high = low + stop;
+
+	// Keep the stop headroom inside the ring, even if that means less
+	// room between the marks.
+	if(high > uart_depth - stop) {
+		high = uart_depth - stop;
+		if(low > high - uart_span_max) {
+			low = high - uart_span_max;
+		}
+	}
+
+	uart_high_water = high;
+	uart_low_water = low;
+}
+
 // uart_set_baud - set the baud rate based on the dip switches
 static void
 uart_set_baud()
@@ -188,21 +345,131 @@ uart_set_baud()
 
 	// Determine the flow-control type.
 	uart_flow = !!(switches & dipFlowMask);
+
+	// And from both, when to stop and start the sender.
+	uart_set_water(divisor);
 }
 
-static uint8_t uart_rb[uart_depth];
-static int uart_rb_input;
-static int uart_rb_output;
-static int uart_rb_count;
+// The receive ring.  The interrupt service routine only ever writes
+// uart_rb_input, and the main loop only ever writes uart_rb_output, so
+// neither needs to mask interrupts.  Both run freely and are masked when
+// used as an index, so the difference between them is how many characters
+// are waiting, and all uart_depth slots can be used.  They are 16 bits so
+// that each is read and written by a single instruction.
+//
+// _level3 in init.S fills the ring itself, so these aren't static.
+uint8_t uart_rb[uart_depth];
+volatile uint16_t uart_rb_input;
+volatile uint16_t uart_rb_output;
+
+// The transmit ring works the same way, the other way round: the main loop
+// only ever writes uart_tx_input, and the interrupt service routine only
+// ever writes uart_tx_output.  An XON or XOFF goes in uart_tx_flow instead,
+// so that it can jump the queue.
+static uint8_t uart_tx[uart_tx_depth];
+static volatile uint16_t uart_tx_input;
+static volatile uint16_t uart_tx_output;
+static volatile uint8_t uart_tx_flow;						// XON, XOFF or 0
+
+// A copy of IER, because we turn the transmit interrupt on and off.  It
+// is only changed at level 3, so the main loop has to use spl3() to
+// change it.
+uint8_t uart_ier;
+
+// Set if uart_dma.vhd is filling uart_rb, rather than _level3.  Then
+// dma_HEAD takes the place of uart_rb_input, and it stops and starts the
+// sender itself.
+static int uart_dma;
+
+// uart_rb_head - how many characters have been put in uart_rb
+static inline uint16_t
+uart_rb_head()
+{
+	if(uart_dma) {
+		return dma_HEAD;
+	}
+	return uart_rb_input;
+}
+
+// Set while we are sending a break, when the transmitter must be left
+// alone.  Only changed at level 3.
+static int uart_in_break;
+
+// uart_led - light a diagnostic LED, if it isn't already
+static void
+uart_led(uint8_t led)
+{
+	if(!(uart_leds & led)) {
+		uart_leds |= led;
+		write_led(uart_leds);
+	}
+}
+
+// uart_clear_stats - start counting again
+void
+uart_clear_stats()
+{
+	uint16_t sr;
+
+	// The interrupt service routine keeps the counts, so keep it out
+	// until they are all clear.
+	sr = spl3();
+
+	uart_stats.overruns = 0;
+	uart_stats.parity = 0;
+	uart_stats.framing = 0;
+	uart_stats.dropped = 0;
+	uart_stats.pauses = 0;
+	uart_stats.peak = 0;
+
+	uart_leds = 0;
+	write_led(uart_leds);
+
+	splx(sr);
+}
+
+// uart_transmit_flow - send an XON or XOFF ahead of anything queued
+//
+// This must run at level 3: from the interrupt service routine, or with
+// spl3().  A newer one replaces any that hasn't gone yet, which is what we
+// want, because only the latest matters to the sender.
+static void
+uart_transmit_flow(uint8_t c)
+{
+	uart_tx_flow = c;
+
+	// The transmit interrupt will send it as soon as the FIFO is empty,
+	// which may be straight away.
+	uart_ier |= uart_IER_ETBEI_v;
+	uart_IER = uart_ier;
+}
 
 // uart_initialize - get the uart ready
 void
 uart_initialize()
 {
-	// Clear the receive buffer
+	uint8_t bits;
+
+	// Clear the buffers and the statistics.
 	uart_rb_input = 0;
 	uart_rb_output = 0;
-	uart_rb_count = 0;
+	uart_tx_input = 0;
+	uart_tx_output = 0;
+	uart_tx_flow = 0;
+	uart_in_break = 0;
+	uart_clear_stats();
+
+	// The FPGA may be built with a deeper receive FIFO, in which case we
+	// can let more characters wait in it before we are interrupted.  We
+	// need to know before uart_set_baud() works out the water marks, since
+	// anything in the FIFO still has to go in uart_rb after we stop the
+	// sender.
+	bits = uart_XFD;
+	if(bits > 4 && bits <= uart_fifo_bits_max) {
+		uart_rx_fifo = 1 << bits;
+	} else {
+		uart_rx_fifo = uart_fifo_depth;
+	}
 
 	// Set an initial baud rate
 	uart_set_baud();
@@ -216,25 +483,101 @@ uart_initialize()
 	// which will reduce the number of interrupts we have to process.
 	uart_FCR = uart_FCR_INIT;
 
+	// With a deep FIFO, interrupt at a quarter full instead, which is
+	// still well before it could overrun.  Below that, the character
+	// timeout still tells us about a short burst, or a key echoed back.
+	if(uart_rx_fifo > uart_fifo_depth) {
+		uart_XTL = uart_rx_fifo / 4 / 4;
+	}
+
+	// Newer FPGA images can stop and start the sender themselves.  They
+	// drop RTS, or get XOFF out ahead of anything in the transmit FIFO,
+	// as soon as we set the pause bit, so we never have to wait for the
+	// FIFO to empty.  Older ones won't keep what we write here.
+	//
+	// With RTS/CTS, they can also stop the sender if we are slow to
+	// empty the receive FIFO, which costs nothing on the line, and hold
+	// our own transmitter while CTS is off.  With XON/XOFF, the sender
+	// takes too long to react for that to help.
+	if(uart_flow == HW_FLOW) {
+		uart_xfc = uart_XFC_FIFO_v;
+	} else {
+		uart_xfc = uart_XFC_XAUTO_v;
+	}
+	uart_XFC = uart_xfc;
+	if(uart_XFC != uart_xfc) {
+		uart_xfc = 0;
+	}
+
 	// Set the MODEM control bits
-	uart_MCR = uart_MCR_INIT;
+	if(uart_xfc && uart_flow == HW_FLOW) {
+		uart_MCR = uart_MCR_INIT | uart_MCR_AFE_v;
+	} else {
+		uart_MCR = uart_MCR_INIT;
+	}
+
+	// The newest FPGA images can copy the receive FIFO into uart_rb
+	// themselves, and stop the sender at our water marks, so that we
+	// needn't take an interrupt for each batch of characters.  That needs
+	// the flow control above.  We still take line status interrupts to
+	// count the errors.
+	uart_dma = 0;
+	if(uart_xfc) {
+		dma_BASE = (uint16_t)(uint32_t)uart_rb;
+		if(dma_BASE == (uint16_t)(uint32_t)uart_rb) {
+			dma_TAIL = 0;
+			dma_HIGH = uart_high_water;
+			dma_LOW = uart_low_water;
+			dma_CTL = dma_CTL_ON_v;
+			uart_dma = 1;
+		}
+	}
 
-	// Enable interrupt - we really only care about received characters
-	// because we assume we can't type fast enough to overrun the tx
-	// buffer.
-	uart_IER = uart_IER_INIT;
+	// Enable interrupts for received characters.  The transmit interrupt
+	// is only turned on when there is something to send.
+	if(uart_dma) {
+		uart_ier = uart_IER_INIT_DMA;
+	} else {
+		uart_ier = uart_IER_INIT;
+	}
+	uart_IER = uart_ier;
 
 	// Unblock the sender.  We always set the RTS bit, because that is
 	// harmless.  We only send XON when using software flow control.
+	// Interrupts are still masked here, so it goes once they aren't.
 	//
 	// Remember the state for later.
 	uart_MCR |= uart_MCR_RTS_v;
 	if(uart_flow == SW_FLOW) {
-		uart_transmit(XON, UART_WAIT);
+		uart_transmit_flow(XON);
 	}
 	uart_flow_state = 0;
 }
 
+// uart_pause - stop the sender
+//
+// This runs from the interrupt service routine at level 3.
+static void
+uart_pause()
+{
+	if(uart_xfc) {
+		// The UART drops RTS or sends XOFF itself.
+		uart_XFC = uart_xfc | uart_XFC_PAUSE_v;
+	} else if(uart_flow == HW_FLOW) {
+		// Using hardware flow control - clear RTS.
+		uart_MCR &= ~uart_MCR_RTS_v;
+	} else {
+		// Using software flow control - send XOFF ahead of anything
+		// else waiting to go.
+		uart_transmit_flow(XOFF);
+	}
+
+	// Remember that we are paused.
+	uart_flow_state = 1;
+	uart_stats.pauses++;
+	uart_led(uart_LED_PAUSED);
+}
+
 // uart_store_char - store a character in the receive buffer
 //
 // This runs from the interrupt service routine at level 3.  Currently,
@@ -246,6 +589,7 @@ uart_store_char()
 	// Read the character - we have to do this even if there is no
 	// room to store it, because reading clears the interrupt.
 	uint8_t val = uart_RBR;
+	uint16_t count;
 
 	if(!val) {
 		// Toss nulls - we get lots of them as padding characters
@@ -253,101 +597,176 @@ uart_store_char()
 		return;
 	}
 
+	// The main loop may take characters while we run, but can't add
+	// any, so this is the most that can be waiting.
+	count = uart_rb_input - uart_rb_output;
+
 	// See if we are above the receiver's high water mark.
-	if(uart_rb_count > uart_high_water) {
+	if(count > uart_high_water) {
 		// See if we need to initiate a pause.
 		if(uart_flow_state == 0) {
-			// Start a pause.
-			if(uart_flow == HW_FLOW) {
-				// Using hardware flow control - clear RTS and
-				// remember that we are paused.
-				uart_MCR &= ~uart_MCR_RTS_v;
-				uart_flow_state = 1;
-			} else {
-				// Using software flow control - send XOFF.
-				// Don't wait - we are in an ISR.
-				if(uart_transmit(XOFF, UART_NO_WAIT)) {
-					// If the send was successful, remember
-					// that we are paused.  Otherwise,
-					// leave the flow state at 0 so we try
-					// to pause again when the next
-					// character is received.
-					uart_flow_state = 1;
-				}
-			}
+			uart_pause();
 		}
 	}
 
-	if(uart_rb_count < uart_depth) {
-		uart_rb[uart_rb_input] = val;
+	// Fold GR onto GL.  screen_handler() hands runs of this buffer
+	// straight to the parser, which only knows 7-bit characters and the
+	// C1 controls.
+	if(val >= 0xa0) {
+		val -= 0x80;
+	}
+
+	if(count < uart_depth) {
+		uart_rb[uart_rb_input & (uart_depth - 1)] = val;
+
+		// One more now available.  The main loop won't look at the
+		// slot until we return, so the order doesn't matter here.
+		++uart_rb_input;
+	} else {
+		// No room, so it is lost.
+		uart_stats.dropped++;
+		uart_led(uart_LED_DROPPED);
+	}
+}
 
-		// One more now available.
-		++uart_rb_count;
-		
-		// Move the input pointer, keeping it in range.
-		uart_rb_input = (uart_rb_input + 1) & (uart_depth - 1);
+// uart_line_errors - count the errors reported by LSR
+//
+// This runs from the interrupt service routine at level 3.
+static void
+uart_line_errors(uint8_t lsr)
+{
+	if(lsr & uart_LSR_OE_v) {
+		uart_stats.overruns++;
+		uart_led(uart_LED_OVERRUN);
+	}
+	if(lsr & uart_LSR_PE_v) {
+		uart_stats.parity++;
+		uart_led(uart_LED_PARITY);
+	}
+	if(lsr & uart_LSR_FE_v) {
+		uart_stats.framing++;
+		uart_led(uart_LED_FRAMING);
 	}
 }
 
-// uart_test_interrupt - see if the uart has posted an interrupt
+// uart_transmit_interrupt - refill the transmit FIFO
+//
+// This runs from the interrupt service routine at level 3, when the
+// transmit interrupt is on and the FIFO is empty.  We fill the FIFO from
+// the transmit ring, and turn the interrupt off once the ring is empty.
+static void
+uart_transmit_interrupt()
+{
+	int room = uart_tx_fifo_depth;
+
+	if(!uart_in_break) {
+		// Flow control first.
+		if(uart_tx_flow) {
+			uart_THR = uart_tx_flow;
+			uart_tx_flow = 0;
+			room--;
+		}
+
+		while(room && uart_tx_output != uart_tx_input) {
+			uart_THR = uart_tx[uart_tx_output & (uart_tx_depth - 1)];
+			++uart_tx_output;
+			room--;
+		}
+
+		if(uart_tx_output != uart_tx_input) {
+			// More to come when the FIFO is empty again.
+			return;
+		}
+	}
+
+	// Nothing left to send, or we mustn't.  Either way, turning the
+	// interrupt off clears it.
+	uart_ier &= ~uart_IER_ETBEI_v;
+	uart_IER = uart_ier;
+}
+
+// uart_test_interrupt - finish an interrupt that _level3 couldn't
+//
+// _level3 in init.S reads the receive FIFO into uart_rb itself, as long
+// as all it has to do is toss nulls and fold GR onto GL.  It calls us,
+// with the LSR it has just read, for anything else: a line error, uart_rb
+// above the high water mark, or room in the transmit FIFO while the
+// transmit interrupt is on.  We carry on from there until the FIFO is
+// empty.
 //
 // This runs from the interrupt service routine at level 3.  Currently,
 // there are no higher priority interrupts, so we should always run to
 // completion.
 void
-uart_test_interrupt()
+uart_test_interrupt(uint8_t lsr)
 {
-	// We will be interrupted either when the receive FIFO goes above
-	// threshold, or when a receive FIFO timeout occurs.
-	//
-	// The timeout is generated automatically by the uart if there is
-	// something in the FIFO and enough time has passed between when
-	// we last read from the FIFO.  Thus, we'll get an interrupt even
-	// if only one byte sits in the receive FIFO long enough.
-	//
-	// Either way, read characters and store them until the uart is empty.  
-	while(uart_LSR & uart_LSR_DR_v) {
+	// Reading LSR clears its error bits, so we count them on every read,
+	// including the last one, which finds the FIFO empty.
+	while(1) {
+		if(lsr & uart_LSR_ERRORS) {
+			uart_line_errors(lsr);
+		}
+		if(!(lsr & uart_LSR_DR_v)) {
+			break;
+		}
 		uart_store_char();
+		lsr = uart_LSR;
+	}
+
+	// The last LSR also tells us whether the transmit FIFO is empty.
+	if((uart_ier & uart_IER_ETBEI_v) && (lsr & uart_LSR_THRE_v)) {
+		uart_transmit_interrupt();
 	}
 }
 
 // uart_transmit - transmit a character
 //
+// The character goes in the transmit ring, and the interrupt service
+// routine sends it, so we only wait if the ring is full.  That can only
+// happen if something sends a lot more than a keystroke or a report.
+//
 // Return 0 if we cannot.
 int
 uart_transmit(unsigned char c, int wait)
 {
+	uint16_t sr;
+
 	// If we are in the middle of sending a break, reject any
 	// attempt to send a new character, even if the caller has
 	// asked us to wait.  Breaks last 100 ms and that is too
-	// long to stall here.  We might have been called from
-	// interrupt level to send a ^S, or the screen code might
-	// be trying to respond to ESC [ n.
+	// long to stall here.  The screen code might be trying to
+	// respond to ESC [ n.
 	//
 	// Break is a very rare event, so this should be ok...
 	if(uart_break_timer != 0) {
 		return 0;
 	}
 
-	// We are usually willing to wait for the fifo to be empty,
-	// because we never queue more than one character, so the
-	// fifo should go empty very quickly.  But if we are called
-	// during an interrupt, then we won't wait.
-	//
-	// uart_LSR_THRE_v = 1 means "fifo empty"
-	// uart_LSR_THRE_v = 0 means "fifo not empty"
-	//
-	// Note that even if the fifo is empty, the transmit shift
-	// register may still be sending out a character.
-	while((uart_LSR & uart_LSR_THRE_v) == 0) {
-		// The transmit fifo is not empty.  Should we wait?
+	// Wait for room, if we are allowed to.  The interrupt service
+	// routine is already emptying the ring if it is full.
+	while((uint16_t)(uart_tx_input - uart_tx_output) >= uart_tx_depth) {
 		if(wait == UART_NO_WAIT) {
-			// Nope.
 			return 0;
 		}
 	}
 
-	uart_THR = c;
+	uart_tx[uart_tx_input & (uart_tx_depth - 1)] = c;
+
+	// Only hand the slot over once it has been written.
+	barrier();
+	++uart_tx_input;
+
+	// Make sure the transmit interrupt is on.  If the interrupt service
+	// routine turns it off after we look, it will have seen this
+	// character first, so it only ever turns it off early if we turn it
+	// back on here.
+	if(!(uart_ier & uart_IER_ETBEI_v)) {
+		sr = spl3();
+		uart_ier |= uart_IER_ETBEI_v;
+		uart_IER = uart_ier;
+		splx(sr);
+	}
+
 	return 1; // Character is queued.
 }
 
@@ -362,80 +781,126 @@ uart_transmit_string(char *pString, int wait)
 	}
 }
 
-// uart_receive - get a character from the receiver queue
-//
-// We have to disable interrupts for mutual exclusion with the
-// uart_test_interrupt routine.
+// uart_resume - let the sender go again, if we stopped it
 //
-// Return the next character in our buffer, or -1 if nothing available.
-int
-uart_receive()
+// Called when the receiver queue has drained to the low water mark.
+static void
+uart_resume()
 {
 	uint16_t sr;
 
-	// Assume nothing is available.
-	int rv = -1;
+	if(uart_flow_state) {
+		// Flow is currently blocked, and our buffer has room.
+		// Allow data to flow.
+		if(uart_xfc) {
+			// The UART raises RTS or sends XON itself.
+			uart_XFC = uart_xfc;
+			uart_flow_state = 0;
+		} else if(uart_flow == HW_FLOW) {
+			// Using hardware flow control - set RTS and
+			// remember that flow is not blocked anymore.
+			uart_MCR |= uart_MCR_RTS_v;
+			uart_flow_state = 0;
+		} else {
+			// Using software flow control - send an XON
+			// ahead of anything else waiting to go, and
+			// remember that flow is not blocked anymore.
+			sr = spl3();
+			uart_transmit_flow(XON);
+			uart_flow_state = 0;
+			splx(sr);
+		}
+	}
+}
 
-	// We need mutual exclusion with our interrupt service routine.
-	// It runs at level 3, so mask out interrupts at level 3 and below.
-	sr = spl3();
+// uart_receive_span - get a run of characters from the receiver queue
+//
+// Point *ppData at the oldest character in our buffer, and return how
+// many characters follow it before the buffer wraps, up to uart_span_max,
+// or 0 if nothing is available.  The characters stay in the buffer, where
+// the interrupt service routine won't touch them, until
+// uart_receive_done() is called.
+//
+// We don't need to disable interrupts here.  The interrupt service
+// routine (or the DMA) only ever moves uart_rb_input forward, so at worst
+// we miss a character that will be in the next run.
+int
+uart_receive_span(uint8_t **ppData)
+{
+	uint16_t output = uart_rb_output;
+	int n = (uint16_t)(uart_rb_head() - output);
 
-	if(uart_rb_count) {
-		// Something available.
-		rv = uart_rb[uart_rb_output];
+	if(n == 0) {
+		// Nothing available, so make sure we haven't blocked the
+		// sender.
+		uart_resume();
+		return 0;
+	}
 
-		// One less now available.
-		--uart_rb_count;
-		
-		// Move the output pointer, keeping it in range.
-		uart_rb_output = (uart_rb_output + 1) & (uart_depth - 1);
+	// Stop at the end of the buffer.  The rest will be the next run.
+	output &= uart_depth - 1;
+	if(n > uart_depth - output) {
+		n = uart_depth - output;
+	}
+	if(n > uart_span_max) {
+		n = uart_span_max;
 	}
 
-	// Go back to the previous interrupt level (should be 0, because we
-	// don't do preemption).
-	splx(sr);
+	*ppData = &uart_rb[output];
+	return n;
+}
 
-	// If there is nothing available, make sure we haven't blocked the
-	// sender.
-	if(rv == -1) {
-		if(uart_flow_state) {
-			// Flow is currently blocked, and our buffer is empty.
-			// Allow data to flow.
-			if(uart_flow == HW_FLOW) {
-				// Using hardware flow control - set RTS and
-				// remember that flow is not blocked anymore.
-				uart_MCR |= uart_MCR_RTS_v;
-				uart_flow_state = 0;
-			} else {
-				// Using software flow control - try to send
-				// an XON to unblock.
-				//
-				// We are outside the interrupt mask, so we can
-				// wait for the uart.
-				if(uart_transmit(XON, UART_WAIT)) {
-					// If the send was successful, remember
-					// that we are now unblocked.
-					//
-					// Otherwise, leave the flow state at
-					// 0 so we try to unblock again the
-					// next time we are called.
-					uart_flow_state = 0;
-				}
-			}
-		}
+// uart_receive_done - give back characters from uart_receive_span()
+//
+// Moving the output pointer hands their slots back to the interrupt
+// service routine, so it must not happen until the caller is done with
+// them.
+void
+uart_receive_done(int n)
+{
+	uint16_t count = uart_rb_head() - uart_rb_output;
+
+	// The ring only empties here, so it is fullest just before.  Keeping
+	// the peak here rather than in the interrupt service routine saves
+	// it a few clocks on every character.
+	if(count > uart_stats.peak) {
+		uart_stats.peak = count;
 	}
 
-	return rv;
+	barrier();
+	uart_rb_output += n;
+	if(uart_dma) {
+		dma_TAIL = uart_rb_output;
+	}
+
+	// If we stopped the sender, let it go again once we are down to the
+	// low water mark, so the line doesn't sit idle while we finish what
+	// is left.
+	if(uart_flow_state && (uint16_t)(uart_rb_input - uart_rb_output) <= uart_low_water) {
+		uart_resume();
+	}
 }
 
 // Start a line break.
 void
 uart_start_break()
 {
+	uint16_t sr;
+
 	// Set the break timer for 100 ms.  Do this first, so
 	// it can block any new output from being queued.
 	uart_break_timer = 7777;
 
+	// Let the interrupt service routine send what is already queued.
+	while(uart_tx_output != uart_tx_input) {
+		;
+	}
+
+	// Then stop it sending anything else, even XON or XOFF.
+	sr = spl3();
+	uart_in_break = 1;
+	splx(sr);
+
 	// Wait for the transmitter to be completely idle.
 	while(!(uart_LSR & uart_LSR_TEMT_v)) {
 		;
@@ -449,7 +914,18 @@ uart_start_break()
 void
 uart_stop_break()
 {
+	uint16_t sr;
+
 	// Stop the break condition.
 	uart_LCR &= ~uart_LCR_SBRK_v;
+
+	// Let the interrupt service routine send again.  It will turn the
+	// transmit interrupt off if there is nothing waiting, such as an
+	// XON or XOFF held back by the break.
+	sr = spl3();
+	uart_in_break = 0;
+	uart_ier |= uart_IER_ETBEI_v;
+	uart_IER = uart_ier;
+	splx(sr);
 }
 
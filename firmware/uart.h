@@ -23,14 +23,29 @@
 #define UART_NO_WAIT	0
 #define UART_WAIT	1
 
+// Receive statistics, kept by the interrupt service routine since the last
+// uart_clear_stats().  The host can read them with ESC [ ? 900 n; see
+// screen_report().
+typedef struct {
+	uint32_t	overruns;	// Receive FIFO overruns (LSR OE)
+	uint32_t	parity;		// Parity errors (LSR PE)
+	uint32_t	framing;	// Framing errors (LSR FE)
+	uint32_t	dropped;	// Characters lost because uart_rb was full
+	uint32_t	pauses;		// Times we stopped the sender
+	uint32_t	peak;		// Most characters uart_rb has held (kept by uart_receive_done())
+} UART_STATS;
+
 extern void uart_initialize();
-extern void uart_test_interrupt();
+extern void uart_test_interrupt(uint8_t lsr);
 extern int uart_transmit(unsigned char c, int wait);
 extern void uart_transmit_string(char *pString, int wait);
-extern int uart_receive();
+extern int uart_receive_span(uint8_t **ppData);
+extern void uart_receive_done(int n);
 extern void uart_start_break();
 extern void uart_stop_break();
+extern void uart_clear_stats();
 
 extern int uart_break_timer;
+extern UART_STATS uart_stats;
 
 #endif // _UART_H_
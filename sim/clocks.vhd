@@ -0,0 +1,66 @@
+-- ANSI Terminal
+--
+-- (c) 2021 Steven A. Falco
+--
+-- ANSI Terminal is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- ANSI Terminal is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+-- Simulation stand-ins for the dot_clock and cpu_clock PLLs.  The altpll
+-- model in altera_mf is slow, and needs the 12 MHz input to lock first, so
+-- for simulation we just make the clocks the PLLs are set up for.
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity dot_clock is
+	port
+	(
+		inclk0		: in std_logic;
+		c0		: out std_logic
+	);
+end dot_clock;
+
+architecture sim of dot_clock is
+begin
+	-- 108.0 MHz
+	dotClk: process
+	begin
+		c0 <= '0';
+		wait for 1 sec / 216_000_000;
+		c0 <= '1';
+		wait for 1 sec / 216_000_000;
+	end process dotClk;
+end sim;
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity cpu_clock is
+	port
+	(
+		inclk0		: in std_logic;
+		c0		: out std_logic
+	);
+end cpu_clock;
+
+architecture sim of cpu_clock is
+begin
+	-- 88.5 MHz
+	cpuClk: process
+	begin
+		c0 <= '0';
+		wait for 1 sec / 177_000_000;
+		c0 <= '1';
+		wait for 1 sec / 177_000_000;
+	end process cpuClk;
+end sim;
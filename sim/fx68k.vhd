@@ -0,0 +1,122 @@
+-- ANSI Terminal
+--
+-- (c) 2021 Steven A. Falco
+--
+-- ANSI Terminal is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- ANSI Terminal is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+-- GHDL can't read SystemVerilog, so the CPU is fx68k.sv built with
+-- Verilator, and this entity hands it its inputs on each rising edge of
+-- the clock and collects its outputs.  See fx68k_shim.cpp.
+--
+-- Everything in fx68k.sv happens on the rising edge of clk, so sampling
+-- the inputs just before the edge and driving the outputs just after it is
+-- the same as simulating the Verilog directly.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity fx68k is
+	port (
+		clk		: in std_logic;
+		HALTn		: in std_logic;
+		extReset	: in std_logic;
+		pwrUp		: in std_logic;
+		enPhi1		: in std_logic;
+		enPhi2		: in std_logic;
+
+		eRWn		: out std_logic;
+		ASn		: out std_logic;
+		LDSn		: out std_logic;
+		UDSn		: out std_logic;
+		E		: out std_logic;
+		VMAn		: out std_logic;
+
+		FC0		: out std_logic;
+		FC1		: out std_logic;
+		FC2		: out std_logic;
+		BGn		: out std_logic;
+		oRESETn		: out std_logic;
+		oHALTEDn	: out std_logic;
+
+		DTACKn		: in std_logic;
+		VPAn		: in std_logic;
+		BERRn		: in std_logic;
+		BRn		: in std_logic;
+		BGACKn		: in std_logic;
+		IPL0n		: in std_logic;
+		IPL1n		: in std_logic;
+		IPL2n		: in std_logic;
+
+		iEdb		: in std_logic_vector(15 downto 0);
+		oEdb		: out std_logic_vector(15 downto 0);
+		eab		: out std_logic_vector(23 downto 1)
+	);
+end fx68k;
+
+architecture verilated of fx68k is
+
+	-- Implemented in fx68k_shim.cpp.  The control inputs and outputs are
+	-- packed into one integer each, in the order they are listed below.
+	procedure fx68k_clock(
+		inputs		: in integer;
+		dataIn		: in integer;
+		outputs		: out integer;
+		dataOut		: out integer;
+		address		: out integer) is
+	begin
+		assert false report "fx68k_clock is provided by fx68k_shim.cpp" severity failure;
+	end procedure;
+	attribute foreign of fx68k_clock : procedure is "VHPIDIRECT fx68k_clock";
+
+	function to_bits(s : std_logic_vector) return integer is
+	begin
+		return to_integer(unsigned(to_01(unsigned(s))));
+	end function;
+
+begin
+
+	cpuProcess: process(clk)
+		variable inputs		: integer;
+		variable outputs	: integer;
+		variable dataOut	: integer;
+		variable address	: integer;
+		variable o		: std_logic_vector(11 downto 0);
+	begin
+		if(rising_edge(clk)) then
+			inputs := to_bits(IPL2n & IPL1n & IPL0n & BGACKn & BRn & BERRn &
+					VPAn & DTACKn & enPhi2 & enPhi1 & pwrUp & extReset & HALTn);
+
+			fx68k_clock(inputs, to_bits(iEdb), outputs, dataOut, address);
+
+			o := std_logic_vector(to_unsigned(outputs, 12));
+			eRWn <= o(0);
+			ASn <= o(1);
+			LDSn <= o(2);
+			UDSn <= o(3);
+			E <= o(4);
+			VMAn <= o(5);
+			FC0 <= o(6);
+			FC1 <= o(7);
+			FC2 <= o(8);
+			BGn <= o(9);
+			oRESETn <= o(10);
+			oHALTEDn <= o(11);
+
+			oEdb <= std_logic_vector(to_unsigned(dataOut, 16));
+			eab <= std_logic_vector(to_unsigned(address, 23));
+		end if;
+	end process;
+
+end verilated;
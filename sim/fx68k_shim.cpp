@@ -0,0 +1,73 @@
+// ANSI Terminal
+//
+// (c) 2021 Steven A. Falco
+//
+// ANSI Terminal is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// ANSI Terminal is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+// The C side of fx68k.vhd: run the Verilator model of fx68k.sv for one
+// clock period.  GHDL passes the "out" parameters by reference.
+
+#include "Vfx68k.h"
+#include "verilated.h"
+
+static Vfx68k *cpu;
+
+extern "C" void
+fx68k_clock(int inputs, int dataIn, int *outputs, int *dataOut, int *address)
+{
+	if(cpu == NULL) {
+		cpu = new Vfx68k;
+		cpu->clk = 0;
+		cpu->eval();
+	}
+
+	// Same order as fx68k.vhd.
+	cpu->HALTn =	(inputs >> 0) & 1;
+	cpu->extReset =	(inputs >> 1) & 1;
+	cpu->pwrUp =	(inputs >> 2) & 1;
+	cpu->enPhi1 =	(inputs >> 3) & 1;
+	cpu->enPhi2 =	(inputs >> 4) & 1;
+	cpu->DTACKn =	(inputs >> 5) & 1;
+	cpu->VPAn =	(inputs >> 6) & 1;
+	cpu->BERRn =	(inputs >> 7) & 1;
+	cpu->BRn =	(inputs >> 8) & 1;
+	cpu->BGACKn =	(inputs >> 9) & 1;
+	cpu->IPL0n =	(inputs >> 10) & 1;
+	cpu->IPL1n =	(inputs >> 11) & 1;
+	cpu->IPL2n =	(inputs >> 12) & 1;
+	cpu->iEdb = dataIn;
+	cpu->eval();
+
+	cpu->clk = 1;
+	cpu->eval();
+
+	*outputs =
+		(cpu->eRWn << 0) |
+		(cpu->ASn << 1) |
+		(cpu->LDSn << 2) |
+		(cpu->UDSn << 3) |
+		(cpu->E << 4) |
+		(cpu->VMAn << 5) |
+		(cpu->FC0 << 6) |
+		(cpu->FC1 << 7) |
+		(cpu->FC2 << 8) |
+		(cpu->BGn << 9) |
+		(cpu->oRESETn << 10) |
+		(cpu->oHALTEDn << 11);
+	*dataOut = cpu->oEdb;
+	*address = cpu->eab;
+
+	cpu->clk = 0;
+	cpu->eval();
+}
@@ -0,0 +1,312 @@
+-- ANSI Terminal
+--
+-- (c) 2021 Steven A. Falco
+--
+-- ANSI Terminal is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- ANSI Terminal is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+-- Measure the time from the start bit of each received character to the
+-- write of that character into the frame RAM, through the real UART, CPU
+-- and firmware (cpu_rom.mif).
+--
+-- The far end obeys RTS, and waits for the firmware to raise it before
+-- sending anything.  Each printable character other than a space is
+-- timed, by watching port B of the frame RAM for a write of the same
+-- character.  The cursor moves write 0x80 or a character with bit 7 set,
+-- so they don't match, but scrolling copies characters that are already
+-- on the screen, so a stream that scrolls can match too early.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use std.textio.all;
+
+entity latency_tb is
+	generic (
+		STREAM		: string := "";		-- File to send, or "" for TEXT
+		TEXT		: string := "The quick brown fox jumps over the lazy dog.";
+		SETTING		: natural := 10;	-- Baud rate DIP switch setting
+		SETTLE		: time := 1 ms;		-- Wait after RTS before sending
+		DRAIN		: time := 10 ms		-- Wait for the last character
+	);
+end latency_tb;
+
+architecture a of latency_tb is
+
+	component terminal is
+		port (
+			CLK12M			: in std_logic;
+
+			-- DIP switches for baud rate
+			DIP_SW			: in std_logic_vector(7 downto 0);
+
+			PIXEL_R1		: out std_logic;
+			PIXEL_R2		: out std_logic;
+			PIXEL_G1		: out std_logic;
+			PIXEL_G2		: out std_logic;
+			PIXEL_B1		: out std_logic;
+			PIXEL_B2		: out std_logic;
+
+			HSYNC			: out std_logic;
+			VSYNC			: out std_logic;
+
+			KBD_CLK			: in std_logic;
+			KBD_DATA		: in std_logic;
+
+			UART_RX			: in std_logic;
+			UART_TX			: out std_logic;
+			UART_RTS		: out std_logic;
+			UART_CTS		: in std_logic;
+
+			DBG_UART_RX		: in std_logic;
+			DBG_UART_TX		: out std_logic;
+			DBG_UART_RTS		: out std_logic;
+			DBG_UART_CTS		: in std_logic;
+
+			LEDS			: out std_logic_vector(7 downto 0)
+		    );
+	end component;
+
+	-- The same divisors as firmware/uart.c.  gh_uart_16550 takes 16 cpu
+	-- clocks per divisor count per bit.
+	type divisor_table is array (0 to 15) of natural;
+	constant baud_table : divisor_table := (
+		50284, 18438, 9219, 4609, 2305, 1152, 576, 288,
+		144, 96, 48, 24, 12, 6, 6, 6
+	);
+
+	constant CPU_PERIOD		: time := 1 sec / 88_500_000;
+	constant BIT_TIME		: time := 16 * baud_table(SETTING) * CPU_PERIOD;
+
+	constant MAX_CHARS		: natural := 4096;
+
+	type char_array is array (0 to MAX_CHARS - 1) of natural;
+	type cycle_array is array (0 to MAX_CHARS - 1) of natural;
+
+	type char_file is file of character;
+
+	signal CLK12M			: std_logic;
+
+	signal uartRx			: std_logic := '1';
+	signal uartTx			: std_logic;
+	signal uartRts			: std_logic;
+
+	signal loopback3		: std_logic;
+	signal loopback4		: std_logic;
+
+	signal dipSwitches		: std_logic_vector(7 downto 0);
+
+	signal kbdClock			: std_logic := '1';
+	signal kbdData			: std_logic := '1';
+
+	-- What was sent, and when its start bit went out.
+	signal sentChar			: char_array;
+	signal sentCycle		: cycle_array;
+	signal sentCount		: natural := 0;
+	signal sendDone			: boolean := false;
+
+	signal cycles			: natural := 0;
+
+	alias cpuClock is << signal .latency_tb.term.cpuClock : std_logic >>;
+	alias videoRamWren is << signal .latency_tb.term.videoRamWren : std_logic >>;
+	alias cpuByteEnables is << signal .latency_tb.term.cpuByteEnables : std_logic_vector(1 downto 0) >>;
+	alias oEdb is << signal .latency_tb.term.oEdb : std_logic_vector(15 downto 0) >>;
+
+	function timed(c : natural) return boolean is
+	begin
+		return c > 16#20# and c < 16#7f#;
+	end function;
+
+begin
+	term: terminal
+	port map
+	(
+		CLK12M => CLK12M,
+
+		UART_RX => uartRx,
+		UART_TX => uartTx,
+		UART_RTS => uartRts,
+		UART_CTS => '0',
+
+		DBG_UART_RX => loopback3,
+		DBG_UART_TX => loopback3,
+		DBG_UART_RTS => loopback4,
+		DBG_UART_CTS => loopback4,
+
+		KBD_CLK => kbdClock,
+		KBD_DATA => kbdData,
+
+		DIP_SW => dipSwitches
+	);
+
+	-- 12 Mhz
+	extClk: process
+	begin
+		CLK12M <= '0';
+		wait for 41.6667 ns;
+		CLK12M <= '1';
+		wait for 41.6667 ns;
+	end process extClk;
+
+	dipSwitches <= std_logic_vector(to_unsigned(SETTING, 8));
+
+	-- Count cpu clocks, which run at twice the 68000 clock.
+	countCycles: process(cpuClock)
+	begin
+		if(rising_edge(cpuClock)) then
+			cycles <= cycles + 1;
+		end if;
+	end process;
+
+	-- The far end.  8 bits, no parity, 1 stop bit, and stop between
+	-- characters while RTS is off.
+	sender: process
+		file f			: char_file;
+		variable c		: character;
+		variable b		: std_logic_vector(7 downto 0);
+		variable n		: natural := 0;
+
+		procedure send(v : natural) is
+		begin
+			if(uartRts /= '0') then
+				wait until uartRts = '0';
+			end if;
+
+			if(n < MAX_CHARS) then
+				sentChar(n) <= v;
+				sentCycle(n) <= cycles;
+				n := n + 1;
+				sentCount <= n;
+			end if;
+
+			b := std_logic_vector(to_unsigned(v, 8));
+			uartRx <= '0';
+			wait for BIT_TIME;
+			for i in 0 to 7 loop
+				uartRx <= b(i);
+				wait for BIT_TIME;
+			end loop;
+			uartRx <= '1';
+			wait for BIT_TIME;
+		end procedure;
+	begin
+		uartRx <= '1';
+		wait until uartRts = '0';
+		wait for SETTLE;
+
+		if(STREAM = "") then
+			for i in TEXT'range loop
+				send(character'pos(TEXT(i)));
+			end loop;
+		else
+			file_open(f, STREAM, read_mode);
+			while not endfile(f) loop
+				read(f, c);
+				send(character'pos(c));
+			end loop;
+			file_close(f);
+		end if;
+
+		sendDone <= true;
+		wait;
+	end process;
+
+	-- Watch port B of the frame RAM.
+	monitor: process
+		variable next_char	: natural := 0;
+		variable latency	: natural;
+		variable timed_count	: natural := 0;
+		variable total		: real := 0.0;
+		variable least		: natural := natural'high;
+		variable most		: natural := 0;
+		variable l		: line;
+
+		procedure skip is
+		begin
+			while next_char < sentCount and not timed(sentChar(next_char)) loop
+				next_char := next_char + 1;
+			end loop;
+		end procedure;
+
+		procedure summary is
+		begin
+			write(l, string'("timed "));
+			write(l, timed_count);
+			write(l, string'(" of "));
+			write(l, sentCount);
+			write(l, string'(" characters"));
+			writeline(output, l);
+			if(timed_count > 0) then
+				write(l, string'("start bit to frame RAM write, in 68000 clocks: min "));
+				write(l, least / 2);
+				write(l, string'(", mean "));
+				write(l, total / real(timed_count) / 2.0, right, 0, 1);
+				write(l, string'(", max "));
+				write(l, most / 2);
+				writeline(output, l);
+				write(l, string'("of which one character time is "));
+				write(l, 80 * baud_table(SETTING));
+				writeline(output, l);
+			end if;
+		end procedure;
+	begin
+		write(l, string'("char  start cycle  write cycle  68000 clocks"));
+		writeline(output, l);
+
+		loop
+			wait until rising_edge(cpuClock) or sendDone'event;
+
+			skip;
+			if(sendDone and next_char >= sentCount) then
+				exit;
+			end if;
+
+			if(rising_edge(cpuClock) and videoRamWren = '1' and cpuByteEnables = "11" and
+					next_char < sentCount and
+					to_integer(unsigned(to_01(unsigned(oEdb(6 downto 0))))) = sentChar(next_char)) then
+				latency := cycles - sentCycle(next_char);
+				write(l, character'val(sentChar(next_char)), right, 4);
+				write(l, sentCycle(next_char), right, 13);
+				write(l, cycles, right, 13);
+				write(l, latency / 2, right, 14);
+				writeline(output, l);
+
+				timed_count := timed_count + 1;
+				total := total + real(latency);
+				if(latency < least) then
+					least := latency;
+				end if;
+				if(latency > most) then
+					most := latency;
+				end if;
+				next_char := next_char + 1;
+			end if;
+		end loop;
+
+		summary;
+		std.env.finish;
+	end process;
+
+	-- Give up if the firmware never writes what was sent.
+	watchdog: process
+		variable l		: line;
+	begin
+		wait until sendDone;
+		wait for DRAIN;
+		write(l, string'("gave up waiting for the frame RAM"));
+		writeline(output, l);
+		std.env.finish;
+	end process;
+
+end a;
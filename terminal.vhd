@@ -176,12 +176,17 @@ architecture a of terminal is
 
 	component cpu_ram
 		port (
-			address		: in std_logic_vector (12 downto 0);
-			byteena		: in std_logic_vector (1 downto 0);
+			address_a	: in std_logic_vector (12 downto 0);
+			address_b	: in std_logic_vector (12 downto 0);
+			byteena_a	: in std_logic_vector (1 downto 0);
+			byteena_b	: in std_logic_vector (1 downto 0);
 			clock		: in std_logic;
-			data		: in std_logic_vector (15 downto 0);
-			wren		: in std_logic;
-			q		: out std_logic_vector (15 downto 0)
+			data_a		: in std_logic_vector (15 downto 0);
+			data_b		: in std_logic_vector (15 downto 0);
+			wren_a		: in std_logic;
+			wren_b		: in std_logic;
+			q_a		: out std_logic_vector (15 downto 0);
+			q_b		: out std_logic_vector (15 downto 0)
 		);
 	end component;
 
@@ -215,6 +220,11 @@ architecture a of terminal is
 			cpuUartQ	: in std_logic_vector (7 downto 0);
 			cpuUartInt	: in std_logic;
 
+			-- UART DMA Interface
+			cpuDmaCS	: out std_logic;
+			cpuDmaWR	: out std_logic;
+			cpuDmaQ		: in std_logic_vector (15 downto 0);
+
 			-- Keyboard Interface
 			cpuKbCS		: out std_logic;
 			cpuKbQ		: in std_logic_vector (7 downto 0);
@@ -243,12 +253,16 @@ architecture a of terminal is
 	end component;
 
 	component gh_uart_16550 is
+		generic(
+			RF_AW   	: integer := 4
+		);
 		port(
 			clk     	: in std_logic;
 			BR_clk  	: in std_logic;
 			rst     	: in std_logic;
 			CS      	: in std_logic;
 			WR      	: in std_logic;
+			XR      	: in std_logic := '0';
 			ADD     	: in std_logic_vector(2 downto 0);
 			D       	: in std_logic_vector(7 downto 0);
 
@@ -258,6 +272,10 @@ architecture a of terminal is
 			RIn     	: in std_logic := '1';
 			DCDn    	: in std_logic := '1';
 
+			XDMA    	: in std_logic := '0';
+			XRD     	: in std_logic := '0';
+			XPAUSE  	: in std_logic := '0';
+
 			sTX     	: out std_logic;
 			DTRn    	: out std_logic;
 			RTSn    	: out std_logic;
@@ -265,6 +283,8 @@ architecture a of terminal is
 			OUT2n   	: out std_logic;
 			TXRDYn  	: out std_logic;
 			RXRDYn  	: out std_logic;
+			XQ      	: out std_logic_vector(7 downto 0);
+			XEMPTY  	: out std_logic;
 
 			IRQ     	: out std_logic;
 			B_CLK   	: out std_logic;
@@ -272,6 +292,33 @@ architecture a of terminal is
 		);
 	end component;
 
+	component uart_dma is
+		port (
+			clk		: in std_logic;
+			reset		: in std_logic;
+
+			-- CPU
+			CS		: in std_logic;
+			WR		: in std_logic;
+			ADD		: in std_logic_vector (2 downto 0);
+			D		: in std_logic_vector (15 downto 0);
+			Q		: out std_logic_vector (15 downto 0);
+
+			-- UART receive FIFO
+			uartOn		: out std_logic;
+			uartRD		: out std_logic;
+			uartQ		: in std_logic_vector (7 downto 0);
+			uartEmpty	: in std_logic;
+			uartPause	: out std_logic;
+
+			-- CPU RAM, second port
+			ramAddr		: out std_logic_vector (12 downto 0);
+			ramByteEna	: out std_logic_vector (1 downto 0);
+			ramData		: out std_logic_vector (15 downto 0);
+			ramWren		: out std_logic
+		);
+	end component;
+
 	component keyboard is
 		port (
 			-- CPU interface
@@ -342,6 +389,19 @@ architecture a of terminal is
 	signal cpuUartQ			: std_logic_vector (7 downto 0);
 	signal cpuUartInt		: std_logic;
 
+	signal cpuDmaCS			: std_logic;
+	signal cpuDmaWR			: std_logic;
+	signal cpuDmaQ			: std_logic_vector (15 downto 0);
+	signal dmaRamAddr		: std_logic_vector (12 downto 0);
+	signal dmaRamByteEna		: std_logic_vector (1 downto 0);
+	signal dmaRamData		: std_logic_vector (15 downto 0);
+	signal dmaRamWren		: std_logic;
+	signal dmaUartOn		: std_logic;
+	signal dmaUartRD		: std_logic;
+	signal dmaUartQ			: std_logic_vector (7 downto 0);
+	signal dmaUartEmpty		: std_logic;
+	signal dmaUartPause		: std_logic;
+
 	signal cpuKbCS			: std_logic;
 	signal cpuKbQ			: std_logic_vector (7 downto 0);
 	signal cpuKbInt			: std_logic;
@@ -410,6 +470,12 @@ architecture a of terminal is
 	signal rts_n			: std_logic;
 	signal cts_n			: std_logic;
 
+	-- The UART receive FIFO holds 2**uartRxFifoBits characters.  4 is the
+	-- 16550's own 16.  5 to 10 (32 to 1024) put it in block RAM instead,
+	-- and the firmware then sets a higher trigger level, so it takes
+	-- interrupts in bigger batches and can be kept waiting for longer.
+	constant uartRxFifoBits		: integer := 4;
+
 	attribute keep: boolean;
 	signal addrbus			: std_logic_vector(23 downto 0); -- for debug
 	attribute keep of addrbus: signal is true;
@@ -535,16 +601,26 @@ begin
 	-- CPU RAM
 	cpuRam: cpu_ram
 		port map (
-			address => eab(13 downto 1),
-			byteena => cpuByteEnables,
+			address_a => eab(13 downto 1),
+			byteena_a => cpuByteEnables,
 			clock => cpuClock,
-			data => oEdb,
-			wren => cpuRamWren,
-			q => cpuRamQ
+			data_a => oEdb,
+			wren_a => cpuRamWren,
+			q_a => cpuRamQ,
+
+			-- The UART DMA writes the receive ring.
+			address_b => dmaRamAddr,
+			byteena_b => dmaRamByteEna,
+			data_b => dmaRamData,
+			wren_b => dmaRamWren,
+			q_b => open
 		);
 
 	-- CPU UART
 	uart: gh_uart_16550
+		generic map(
+			RF_AW => uartRxFifoBits
+		)
 		port map(
 			-- processor interface
 			clk => cpuClock,
@@ -552,6 +628,7 @@ begin
 			rst => cpuClearD1,
 			CS => cpuUartCS,
 			WR => cpuUartWR,
+			XR => eab(4),		-- vendor registers at 0xc010
 			ADD => eab(3 downto 1),
 			D => oEdb(7 downto 0),
 			RD => cpuUartQ,
@@ -566,12 +643,46 @@ begin
 			RTSn => rts_n,		-- rts, active low
 			DSRn => '0',		-- dsr, active low
 			RIn => '0',		-- ring indicator, active low
-			DCDn => '0'		-- dcd, active low
+			DCDn => '0',		-- dcd, active low
+
+			-- receive DMA
+			XDMA => dmaUartOn,
+			XRD => dmaUartRD,
+			XPAUSE => dmaUartPause,
+			XQ => dmaUartQ,
+			XEMPTY => dmaUartEmpty
 		);
 	
 	cts_n <= UART_CTS;
 	UART_RTS <= rts_n;
 
+	-- CPU UART receive DMA, into the ring in CPU RAM
+	uartDma: uart_dma
+		port map
+		(
+			-- CPU
+			clk => cpuClock,
+			reset => cpuClearD1,
+			CS => cpuDmaCS,
+			WR => cpuDmaWR,
+			ADD => eab(3 downto 1),
+			D => oEdb,
+			Q => cpuDmaQ,
+
+			-- UART
+			uartOn => dmaUartOn,
+			uartRD => dmaUartRD,
+			uartQ => dmaUartQ,
+			uartEmpty => dmaUartEmpty,
+			uartPause => dmaUartPause,
+
+			-- CPU RAM
+			ramAddr => dmaRamAddr,
+			ramByteEna => dmaRamByteEna,
+			ramData => dmaRamData,
+			ramWren => dmaRamWren
+		);
+
 	-- CPU Keyboard
 	cpuKB: keyboard
 		port map
@@ -647,6 +758,11 @@ begin
 			cpuUartWR => cpuUartWR,
 			cpuUartQ => cpuUartQ,
 			cpuUartInt => cpuUartInt,
+
+			-- UART DMA Interface
+			cpuDmaCS => cpuDmaCS,
+			cpuDmaWR => cpuDmaWR,
+			cpuDmaQ => cpuDmaQ,
 			
 			-- Keyboard Interface
 			cpuKbCS => cpuKbCS,
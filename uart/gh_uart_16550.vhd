@@ -37,18 +37,34 @@
 --	   	    	          	         	   back to back errors
 --	2.8     	07/21/08  	H LeFevre	mod equ for iBreak_ITR [add (and (not RF_EMPTY))]
 --	        	        	         	   as suggested by Nathan Z.
+--	2.9     	10/16/26  	S Falco  	RF_AW generic for a deeper receive FIFO in block
+--	        	          	         	   RAM (rx_fifo_bram), and vendor registers,
+--	        	          	         	   selected by XR: XTL, a receive trigger level
+--	        	          	         	   in fours, and XFD, log2 of the FIFO depth
+--	2.10    	10/16/26  	S Falco  	16750 style auto RTS/CTS (MCR bit 5), and
+--	        	          	         	   vendor register XFC, which pauses the
+--	        	          	         	   sender and can send XON and XOFF ahead
+--	        	          	         	   of the transmit FIFO
+--	2.11    	10/16/26  	S Falco  	XDMA port, which hands the receive FIFO to
+--	        	          	         	   a DMA engine (XRD, XQ, XEMPTY), and
+--	        	          	         	   XPAUSE, which pauses the sender for it
 --
 -----------------------------------------------------------------------------
 library ieee ;
 use ieee.std_logic_1164.all ;
+use ieee.numeric_std.all ;
 
 entity gh_uart_16550 is
+	generic(
+		RF_AW   : integer := 4 -- receive FIFO holds 2**RF_AW words; block RAM above 4
+		);
 	port(
 		clk     : in std_logic;
 		BR_clk  : in std_logic;
 		rst     : in std_logic;
 		CS      : in std_logic;
 		WR      : in std_logic;
+		XR      : in std_logic := '0'; -- ADD selects the vendor registers
 		ADD     : in std_logic_vector(2 downto 0);
 		D       : in std_logic_vector(7 downto 0);
 		
@@ -58,6 +74,10 @@ entity gh_uart_16550 is
 		RIn     : in std_logic := '1';
 		DCDn    : in std_logic := '1';
 		
+		XDMA    : in std_logic := '0'; -- the receive FIFO is read by DMA
+		XRD     : in std_logic := '0'; -- DMA read
+		XPAUSE  : in std_logic := '0'; -- DMA wants the sender stopped
+		
 		sTX     : out std_logic;
 		DTRn    : out std_logic;
 		RTSn    : out std_logic;
@@ -65,6 +85,8 @@ entity gh_uart_16550 is
 		OUT2n   : out std_logic;
 		TXRDYn  : out std_logic;
 		RXRDYn  : out std_logic;
+		XQ      : out std_logic_vector(7 downto 0); -- oldest received word
+		XEMPTY  : out std_logic; -- receive FIFO empty
 		
 		IRQ     : out std_logic;
 		B_CLK   : out std_logic;
@@ -198,6 +220,28 @@ COMPONENT gh_fifo_async16_rcsr_wf is
 		full    : out STD_LOGIC);
 END COMPONENT;
 
+COMPONENT rx_fifo_bram is
+	GENERIC (
+		data_width : INTEGER :=11;
+		add_width  : INTEGER :=10
+		);
+	port (
+		clk_WR  : in STD_LOGIC;
+		clk_RD  : in STD_LOGIC;
+		rst     : in STD_LOGIC;
+		rc_srst : in STD_LOGIC:='0';
+		WR      : in STD_LOGIC;
+		RD      : in STD_LOGIC;
+		D       : in STD_LOGIC_VECTOR (data_width-1 downto 0);
+		Q       : out STD_LOGIC_VECTOR (data_width-1 downto 0);
+		empty   : out STD_LOGIC;
+		q_full  : out STD_LOGIC;
+		h_full  : out STD_LOGIC;
+		a_full  : out STD_LOGIC;
+		count   : out STD_LOGIC_VECTOR (add_width downto 0);
+		full    : out STD_LOGIC);
+END COMPONENT;
+
 COMPONENT  gh_counter_down_ce_ld_tc IS
 	GENERIC (size: INTEGER :=8);
 	PORT(
@@ -227,7 +271,7 @@ END COMPONENT;
 	signal iIIR   : std_logic_vector(3 downto 0); -- 12/23/06
 	signal FCR    : std_logic_vector(7 downto 0); -- FIFO Control register
 	signal LCR    : std_logic_vector(7 downto 0); -- Line Control Register
-	signal MCR    : std_logic_vector(4 downto 0); -- Modem Control Register
+	signal MCR    : std_logic_vector(5 downto 0); -- Modem Control Register
 	signal LSR    : std_logic_vector(7 downto 0); -- Line Status Register
 	signal MSR    : std_logic_vector(7 downto 0); -- Modem Status Register
 	signal SCR    : std_logic_vector(7 downto 0); -- Line Control Register
@@ -236,6 +280,7 @@ END COMPONENT;
 	signal RD_IIR : std_logic;
 	
 	signal iRD    : std_logic_vector(7 downto 0);
+	signal CSr    : std_logic; -- CS for the 16550 registers
 	signal CSn    : std_logic;
 	signal WR_B   : std_logic_vector(7 downto 0);
 	signal WR_F   : std_logic;
@@ -319,6 +364,30 @@ END COMPONENT;
 	signal q_full   : std_logic;
 	signal h_full   : std_logic;
 	signal a_full   : std_logic;
+	signal RF_count : std_logic_vector(RF_AW downto 0);
+	
+	signal XTL      : std_logic_vector(7 downto 0); -- vendor trigger level, in fours
+	signal WR_XTL   : std_logic;
+	signal XTL_ON   : std_logic;
+	signal XTL_HIT  : std_logic;
+	
+	signal XFC      : std_logic_vector(2 downto 0); -- vendor flow control
+	signal WR_XFC   : std_logic;
+	signal AFE      : std_logic; -- auto flow control enable
+	signal RF_HOLD  : std_logic; -- receive FIFO nearly full
+	signal RF_HOLDS : std_logic;
+	signal RF_HOLDC : std_logic;
+	signal PAUSE    : std_logic; -- sender should stop
+	signal iPAUSE   : std_logic_vector(1 downto 0); -- PAUSE, sync'd to BR_clk
+	signal iCTS     : std_logic_vector(1 downto 0); -- CTS, sync'd to BR_clk
+	signal CTS_HOLD : std_logic;
+	signal XF_PEND  : std_logic; -- XON or XOFF waiting to go
+	signal XF_SENT  : std_logic; -- last one sent (or waiting) was XOFF
+	signal XF_GO    : std_logic;
+	signal XF_CHAR  : std_logic_vector(7 downto 0);
+	signal TX_RYn   : std_logic; -- to the transmitter
+	signal TX_D     : std_logic_vector(7 downto 0);
+	signal TX_read  : std_logic;
 	
 	signal RF_ER   : std_logic;
 	signal TX_RDY  : std_logic;
@@ -343,11 +412,15 @@ begin
 ---- resd   ----------------------------------
 ----------------------------------------------
 
-	RD <= RF_DO(7 downto 0) when ((ADD = o"0") and (LCR(7) = '0')) else
+	RD <= XTL when ((XR = '1') and (ADD = o"0")) else
+	      std_logic_vector(to_unsigned(RF_AW, 8)) when ((XR = '1') and (ADD = o"1")) else
+	      ("00000" & XFC) when ((XR = '1') and (ADD = o"2")) else
+	      x"00" when (XR = '1') else
+	      RF_DO(7 downto 0) when ((ADD = o"0") and (LCR(7) = '0')) else
 	      (x"0" & IER) when ((ADD = o"1") and (LCR(7) = '0')) else
 	      IIR when (ADD = o"2") else
 	      LCR when (ADD = o"3") else
-	      ("000" & MCR) when (ADD = o"4") else
+	      ("00" & MCR) when (ADD = o"4") else
 	      LSR when (ADD = o"5") else
 	      MSR when (ADD = o"6") else
 	      SCR when (ADD = o"7") else
@@ -385,6 +458,7 @@ U2 : gh_jkff
 	RXRDYn <= (not RX_RDY);
 		
 	RX_RDYS <= '1' when ((FCR(3) = '0') and (RF_empty = '0')) else	-- mod 01/20/07
+	           XTL_HIT when ((FCR(3) = '1') and (XTL_ON = '1')) else
 	           '1' when ((FCR(3) = '1') and (FCR(7 downto 6) = "11") and (a_full = '1')) else
 	           '1' when ((FCR(3) = '1') and (FCR(7 downto 6) = "10") and (h_full = '1')) else
 	           '1' when ((FCR(3) = '1') and (FCR(7 downto 6) = "01") and (q_full = '1')) else
@@ -489,7 +563,7 @@ U10 : gh_jkff
 	iMSR(7) <= (not DCDn) when (iLOOP = '0') else
 	            MCR(3);
   
-	RD_MSR <= '0' when ((CS = '0') or (WR = '1')) else
+	RD_MSR <= '0' when ((CSr = '0') or (WR = '1')) else
 	          '0' when (ADD /= o"6") else
 	          '1';
 
@@ -519,7 +593,7 @@ u12 : gh_register_ce
 -------- LSR --------------------------------------
 ---------------------------------------------------
 
-	LSR(0) <= (not RF_empty);
+	LSR(0) <= (not RF_empty) and (not XDMA); -- 10/16/26
 
 U13 : gh_jkff 
 	PORT MAP (
@@ -570,7 +644,7 @@ U17 : gh_jkff
 	RF_ER <= '1' when (RF_DI(10 downto 8) > "000") else
 	         '0';
 	
-	RD_LSR <= '0' when ((CS = '0') or (WR = '1')) else
+	RD_LSR <= '0' when ((CSr = '0') or (WR = '1')) else
 	          '0' when (ADD /= o"5") else
 	          '1';
 	
@@ -585,7 +659,8 @@ U18 : gh_edge_det
 ------  registers -------
 ----------------------------------------------
 
-	CSn <= (not CS);
+	CSr <= CS and (not XR);
+	CSn <= (not CSr);
 	
 	
 u19 : gh_DECODE_3to8 
@@ -666,17 +741,17 @@ u24 : gh_register_ce
 	Break_CB <= LCR(6);
 		
 u25 : gh_register_ce 
-	generic map (5)
+	generic map (6)
 	port map(
 		clk => clk,
 		rst => rst,
 		ce => WR_B(4),
-		D => D(4 downto 0),
+		D => D(5 downto 0),
 		Q => MCR
 		);		
 
 	DTRn <= (not MCR(0)) or iLOOP;
-	RTSn <= (not MCR(1)) or iLOOP;
+	RTSn <= (not MCR(1)) or (AFE and PAUSE) or iLOOP; -- 10/16/26
 	OUT1n <= (not MCR(2)) or iLOOP;
 	OUT2n <= (not MCR(3)) or iLOOP;
   	iLOOP <= MCR(4);   
@@ -743,7 +818,7 @@ U28a : gh_edge_det
 	
 	RD_IIR <= '0' when (ADD /= o"2") else
 	          '0' when (WR = '1') else
-	          '0' when (CS = '0') else
+	          '0' when (CSr = '0') else
 	          '0' when (IIR(3 downto 1) /= "001") else -- walter hogan 12/12/2006
 	          '1';
 
@@ -772,8 +847,8 @@ U29 : gh_UART_Tx_8bit
 		clk => BR_clk,
 		rst => rst,
 		xBRC => BRC16x,
-		D_RYn => TF_empty,
-		D => TF_DO,
+		D_RYn => TX_RYn,
+		D => TX_D,
 		num_bits => num_bits,
 		Break_CB => Break_CB,
 		StopB => stopB,
@@ -781,9 +856,58 @@ U29 : gh_UART_Tx_8bit
 		Parity_EV => Parity_EV,
 		sTX => isTX,
 		BUSYn => TSR_EMPTY,
-		read => TF_RD);
+		read => TX_read);
 
 	sTX <= isTX;
+
+------------ 10/16/26 flow control -------------------------
+----- AFE (MCR bit 5), as in the 16750: RTS drops while ----
+-----    PAUSE is set, and the transmitter waits for CTS ---
+-----    before starting each word -------------------------
+----- XFC bit 1: an XOFF is sent when PAUSE is set, and ----
+-----    an XON when it clears, ahead of the transmit FIFO -
+-----    and whatever CTS says; a newer one replaces one ---
+-----    that hasn't gone yet ------------------------------
+
+	AFE <= MCR(5) and (not iLOOP);
+
+process(BR_clk,rst)
+begin
+	if (rst = '1') then
+		iPAUSE <= "00";
+		iCTS <= "00";
+		XF_PEND <= '0';
+		XF_SENT <= '0';
+	elsif (rising_edge(BR_clk)) then
+		iPAUSE <= iPAUSE(0) & PAUSE;
+		iCTS <= iCTS(0) & MSR(4);
+		if (XFC(1) = '0') then
+			XF_PEND <= '0';
+			XF_SENT <= '0';
+		elsif ((TX_read = '1') and (XF_GO = '1')) then
+			XF_PEND <= '0';
+		elsif (iPAUSE(1) /= XF_SENT) then
+			XF_PEND <= '1';
+			XF_SENT <= iPAUSE(1);
+		end if;
+	end if;
+end process;
+
+	CTS_HOLD <= AFE and (not iCTS(1));
+
+	XF_GO <= XF_PEND and (not Break_CB);
+
+	XF_CHAR <= x"13" when (XF_SENT = '1') else -- XOFF
+	           x"11"; -- XON
+
+	TX_RYn <= '0' when (XF_GO = '1') else
+	          '1' when (CTS_HOLD = '1') else
+	          TF_empty;
+
+	TX_D <= XF_CHAR when (XF_GO = '1') else
+	        TF_DO;
+
+	TF_RD <= TX_read and (not XF_GO);
 		
 --------------------------------------------------
 ---- Receive FIFO ----------------------------------
@@ -796,10 +920,16 @@ U30 : gh_edge_det
 		d => RD_RDY,
 		re => RF_WR);
 		
-	RF_RD <= '0' when (LCR(7) = '1') else -- added 04/19/06
-	         '1' when ((ADD = "000") and (CS = '1') and (WR = '0')) else
+	RF_RD <= XRD when (XDMA = '1') else -- 10/16/26
+	         '0' when (LCR(7) = '1') else -- added 04/19/06
+	         '1' when ((ADD = "000") and (CSr = '1') and (WR = '0')) else
 	         '0';
+
+	XQ <= RF_DO(7 downto 0);
+	XEMPTY <= RF_empty;
 		
+RF16 : if (RF_AW <= 4) generate
+
 U31 : gh_fifo_async16_rcsr_wf -- 01/20/07
 	Generic Map(data_width => 11)
 	PORT MAP (
@@ -817,6 +947,93 @@ U31 : gh_fifo_async16_rcsr_wf -- 01/20/07
 		a_full => a_full,
 		full => RF_full);
 
+	RF_count <= (others => '0');
+
+end generate;
+
+------------ deeper receive FIFO, in block RAM -------------
+------------ FCR trigger levels scale with the depth -------
+
+RFB : if (RF_AW > 4) generate
+
+U31 : rx_fifo_bram
+	Generic Map(data_width => 11, add_width => RF_AW)
+	PORT MAP (
+		clk_WR => BR_clk,
+		clk_RD => clk,
+		rst => rst,
+		rc_srst => RF_CLR,
+		WR => RF_WR,
+		RD => RF_RD,
+		D => RF_DI,
+		Q => RF_DO,
+		empty => RF_empty,
+		q_full => q_full,
+		h_full => h_full,
+		a_full => a_full,
+		count => RF_count,
+		full => RF_full);
+
+end generate;
+
+------------ vendor registers ------------------------------
+----- XR = '1', ADD = 0: XTL, receive trigger level --------
+-----    in fours; 0 uses the FCR trigger level ------------
+----- XR = '1', ADD = 1: XFD, log2 of the FIFO depth -------
+-----    (read only; reads 0 in older FPGA images) ---------
+
+	WR_XTL <= '1' when ((CS = '1') and (WR = '1') and (XR = '1') and (ADD = o"0")) else
+	          '0';
+
+u31a : gh_register_ce
+	generic map (8)
+	port map(
+		clk => clk,
+		rst => rst,
+		ce => WR_XTL,
+		D => D,
+		Q => XTL
+		);
+
+	XTL_ON <= '1' when ((RF_AW > 4) and (XTL /= x"00")) else
+	          '0';
+
+	XTL_HIT <= '1' when (unsigned(RF_count) >= unsigned(XTL & "00")) else
+	           '0';
+
+----- XR = '1', ADD = 2: XFC, flow control (10/16/26) ------
+-----    bit 0: pause the sender ---------------------------
+-----    bit 1: send XOFF and XON as the pause changes -----
+-----    bit 2: also pause from when the receive FIFO is ---
+-----           7/8 full until it is empty -----------------
+-----    the pause drops RTS if AFE (MCR bit 5) is set -----
+
+	WR_XFC <= '1' when ((CS = '1') and (WR = '1') and (XR = '1') and (ADD = o"2")) else
+	          '0';
+
+u31b : gh_register_ce
+	generic map (3)
+	port map(
+		clk => clk,
+		rst => rst,
+		ce => WR_XFC,
+		D => D(2 downto 0),
+		Q => XFC
+		);
+
+U31c : gh_jkff 
+	PORT MAP (
+		clk => clk,
+		rst => rst,
+		j => RF_HOLDS,
+		k => RF_HOLDC,
+		Q => RF_HOLD);
+
+	RF_HOLDS <= XFC(2) and a_full;
+	RF_HOLDC <= RF_empty or (not XFC(2));
+
+	PAUSE <= XFC(0) or RF_HOLD or XPAUSE;
+
 ------------ 10/12/07 --------------------------------------
 ----- as suggested  Matthias Klemm -------------------------
 ----- mod 10/13/07 -----------------------------------------
@@ -861,6 +1078,7 @@ U32c : gh_edge_det
 
 
 	ITR2 <= '0' when (IER(0) = '0') else  -- mod 01/20/07
+	        XTL_HIT when (XTL_ON = '1') else
 	        '1' when ((FCR(7 downto 6) = "11") and (a_full = '1')) else
 	        '1' when ((FCR(7 downto 6) = "10") and (h_full = '1')) else
 	        '1' when ((FCR(7 downto 6) = "01") and (q_full = '1')) else
@@ -0,0 +1,309 @@
+-- ANSI Terminal
+--
+-- (c) 2021 Steven A. Falco
+--
+-- ANSI Terminal is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- ANSI Terminal is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+-- A deep receive FIFO for gh_uart_16550, in block RAM.
+--
+-- This is gh_fifo_async16_rcsr_wf with the depth made a generic.  The gray
+-- code pointers, the reset handshake and the flags work the same way, with
+-- the flags at the same fractions of the depth.  There are two changes:
+--
+-- The memory is read on the clock, so that Quartus can put it in M9K
+-- blocks.  The 16550 needs Q to show the oldest word at all times, for
+-- RBR and for its error bits, so the read address runs one word ahead
+-- whenever RD is taking one.  A word only shows as present once the write
+-- pointer has been through the synchronizer, by which time Q has had a
+-- clock to read it.
+--
+-- The number of words held is an output, for the vendor trigger level.
+
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.std_logic_unsigned.all;
+use ieee.std_logic_arith.all;
+
+entity rx_fifo_bram is
+	generic (
+		data_width	: integer := 11;	-- size of data bus
+		add_width	: integer := 10		-- holds 2**add_width words
+	);
+	port (
+		clk_WR		: in std_logic; -- write clock
+		clk_RD		: in std_logic; -- read clock
+		rst		: in std_logic; -- resets counters
+		rc_srst		: in std_logic := '0'; -- resets counters (sync with clk_RD!!!)
+		WR		: in std_logic; -- write control
+		RD		: in std_logic; -- read control
+		D		: in std_logic_vector (data_width-1 downto 0);
+		Q		: out std_logic_vector (data_width-1 downto 0);
+		empty		: out std_logic; -- sync with clk_RD!!!
+		q_full		: out std_logic; -- sync with clk_RD!!!
+		h_full		: out std_logic; -- sync with clk_RD!!!
+		a_full		: out std_logic; -- sync with clk_RD!!!
+		count		: out std_logic_vector (add_width downto 0); -- sync with clk_RD!!!
+		full		: out std_logic
+	);
+end entity;
+
+architecture a of rx_fifo_bram is
+
+	component gh_binary2gray is
+		generic (size: integer := 8);
+		port (
+			B	: in std_logic_vector(size-1 downto 0);
+			G	: out std_logic_vector(size-1 downto 0)
+		);
+	end component;
+
+	component gh_gray2binary is
+		generic (size: integer := 8);
+		port (
+			G	: in std_logic_vector(size-1 downto 0);	-- gray code in
+			B	: out std_logic_vector(size-1 downto 0)	-- binary value out
+		);
+	end component;
+
+	constant depth		: integer := 2**add_width;
+
+	-- The pointers have one more bit than the memory address, to tell
+	-- full from empty.
+	subtype pointer is std_logic_vector(add_width downto 0);
+
+	-- Gray code of a read pointer one lap ahead, for the full flag.
+	constant lap_GC		: pointer := "11" & conv_std_logic_vector(0, add_width-1);
+
+	type ram_mem_type is array (0 to depth-1)
+		of std_logic_vector (data_width-1 downto 0);
+	signal ram_mem		: ram_mem_type;
+
+	signal iempty		: std_logic;
+	signal diempty		: std_logic;
+	signal ifull		: std_logic;
+	signal add_WR_CE	: std_logic;
+	signal add_WR		: pointer;
+	signal add_WR_GC	: pointer;
+	signal iadd_WR_GC	: pointer;
+	signal n_add_WR		: pointer;
+	signal add_WR_RS	: pointer; -- synced to read clk
+	signal add_RD_CE	: std_logic;
+	signal add_RD		: pointer;
+	signal add_RD_GC	: pointer;
+	signal iadd_RD_GC	: pointer;
+	signal add_RD_GCwc	: pointer;
+	signal iadd_RD_GCwc	: pointer;
+	signal iiadd_RD_GCwc	: pointer;
+	signal n_add_RD		: pointer;
+	signal add_RD_WS	: pointer; -- synced to write clk
+	signal add_RD_next	: std_logic_vector(add_width-1 downto 0);
+	signal srst_w		: std_logic;
+	signal isrst_w		: std_logic;
+	signal srst_r		: std_logic;
+	signal isrst_r		: std_logic;
+	signal c_add_RD		: pointer;
+	signal c_add_WR		: pointer;
+	signal c_add		: pointer;
+
+begin
+
+--------------------------------------------
+------- memory -----------------------------
+--------------------------------------------
+
+process (clk_WR)
+begin
+	if (rising_edge(clk_WR)) then
+		if ((WR = '1') and (ifull = '0')) then
+			ram_mem(CONV_INTEGER(add_WR(add_width-1 downto 0))) <= D;
+		end if;
+	end if;
+end process;
+
+	-- Read the word that will be at the head after this clock.
+	add_RD_next <= (others => '0') when (srst_r = '1') else
+	               n_add_RD(add_width-1 downto 0) when (add_RD_CE = '1') else
+	               add_RD(add_width-1 downto 0);
+
+process (clk_RD)
+begin
+	if (rising_edge(clk_RD)) then
+		Q <= ram_mem(CONV_INTEGER(add_RD_next));
+	end if;
+end process;
+
+-----------------------------------------
+----- Write address counter -------------
+-----------------------------------------
+
+	add_WR_CE <= '0' when (ifull = '1') else
+	             '0' when (WR = '0') else
+	             '1';
+
+	n_add_WR <= add_WR + "01";
+
+U1 : gh_binary2gray
+	generic map (size => add_width+1)
+	port map(
+		B => n_add_WR,
+		G => iadd_WR_GC
+		);
+
+process (clk_WR,rst)
+begin
+	if (rst = '1') then
+		add_WR <= (others => '0');
+		add_RD_WS <= lap_GC;
+		add_WR_GC <= (others => '0');
+	elsif (rising_edge(clk_WR)) then
+		add_RD_WS <= add_RD_GCwc;
+		if (srst_w = '1') then
+			add_WR <= (others => '0');
+			add_WR_GC <= (others => '0');
+		elsif (add_WR_CE = '1') then
+			add_WR <= n_add_WR;
+			add_WR_GC <= iadd_WR_GC;
+		end if;
+	end if;
+end process;
+
+	full <= ifull;
+
+	ifull <= '0' when (iempty = '1') else
+	         '0' when (add_RD_WS /= add_WR_GC) else
+	         '1';
+
+-----------------------------------------
+----- Read address counter --------------
+-----------------------------------------
+
+	add_RD_CE <= '0' when (iempty = '1') else
+	             '0' when (RD = '0') else
+	             '1';
+
+	n_add_RD <= add_RD + "01";
+
+U2 : gh_binary2gray
+	generic map (size => add_width+1)
+	port map(
+		B => n_add_RD,
+		G => iadd_RD_GC -- to be used for empty flag
+		);
+
+	iiadd_RD_GCwc <= (not n_add_RD(add_width)) & n_add_RD(add_width-1 downto 0);
+
+U3 : gh_binary2gray
+	generic map (size => add_width+1)
+	port map(
+		B => iiadd_RD_GCwc,
+		G => iadd_RD_GCwc -- to be used for full flag
+		);
+
+process (clk_RD,rst)
+begin
+	if (rst = '1') then
+		add_RD <= (others => '0');
+		add_WR_RS <= (others => '0');
+		add_RD_GC <= (others => '0');
+		add_RD_GCwc <= lap_GC;
+		diempty <= '1';
+	elsif (rising_edge(clk_RD)) then
+		add_WR_RS <= add_WR_GC;
+		diempty <= iempty;
+		if (srst_r = '1') then
+			add_RD <= (others => '0');
+			add_RD_GC <= (others => '0');
+			add_RD_GCwc <= lap_GC;
+		elsif (add_RD_CE = '1') then
+			add_RD <= n_add_RD;
+			add_RD_GC <= iadd_RD_GC;
+			add_RD_GCwc <= iadd_RD_GCwc;
+		end if;
+	end if;
+end process;
+
+	empty <= diempty;
+
+	iempty <= '1' when (add_WR_RS = add_RD_GC) else
+	          '0';
+
+U4 : gh_gray2binary
+	generic map (size => add_width+1)
+	port map(
+		G => add_RD_GC,
+		B => c_add_RD
+		);
+
+U5 : gh_gray2binary
+	generic map (size => add_width+1)
+	port map(
+		G => add_WR_RS,
+		B => c_add_WR
+		);
+
+	c_add <= (c_add_WR - c_add_RD);
+
+	count <= (others => '0') when (iempty = '1') else
+	         c_add;
+
+	-- A quarter, a half and seven eighths full, as in the 16 word FIFO.
+	q_full <= '0' when (iempty = '1') else
+	          '0' when (CONV_INTEGER(c_add) < depth / 4) else
+	          '1';
+
+	h_full <= '0' when (iempty = '1') else
+	          '0' when (CONV_INTEGER(c_add) < depth / 2) else
+	          '1';
+
+	a_full <= '0' when (iempty = '1') else
+	          '0' when (CONV_INTEGER(c_add) < depth - depth / 8) else
+	          '1';
+
+----------------------------------
+--- sync rest stuff --------------
+--- rc_srst is sync with clk_RD --
+--- srst_w is sync with clk_WR ---
+----------------------------------
+
+process (clk_WR,rst)
+begin
+	if (rst = '1') then
+		srst_w <= '0';
+		isrst_r <= '0';
+	elsif (rising_edge(clk_WR)) then
+		srst_w <= isrst_w;
+		if (srst_w = '1') then
+			isrst_r <= '1';
+		elsif (srst_w = '0') then
+			isrst_r <= '0';
+		end if;
+	end if;
+end process;
+
+process (clk_RD,rst)
+begin
+	if (rst = '1') then
+		srst_r <= '0';
+		isrst_w <= '0';
+	elsif (rising_edge(clk_RD)) then
+		srst_r <= rc_srst;
+		if (rc_srst = '1') then
+			isrst_w <= '1';
+		elsif (isrst_r = '1') then
+			isrst_w <= '0';
+		end if;
+	end if;
+end process;
+
+end architecture;
@@ -0,0 +1,211 @@
+-- ANSI Terminal
+--
+-- (c) 2021 Steven A. Falco
+--
+-- ANSI Terminal is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- ANSI Terminal is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with ANSI Terminal.  If not, see <https://www.gnu.org/licenses/>.
+
+-- This file moves received characters from the UART's receive FIFO into
+-- the firmware's receive ring (uart_rb in uart.c), so that the CPU doesn't
+-- have to take an interrupt for them.  It writes the CPU RAM through the
+-- second port of cpu_ram, so it never needs the 68000's bus.
+--
+-- Like uart_store_char(), it tosses nulls and folds GR onto GL.  It keeps
+-- the ring's input count, which the firmware reads in place of
+-- uart_rb_input, and the firmware gives it back the output count as it
+-- finishes with each run.  It stops the sender, through the UART's flow
+-- control, when the ring is above the high water mark, and lets it go
+-- again at the low water mark.  If the ring fills anyway, it stops
+-- taking characters, and the UART's FIFO backs up behind it.
+--
+-- Registers, as 16-bit words:
+--
+-- 0: BASE - the address of the ring.  Writing it empties the ring.
+-- 1: HEAD - characters stored since then (read-only).
+-- 2: TAIL - characters the firmware is finished with.
+-- 3: HIGH - pause the sender above this many characters in the ring.
+-- 4: LOW  - let it go again at or below this many.
+-- 5: CTL  - bit 0 turns us on.  While we are on, the UART's receive FIFO
+--           is ours: RBR doesn't read it, and LSR doesn't show DR.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.std_logic_unsigned.all;
+
+entity uart_dma is
+	generic (
+		ringBits	: integer := 12	-- ring holds 2**ringBits characters
+	);
+	port (
+		clk		: in std_logic;
+		reset		: in std_logic;
+
+		-- CPU
+		CS		: in std_logic;
+		WR		: in std_logic;
+		ADD		: in std_logic_vector (2 downto 0);
+		D		: in std_logic_vector (15 downto 0);
+		Q		: out std_logic_vector (15 downto 0);
+
+		-- UART receive FIFO
+		uartOn		: out std_logic;
+		uartRD		: out std_logic;
+		uartQ		: in std_logic_vector (7 downto 0);
+		uartEmpty	: in std_logic;
+		uartPause	: out std_logic;
+
+		-- CPU RAM, second port
+		ramAddr		: out std_logic_vector (12 downto 0);
+		ramByteEna	: out std_logic_vector (1 downto 0);
+		ramData		: out std_logic_vector (15 downto 0);
+		ramWren		: out std_logic
+	);
+end uart_dma;
+
+architecture a of uart_dma is
+
+	type dma_FSM_type is (
+		dmaIdle_state,
+		dmaStore_state,
+		dmaWrite_state,
+		dmaCount_state
+	);
+
+	signal dmaFSM		: dma_FSM_type := dmaIdle_state;
+
+	signal base		: std_logic_vector (15 downto 0) := (others => '0');
+	signal head		: std_logic_vector (15 downto 0) := (others => '0');
+	signal tail		: std_logic_vector (15 downto 0) := (others => '0');
+	signal high		: std_logic_vector (15 downto 0) := (others => '0');
+	signal low		: std_logic_vector (15 downto 0) := (others => '0');
+	signal dmaOn		: std_logic := '0';
+	signal paused		: std_logic := '0';
+
+	-- How many characters are in the ring, and where the next one goes.
+	signal count		: std_logic_vector (15 downto 0);
+	signal slot		: std_logic_vector (13 downto 0);
+
+	signal char		: std_logic_vector (7 downto 0);
+
+begin
+	count <= head - tail;
+	slot <= base(13 downto 0) + head(ringBits - 1 downto 0);
+
+	Q <= base when (ADD = "000") else
+	     head when (ADD = "001") else
+	     tail when (ADD = "010") else
+	     high when (ADD = "011") else
+	     low when (ADD = "100") else
+	     x"000" & "000" & dmaOn when (ADD = "101") else
+	     (others => '0');
+
+	uartOn <= dmaOn;
+	uartPause <= paused;
+
+	dma_process: process(clk)
+	begin
+		if(rising_edge(clk)) then
+			uartRD <= '0';
+			ramWren <= '0';
+
+			if(reset = '1') then
+				base <= (others => '0');
+				head <= (others => '0');
+				tail <= (others => '0');
+				high <= (others => '0');
+				low <= (others => '0');
+				dmaOn <= '0';
+				paused <= '0';
+				dmaFSM <= dmaIdle_state;
+			else
+				if(CS = '1' and WR = '1') then
+					case ADD is
+						when "000" =>
+							base <= D;
+							head <= (others => '0');
+						when "010" =>
+							tail <= D;
+						when "011" =>
+							high <= D;
+						when "100" =>
+							low <= D;
+						when "101" =>
+							dmaOn <= D(0);
+						when others =>
+							null;
+					end case;
+				end if;
+
+				-- Stop and start the sender.
+				if(dmaOn = '0') then
+					paused <= '0';
+				elsif(count > high) then
+					paused <= '1';
+				elsif(count <= low) then
+					paused <= '0';
+				end if;
+
+				case dmaFSM is
+
+					when dmaIdle_state =>
+						-- Take the oldest character, if there
+						-- is room for it.
+						if(dmaOn = '1' and uartEmpty = '0' and
+						   count(15 downto ringBits) = 0) then
+							uartRD <= '1';
+							char <= uartQ;
+							dmaFSM <= dmaStore_state;
+						end if;
+
+					when dmaStore_state =>
+						-- Toss nulls, and fold GR onto GL.
+						if(char /= x"00") then
+							if(char >= x"a0") then
+								char(7) <= '0';
+							end if;
+							dmaFSM <= dmaWrite_state;
+						else
+							dmaFSM <= dmaIdle_state;
+						end if;
+
+					when dmaWrite_state =>
+						-- The 68000 is big-endian, so the even
+						-- byte is the upper one.
+						ramAddr <= slot(13 downto 1);
+						if(slot(0) = '0') then
+							ramByteEna <= "10";
+						else
+							ramByteEna <= "01";
+						end if;
+						ramData <= char & char;
+						ramWren <= '1';
+						dmaFSM <= dmaCount_state;
+
+					when dmaCount_state =>
+						-- The character is in RAM as of this
+						-- clock, so the firmware can have it.
+						-- The FIFO's empty flag has caught up
+						-- with the read by now, too.
+						head <= head + 1;
+						dmaFSM <= dmaIdle_state;
+
+					when others =>
+						dmaFSM <= dmaIdle_state;
+
+				end case;
+			end if;
+		end if;
+	end process;
+
+end a;